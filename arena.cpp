@@ -0,0 +1,53 @@
+#include "arena.h"
+
+#include <algorithm>
+
+using namespace std;
+
+MoleculeArena::MoleculeArena(size_t initialBytes)
+    : block(make_unique_for_overwrite<byte[]>(initialBytes)), blockSize(initialBytes) {
+    cursor = block.get();
+    end = cursor + blockSize;
+}
+
+MoleculeArena::MoleculeArena(MoleculeArena&& other) noexcept
+    : block(move(other.block)), blockSize(other.blockSize), cursor(block.get()), end(cursor + blockSize) {
+    other.blockSize = 0;
+    other.reset();
+}
+
+void MoleculeArena::reset() {
+    if (!overflow.empty()) {
+        size_t wanted = min(blockSize + overflowBytes, maxKeptBytes);
+        if (wanted > blockSize) {
+            block.reset();
+            block = make_unique_for_overwrite<byte[]>(wanted);
+            blockSize = wanted;
+        }
+        overflow.clear();
+        overflowBytes = 0;
+    }
+    cursor = block.get();
+    end = cursor + blockSize;
+}
+
+void* MoleculeArena::do_allocate(size_t bytes, size_t alignment) {
+    allocationCount++;
+    byteCount += bytes;
+
+    void* start = cursor;
+    size_t space = end - cursor;
+    if (!align(alignment, bytes, start, space)) {
+        // Each new block at least doubles what the arena holds, so a large molecule
+        // needs only a few of them
+        size_t size = max(blockSize + overflowBytes, bytes + alignment);
+        overflow.push_back(make_unique_for_overwrite<byte[]>(size));
+        overflowBytes += size;
+        start = overflow.back().get();
+        space = size;
+        align(alignment, bytes, start, space);
+        end = (byte*)start + space;
+    }
+    cursor = (byte*)start + bytes;
+    return start;
+}
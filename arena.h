@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <vector>
+
+// Scratch memory for naming one molecule, used through std::pmr containers.
+// Allocating bumps a pointer through one block, deallocating does nothing, and reset()
+// takes everything back at once, so temporaries cost neither a malloc/free pair nor a
+// trip through the allocator's locks. A molecule that outgrows the block gets more
+// blocks from the heap; the next reset() replaces them all with one block of the
+// combined size (up to maxKeptBytes), so the arena settles at the largest molecule
+// seen and from then on never touches the heap. Nothing allocated from it may be used
+// after reset().
+class MoleculeArena : public std::pmr::memory_resource {
+public:
+    static constexpr size_t maxKeptBytes = 1 << 20;
+
+    explicit MoleculeArena(size_t initialBytes = 16 * 1024);
+
+    // Moving leaves other empty; only move an arena nothing is allocated from
+    MoleculeArena(MoleculeArena&& other) noexcept;
+    MoleculeArena& operator=(MoleculeArena&&) = delete;
+
+    void reset();
+
+    // Allocations served and bytes asked for since the arena was made; callers take
+    // differences, like with threadAllocations
+    uint64_t allocations() const { return allocationCount; }
+    uint64_t bytes() const { return byteCount; }
+
+private:
+    void* do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void*, size_t, size_t) override {}
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+
+    std::unique_ptr<std::byte[]> block;
+    size_t blockSize;
+    std::vector<std::unique_ptr<std::byte[]>> overflow;  // Blocks added since the last reset
+    size_t overflowBytes = 0;
+    std::byte* cursor;
+    std::byte* end;
+    uint64_t allocationCount = 0;
+    uint64_t byteCount = 0;
+};
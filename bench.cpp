@@ -0,0 +1,427 @@
+// Benchmark driver for the naming pipeline.
+//
+// Generates random molecules in the condensed notation parseMolecularFormula reads
+// (branched alkanes, haloalkanes, carboxylic acids and ethers), runs every pipeline
+// stage separately and prints one JSON document with per-stage latency percentiles,
+// throughput and heap allocation counts, so runs can be diffed across commits.
+//
+//   g++ -std=c++20 -O2 -pthread bench.cpp molecule.cpp namer.cpp thread_pool.cpp canonical.cpp name_cache.cpp rings.cpp nomenclature.cpp name_parser.cpp session.cpp metrics.cpp properties.cpp fingerprint.cpp arena.cpp smiles.cpp graph_store.cpp -o bench
+//   ./bench --sizes 5,100,10000 --branching 0,0.3 --seed 7 > before.json
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "namer.h"
+#include "properties.h"
+#include "session.h"
+
+using namespace std;
+
+// -------------------- Molecule Generator --------------------
+
+enum class MoleculeKind { Alkane, Haloalkane, CarboxylicAcid, Ether };
+
+const char* kindName(MoleculeKind kind) {
+    switch (kind) {
+        case MoleculeKind::Alkane: return "alkane";
+        case MoleculeKind::Haloalkane: return "haloalkane";
+        case MoleculeKind::CarboxylicAcid: return "carboxylic_acid";
+        default: return "ether";
+    }
+}
+
+// Random carbon skeleton of `carbons` atoms. Each new carbon extends the current tip
+// of the chain, or with probability `branching` hangs off a random earlier carbon that
+// still has a free valence. The root may be reserved as a terminal COOH carbon.
+struct Skeleton {
+    vector<vector<int>> children;
+    vector<int> halogens;  // 0 none, otherwise count of Cl/Br placed on the carbon
+    int rootValence = 4;
+    int rootExternalBonds = 0;  // 1 when the root is bonded to an ether oxygen
+};
+
+Skeleton randomSkeleton(int carbons, double branching, bool halogenate, bool carboxylRoot, mt19937_64& rng, bool etherRoot = false) {
+    Skeleton skeleton;
+    skeleton.children.resize(carbons);
+    skeleton.halogens.assign(carbons, 0);
+    skeleton.rootValence = carboxylRoot ? 1 : etherRoot ? 3 : 4;
+    skeleton.rootExternalBonds = etherRoot ? 1 : 0;
+
+    vector<int> degree(carbons, 0);
+    auto capacity = [&](int atom) { return atom == 0 ? skeleton.rootValence : 4; };
+
+    uniform_real_distribution<double> coin(0.0, 1.0);
+    vector<int> open;  // Carbons that can still take a neighbour
+    if (carbons > 0) open.push_back(0);
+    int tip = 0;
+
+    for (int atom = 1; atom < carbons; atom++) {
+        int parent = tip;
+        if (coin(rng) < branching || degree[tip] >= capacity(tip)) {
+            do {
+                size_t pick = rng() % open.size();
+                parent = open[pick];
+                if (degree[parent] >= capacity(parent)) {
+                    open[pick] = open.back();
+                    open.pop_back();
+                    parent = -1;
+                }
+            } while (parent == -1);
+        }
+
+        skeleton.children[parent].push_back(atom);
+        degree[parent]++;
+        degree[atom]++;
+        open.push_back(atom);
+        tip = atom;
+    }
+
+    if (halogenate) {
+        for (int atom = 0; atom < carbons; atom++) {
+            while (degree[atom] < capacity(atom) && coin(rng) < 0.15) {
+                skeleton.halogens[atom]++;
+                degree[atom]++;
+            }
+        }
+    }
+    return skeleton;
+}
+
+// Writes the skeleton depth-first: the last child continues the main line, the
+// others go in parentheses. Iterative so 100k-atom chains do not exhaust the stack.
+string writeFormula(const Skeleton& skeleton, bool carboxylRoot, mt19937_64& rng) {
+    string formula;
+    int carbons = skeleton.children.size();
+    if (carbons == 0) return formula;
+
+    auto writeAtom = [&](int atom) {
+        int bonds = skeleton.children[atom].size() + skeleton.halogens[atom] + (atom == 0 ? skeleton.rootExternalBonds : 1);
+        if (atom == 0 && carboxylRoot) {
+            formula += "COOH";
+        } else {
+            int hydrogens = 4 - bonds;
+            formula += 'C';
+            if (hydrogens > 0) {
+                formula += 'H';
+                if (hydrogens > 1) formula += char('0' + hydrogens);
+            }
+        }
+        for (int i = 0; i < skeleton.halogens[atom]; i++) {
+            formula += (rng() & 1) ? "(Cl)" : "(Br)";
+        }
+    };
+
+    struct Frame {
+        int atom;
+        size_t nextChild;
+        bool closeParen;
+    };
+    vector<Frame> stack = {{0, 0, false}};
+    writeAtom(0);
+
+    while (!stack.empty()) {
+        Frame& frame = stack.back();
+        const vector<int>& children = skeleton.children[frame.atom];
+
+        if (frame.nextChild < children.size()) {
+            int child = children[frame.nextChild++];
+            bool last = frame.nextChild == children.size();
+            if (!last) formula += '(';
+            writeAtom(child);
+            stack.push_back({child, 0, !last});
+            continue;
+        }
+
+        if (frame.closeParen) formula += ')';
+        stack.pop_back();
+    }
+    return formula;
+}
+
+string randomFormula(MoleculeKind kind, int atoms, double branching, mt19937_64& rng) {
+    switch (kind) {
+        case MoleculeKind::Alkane:
+            return writeFormula(randomSkeleton(atoms, branching, false, false, rng), false, rng);
+        case MoleculeKind::Haloalkane:
+            return writeFormula(randomSkeleton(atoms, branching, true, false, rng), false, rng);
+        case MoleculeKind::CarboxylicAcid:
+            return writeFormula(randomSkeleton(atoms, branching, false, true, rng), true, rng);
+        default: {
+            int left = max(1, atoms / 2);
+            int right = max(1, atoms - left);
+            return writeFormula(randomSkeleton(left, branching, false, false, rng, true), false, rng) + "-O-" +
+                   writeFormula(randomSkeleton(right, branching, false, false, rng, true), false, rng);
+        }
+    }
+}
+
+// -------------------- Stage Timing --------------------
+
+struct StageSamples {
+    vector<double> micros;
+    size_t allocations = 0;
+    size_t bytes = 0;
+};
+
+// Runs body, records its wall time and the allocations it made
+template <typename Body>
+void measure(StageSamples& stage, Body&& body) {
+    size_t allocationsBefore = threadAllocations;
+    size_t bytesBefore = threadAllocatedBytes;
+    auto start = chrono::steady_clock::now();
+    body();
+    auto end = chrono::steady_clock::now();
+    stage.micros.push_back(chrono::duration<double, micro>(end - start).count());
+    stage.allocations += threadAllocations - allocationsBefore;
+    stage.bytes += threadAllocatedBytes - bytesBefore;
+}
+
+double percentile(vector<double> values, double fraction) {
+    if (values.empty()) return 0;
+    size_t index = min(values.size() - 1, (size_t)(fraction * (values.size() - 1) + 0.5));
+    nth_element(values.begin(), values.begin() + index, values.end());
+    return values[index];
+}
+
+void writeStage(ostream& out, const char* name, const StageSamples& stage, size_t molecules) {
+    double total = 0;
+    for (double sample : stage.micros) total += sample;
+    out << "\"" << name << "\":{"
+        << "\"p50_us\":" << percentile(stage.micros, 0.50)
+        << ",\"p90_us\":" << percentile(stage.micros, 0.90)
+        << ",\"p99_us\":" << percentile(stage.micros, 0.99)
+        << ",\"max_us\":" << percentile(stage.micros, 1.0)
+        << ",\"total_ms\":" << total / 1000
+        << ",\"allocations_per_molecule\":" << (double)stage.allocations / max<size_t>(1, molecules)
+        << ",\"bytes_per_molecule\":" << (double)stage.bytes / max<size_t>(1, molecules)
+        << "}";
+}
+
+struct CaseResult {
+    MoleculeKind kind;
+    int atoms;
+    double branching;
+    size_t molecules = 0;
+    size_t totalAtoms = 0;
+    size_t referenceMismatches = 0;
+    size_t referenceChecked = 0;
+    size_t sessionMismatches = 0;
+    StageSamples parse, graphBuild, chainSearch, branchCount, nameAssembly, pipeline, sessionEdit, properties;
+};
+
+// Times one molecule stage by stage, mirroring the order processMolecularGraph uses
+void benchmarkMolecule(const string& formula, CaseResult& result, NamerScratch& scratch, const Namer& namer,
+                       MoleculeSession& session, bool checkReference) {
+    MolecularGraph& molecule = scratch.molecule;
+    string_view text = formula;
+    size_t ether = findEtherLink(text);
+    if (ether != string_view::npos) text = text.substr(0, ether);  // Stages run on the first half
+
+    measure(result.parse, [&] {
+        molecule.clear();
+        molecule.parseMolecularFormula(text);
+    });
+    measure(result.graphBuild, [&] { molecule.finalize(); });
+    result.totalAtoms += molecule.atomCount();
+
+    int atomCount = molecule.atomCount();
+    vector<int> coohNodes;
+    int startNode = -1;
+    for (int atom = 0; atom < atomCount; atom++) {
+        if (isCOOHGroup(molecule, atom)) coohNodes.push_back(atom);
+        if (startNode == -1 && isChainAtom(molecule.element[atom])) startNode = atom;
+    }
+    if (startNode == -1) return;
+
+    vector<int> chain;
+    measure(result.chainSearch, [&] {
+        chain = findParentChain(molecule, coohNodes, scratch);
+    });
+
+    if (checkReference) {
+        vector<int> reference = coohNodes.empty() ? findLongestCarbonChainReference(molecule, startNode)
+                                                  : findLongestChainWithCOOHReference(molecule, coohNodes);
+        result.referenceChecked++;
+        if (reference.size() != chain.size()) result.referenceMismatches++;
+    }
+
+    measure(result.branchCount, [&] {
+        scratch.onMainChain.assign(atomCount, 0);
+        for (int atom : chain) scratch.onMainChain[atom] = 1;
+        analyzeBranches(molecule, chain, scratch, false, nullptr);
+    });
+
+    measure(result.nameAssembly, [&] {
+        string name = generateIUPACName(substituentsAlong(chain, scratch), chain.size(), coohNodes.empty() ? 0 : 1);
+    });
+
+    // Properties of the one molecule through the batch path; the buffers are reused
+    static MoleculeBatch batch;
+    static BatchProperties properties;
+    measure(result.properties, [&] {
+        batch.clear();
+        batch.add(molecule);
+        computeProperties(batch, properties);
+    });
+
+    measure(result.pipeline, [&] { namer.name(formula, scratch, nullptr); });
+
+    // Interactive editing: a carbon is added at the last atom written and removed again,
+    // renaming after each edit; one sample per edit
+    // With the reference check on, every session name is compared with a full pass
+    static MolecularGraph snapshot;
+    static vector<int> snapshotIds;
+    auto checkSession = [&] {
+        if (!checkReference) return;
+        session.exportGraph(snapshot, snapshotIds);
+        if (session.name().name != processMolecularGraph(snapshot, 0, scratch, {}, nullptr).name) result.sessionMismatches++;
+    };
+
+    session.load(text);
+    session.name();
+    checkSession();
+    int site = atomCount - 1;
+    while (site >= 0 && (molecule.element[site] != Element::C || molecule.C_C_bonds[site] + molecule.C_X_bonds[site] >= 4)) site--;
+    if (site >= 0) {
+        int added = -1;
+        measure(result.sessionEdit, [&] {
+            added = session.addAtom(Element::C);
+            session.addBond(site, added);
+            session.name();
+        });
+        checkSession();
+        measure(result.sessionEdit, [&] {
+            session.removeAtom(added);
+            session.name();
+        });
+        checkSession();
+    }
+    result.molecules++;
+}
+
+vector<string> splitList(const string& text) {
+    vector<string> items;
+    stringstream stream(text);
+    string item;
+    while (getline(stream, item, ',')) {
+        if (!item.empty()) items.push_back(item);
+    }
+    return items;
+}
+
+int main(int argc, char* argv[]) {
+    vector<int> sizes = {5, 10, 50, 100, 1000, 10000, 100000};
+    vector<double> branchingFactors = {0.0, 0.2, 0.5};
+    size_t atomBudget = 1000000;  // Atoms generated per case; bounds the molecule count
+    size_t maxMolecules = 2000;
+    int referenceLimit = 0;       // Cross-check the reference chain search up to this size
+    size_t emitCount = 0;         // Print this many formulas per case instead of timing
+    uint64_t seed = 42;
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--sizes" && i + 1 < argc) {
+            sizes.clear();
+            for (const string& item : splitList(argv[++i])) sizes.push_back(stoi(item));
+        } else if (arg == "--branching" && i + 1 < argc) {
+            branchingFactors.clear();
+            for (const string& item : splitList(argv[++i])) branchingFactors.push_back(stod(item));
+        } else if (arg == "--atoms-per-case" && i + 1 < argc) {
+            atomBudget = stoul(argv[++i]);
+        } else if (arg == "--max-molecules" && i + 1 < argc) {
+            maxMolecules = stoul(argv[++i]);
+        } else if (arg == "--check-reference" && i + 1 < argc) {
+            referenceLimit = stoi(argv[++i]);
+        } else if (arg == "--emit" && i + 1 < argc) {
+            emitCount = stoul(argv[++i]);
+        } else if (arg == "--seed" && i + 1 < argc) {
+            seed = stoull(argv[++i]);
+        } else {
+            cerr << "Usage: bench [--sizes 5,100,...] [--branching 0,0.2,...] [--atoms-per-case N]"
+                    " [--max-molecules N] [--check-reference MAX_ATOMS] [--emit N] [--seed N]" << endl;
+            return 1;
+        }
+    }
+
+    mt19937_64 rng(seed);
+    Namer namer;
+    NamerScratch scratch;
+    MoleculeSession session;
+    const MoleculeKind kinds[] = {MoleculeKind::Alkane, MoleculeKind::Haloalkane, MoleculeKind::CarboxylicAcid, MoleculeKind::Ether};
+
+    // Corpus mode: the same generator, written out as one formula per line
+    if (emitCount > 0) {
+        for (MoleculeKind kind : kinds) {
+            for (int atoms : sizes) {
+                for (double branching : branchingFactors) {
+                    for (size_t m = 0; m < emitCount; m++) {
+                        cout << randomFormula(kind, atoms, branching, rng) << '\n';
+                    }
+                }
+            }
+        }
+        return 0;
+    }
+
+    cout << "{\"seed\":" << seed << ",\"cases\":[";
+    bool firstCase = true;
+    for (MoleculeKind kind : kinds) {
+        for (int atoms : sizes) {
+            for (double branching : branchingFactors) {
+                CaseResult result{};
+                result.kind = kind;
+                result.atoms = atoms;
+                result.branching = branching;
+                size_t molecules = max<size_t>(3, min(maxMolecules, atomBudget / max(1, atoms)));
+                bool checkReference = atoms <= referenceLimit;
+
+                auto start = chrono::steady_clock::now();
+                for (size_t m = 0; m < molecules; m++) {
+                    string formula = randomFormula(kind, atoms, branching, rng);
+                    benchmarkMolecule(formula, result, scratch, namer, session, checkReference);
+                }
+                double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+                double pipelineSeconds = 0;
+                for (double sample : result.pipeline.micros) pipelineSeconds += sample / 1e6;
+
+                cout << (firstCase ? "" : ",") << "\n{\"kind\":\"" << kindName(kind) << "\",\"atoms\":" << atoms
+                     << ",\"branching\":" << branching << ",\"molecules\":" << result.molecules
+                     << ",\"wall_s\":" << seconds
+                     << ",\"molecules_per_s\":" << result.molecules / max(pipelineSeconds, 1e-9)
+                     << ",\"atoms_per_s\":" << result.totalAtoms / max(pipelineSeconds, 1e-9);
+                if (checkReference) {
+                    cout << ",\"reference_checked\":" << result.referenceChecked
+                         << ",\"reference_mismatches\":" << result.referenceMismatches
+                         << ",\"session_mismatches\":" << result.sessionMismatches;
+                }
+                cout << ",\"stages\":{";
+                writeStage(cout, "parse", result.parse, result.molecules);
+                cout << ",";
+                writeStage(cout, "graph_build", result.graphBuild, result.molecules);
+                cout << ",";
+                writeStage(cout, "chain_search", result.chainSearch, result.molecules);
+                cout << ",";
+                writeStage(cout, "count_branch_carbons", result.branchCount, result.molecules);
+                cout << ",";
+                writeStage(cout, "generate_iupac_name", result.nameAssembly, result.molecules);
+                cout << ",";
+                writeStage(cout, "pipeline", result.pipeline, result.molecules);
+                cout << ",";
+                writeStage(cout, "session_edit", result.sessionEdit, result.molecules);
+                cout << ",";
+                writeStage(cout, "properties", result.properties, result.molecules);
+                cout << "}}";
+                cout.flush();
+                firstCase = false;
+            }
+        }
+    }
+    cout << "\n]}" << endl;
+    return 0;
+}
@@ -0,0 +1,178 @@
+#include "canonical.h"
+
+#include <algorithm>
+#include <numeric>
+
+using namespace std;
+
+uint64_t fnv1a(const string& bytes) {
+    uint64_t hash = 14695981039346656037ull;
+    for (unsigned char byte : bytes) {
+        hash ^= byte;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+// Working arrays of refineRanks, allocated once per canonicalization since ties are
+// broken by refining again and again
+struct RefineBuffers {
+    explicit RefineBuffers(pmr::memory_resource* memory)
+        : signatureOffsets(memory), signatures(memory), order(memory), refined(memory), used(memory) {}
+
+    pmr::vector<int> signatureOffsets;
+    pmr::vector<int> signatures;
+    pmr::vector<int> order;
+    pmr::vector<int> refined;
+    pmr::vector<char> used;
+};
+
+static int countClasses(const vector<int>& rank, pmr::vector<char>& used) {
+    used.assign(rank.size(), 0);
+    int classes = 0;
+    for (int r : rank) {
+        if (!used[r]) {
+            used[r] = 1;
+            classes++;
+        }
+    }
+    return classes;
+}
+
+// Re-ranks atoms by (rank, sorted neighbour ranks); returns the number of classes.
+// Ranks follow the usual convention: tied atoms share the position of the first of them.
+static int refineRanks(const MolecularGraph& molecule, vector<int>& rank, RefineBuffers& buffers) {
+    int n = molecule.atomCount();
+
+    // Flattened signatures: rank followed by the sorted ranks of the neighbours
+    pmr::vector<int>& signatureOffsets = buffers.signatureOffsets;
+    pmr::vector<int>& signatures = buffers.signatures;
+    signatureOffsets.resize(n + 1);
+    signatures.reserve(n + molecule.adjacencyTargets.size());
+    pmr::vector<int>& order = buffers.order;
+    pmr::vector<int>& refined = buffers.refined;
+    order.resize(n);
+    refined.resize(n);
+    int previousClasses = countClasses(rank, buffers.used);
+
+    while (true) {
+        signatures.clear();
+        for (int atom = 0; atom < n; atom++) {
+            signatureOffsets[atom] = signatures.size();
+            signatures.push_back(rank[atom]);
+            size_t first = signatures.size();
+            for (int neighbor : molecule.neighbors(atom)) {
+                signatures.push_back(rank[neighbor]);
+            }
+            sort(signatures.begin() + first, signatures.end());
+        }
+        signatureOffsets[n] = signatures.size();
+
+        auto signatureLess = [&](int a, int b) {
+            return lexicographical_compare(signatures.begin() + signatureOffsets[a], signatures.begin() + signatureOffsets[a + 1],
+                                           signatures.begin() + signatureOffsets[b], signatures.begin() + signatureOffsets[b + 1]);
+        };
+
+        iota(order.begin(), order.end(), 0);
+        sort(order.begin(), order.end(), signatureLess);
+
+        int classes = 0;
+        for (int i = 0; i < n; i++) {
+            if (i == 0 || signatureLess(order[i - 1], order[i])) {
+                refined[order[i]] = i;
+                classes++;
+            } else {
+                refined[order[i]] = refined[order[i - 1]];
+            }
+        }
+
+        copy(refined.begin(), refined.end(), rank.begin());
+        if (classes == previousClasses) {
+            return classes;
+        }
+        previousClasses = classes;
+    }
+}
+
+CanonicalForm canonicalize(const MolecularGraph& molecule, pmr::memory_resource* memory) {
+    int n = molecule.atomCount();
+    CanonicalForm form;
+
+    // Initial invariants: element, hydrogens, heavy-atom degree
+    pmr::vector<long long> invariant(n, memory);
+    for (int atom = 0; atom < n; atom++) {
+        invariant[atom] = ((long long)molecule.element[atom] << 40) |
+                          ((long long)molecule.C_H_bonds[atom] << 20) |
+                          (long long)molecule.neighbors(atom).size();
+    }
+    pmr::vector<int> order(n, memory);
+    iota(order.begin(), order.end(), 0);
+    sort(order.begin(), order.end(), [&](int a, int b) { return invariant[a] < invariant[b]; });
+
+    vector<int>& rank = form.rank;
+    rank.assign(n, 0);
+    for (int i = 0; i < n; i++) {
+        rank[order[i]] = (i > 0 && invariant[order[i]] == invariant[order[i - 1]]) ? rank[order[i - 1]] : i;
+    }
+
+    // Refine, then break remaining ties one atom at a time
+    RefineBuffers buffers(memory);
+    pmr::vector<int> classSize(memory);
+    while (refineRanks(molecule, rank, buffers) < n) {
+        classSize.assign(n, 0);
+        for (int atom = 0; atom < n; atom++) {
+            classSize[rank[atom]]++;
+        }
+
+        int tiedRank = -1;
+        for (int r = 0; r < n; r++) {
+            if (classSize[r] > 1) {
+                tiedRank = r;
+                break;
+            }
+        }
+
+        bool promoted = false;
+        for (int atom = 0; atom < n; atom++) {
+            if (rank[atom] == tiedRank) {
+                if (promoted) {
+                    rank[atom] = tiedRank + 1;
+                }
+                promoted = true;
+            }
+        }
+    }
+
+    // Serialize in canonical order: atoms, then bonds as sorted rank pairs
+    pmr::vector<int> atomAt(n, memory);
+    for (int atom = 0; atom < n; atom++) {
+        atomAt[rank[atom]] = atom;
+    }
+
+    string& code = form.code;
+    code.reserve(2 * n + 8 * molecule.edges.size() + 4);
+    for (int i = 0; i < n; i++) {
+        int atom = atomAt[i];
+        code.push_back((char)molecule.element[atom]);
+        code.push_back((char)molecule.C_H_bonds[atom]);
+    }
+
+    pmr::vector<pair<int, int>> bonds(memory);
+    bonds.reserve(molecule.edges.size());
+    for (const auto& edge : molecule.edges) {
+        int a = rank[edge.first];
+        int b = rank[edge.second];
+        bonds.emplace_back(min(a, b), max(a, b));
+    }
+    sort(bonds.begin(), bonds.end());
+    for (const auto& bond : bonds) {
+        for (int value : {bond.first, bond.second}) {
+            for (int shift = 0; shift < 32; shift += 8) {
+                code.push_back((char)((value >> shift) & 0xff));
+            }
+        }
+    }
+
+    form.hash = fnv1a(code);
+    return form;
+}
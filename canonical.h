@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstdint>
+#include <memory_resource>
+#include <string>
+#include <vector>
+
+#include "molecule.h"
+
+// Canonical labeling of a parsed molecule. Two notations of the same structure
+// (e.g. with the branch order permuted) produce the same code and hash.
+struct CanonicalForm {
+    std::vector<int> rank;   // Canonical position of every atom id
+    std::string code;        // Structure serialized in canonical atom order
+    uint64_t hash = 0;       // FNV-1a of code
+};
+
+// Morgan-style ranking: atoms start from (element, hydrogens, degree) invariants and
+// are refined by their neighbours' ranks until the partition stops splitting. Ties
+// left over are broken by promoting the first atom of the lowest tied class and
+// refining again. On trees the stable classes are exactly the symmetry classes, so
+// the result does not depend on which tied atom is promoted. Working arrays come from
+// memory (e.g. a NamerScratch arena); the form itself uses the default allocator.
+CanonicalForm canonicalize(const MolecularGraph& molecule,
+                           std::pmr::memory_resource* memory = std::pmr::get_default_resource());
+
+uint64_t fnv1a(const std::string& bytes);
@@ -0,0 +1,448 @@
+// Constitutional isomer enumerator.
+//
+// Generates every alkane CnH2n+2 exactly once, optionally with K hydrogens replaced by
+// Cl and/or Br, and names each isomer in memory with processMolecularGraph. Carbon
+// skeletons are the free trees of maximum degree 4, produced in canonical level-sequence
+// form by the Wright-Richmond-Odlyzko-McKay successor rule. Halogen patterns on one
+// skeleton are deduplicated by canonical form. Skeletons are handed to the
+// work-stealing pool in batches and the output keeps generation order.
+//
+//   g++ -std=c++20 -O2 -pthread enumerate.cpp molecule.cpp namer.cpp thread_pool.cpp canonical.cpp name_cache.cpp rings.cpp nomenclature.cpp name_parser.cpp session.cpp metrics.cpp properties.cpp fingerprint.cpp arena.cpp smiles.cpp graph_store.cpp -o enumerate
+//   ./enumerate 10 --halogens Cl,Br --substitutions 2 --formulas > c10_dihalo.tsv
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "canonical.h"
+#include "namer.h"
+#include "thread_pool.h"
+
+using namespace std;
+
+// -------------------- Tree Generation --------------------
+
+// Free trees on n vertices as level sequences (root at level 0, depth-first order).
+// Each call to next() advances to the next tree; WROM guarantees every unlabeled tree
+// appears once, with constant amortized work per tree.
+class FreeTreeGenerator {
+public:
+    explicit FreeTreeGenerator(int n) : n(n) {
+        if (n <= 2) {
+            for (int i = 0; i < n; i++) levels.push_back(i);
+            return;
+        }
+        for (int i = 0; i <= n / 2; i++) levels.push_back(i);
+        for (int i = 1; i < (n + 1) / 2; i++) levels.push_back(i);
+    }
+
+    // Moves to the next valid tree; false when the sequence is exhausted
+    bool next() {
+        if (first) {
+            first = false;
+            if (n <= 2) return n > 0;
+        } else {
+            if (n <= 2 || !nextRootedTree(lastNonOne())) return false;
+        }
+        return makeValid();
+    }
+
+    const vector<int>& current() const { return levels; }
+
+private:
+    int lastNonOne() const {
+        int p = n - 1;
+        while (levels[p] == 1) p--;
+        return p;
+    }
+
+    // Next rooted tree in reverse lexicographic order, changing positions p onward
+    bool nextRootedTree(int p) {
+        if (p == 0) return false;
+        int q = p - 1;
+        while (levels[q] != levels[p] - 1) q--;
+        for (int i = p; i < n; i++) {
+            levels[i] = levels[i - p + q];
+        }
+        return true;
+    }
+
+    // Splits at the second vertex on level 1: the subtree of the first root child
+    // ("left") against the rest. Returns the length of left.
+    int splitPoint() const {
+        int m = n;
+        bool seenOne = false;
+        for (int i = 1; i < n; i++) {
+            if (levels[i] == 1) {
+                if (seenOne) {
+                    m = i;
+                    break;
+                }
+                seenOne = true;
+            }
+        }
+        return m - 1;
+    }
+
+    // Rooted trees that are not the canonical (centre-rooted) form of their free tree
+    // are skipped by jumping ahead; loops until a valid one or the end
+    bool makeValid() {
+        while (true) {
+            int leftLength = splitPoint();
+            int leftHeight = 0, restHeight = 0;
+            for (int i = 1; i <= leftLength; i++) leftHeight = max(leftHeight, levels[i] - 1);
+            for (int i = leftLength + 1; i < n; i++) restHeight = max(restHeight, levels[i]);
+            int restLength = n - leftLength;
+
+            bool valid = restHeight >= leftHeight;
+            if (valid && restHeight == leftHeight) {
+                if (leftLength > restLength) {
+                    valid = false;
+                } else if (leftLength == restLength && leftGreaterThanRest(leftLength)) {
+                    valid = false;
+                }
+            }
+            if (valid) return true;
+
+            int p = leftLength;
+            bool bigStep = levels[p] > 2;
+            if (!nextRootedTree(p)) return false;
+            if (bigStep) {
+                int newLeft = splitPoint();
+                int newLeftHeight = 0;
+                for (int i = 1; i <= newLeft; i++) newLeftHeight = max(newLeftHeight, levels[i] - 1);
+                for (int k = 0; k < newLeftHeight + 1; k++) {
+                    levels[n - newLeftHeight - 1 + k] = k + 1;
+                }
+            }
+        }
+    }
+
+    // Compares the left subtree (levels shifted down one) with the rest (root at 0)
+    bool leftGreaterThanRest(int leftLength) const {
+        for (int i = 0; i < leftLength; i++) {
+            int left = levels[1 + i] - 1;
+            int rest = i == 0 ? 0 : levels[leftLength + i];
+            if (left != rest) return left > rest;
+        }
+        return false;
+    }
+
+    int n;
+    bool first = true;
+    vector<int> levels;
+};
+
+// -------------------- Isomers --------------------
+
+struct EnumerateOptions {
+    int carbons = 0;
+    vector<Element> halogens;  // Substituent elements to choose from
+    int substitutions = 0;     // Hydrogens replaced per isomer
+    bool formulas = false;     // Also print a condensed formula per isomer
+    bool check = false;        // Reparse each formula and compare names; count name clashes
+    unsigned threads = 0;
+};
+
+// Per-worker state
+struct WorkerState {
+    NamerScratch scratch;
+    MolecularGraph reparsed;
+    vector<int> parent;
+    vector<int> degree;
+    vector<int> lastAtLevel;
+    vector<int> slotAtom;
+    vector<int> slotHalogen;
+    vector<int> used;    // Hydrogens already replaced per carbon
+    vector<int> chosen;  // Slots picked so far
+    unordered_set<string> seen;  // Canonical codes of the current skeleton's isomers
+};
+
+struct Counters {
+    size_t isomers = 0;
+    size_t errors = 0;
+    size_t roundTripMismatches = 0;
+};
+
+// Builds the skeleton from a level sequence: the parent of each vertex is the last
+// vertex one level up. Returns false if some carbon would have more than four bonds.
+static bool buildSkeleton(const int* levels, int n, WorkerState& state) {
+    state.parent.assign(n, -1);
+    state.degree.assign(n, 0);
+    vector<int>& lastAtLevel = state.lastAtLevel;
+    lastAtLevel.assign(n + 1, -1);
+    for (int i = 0; i < n; i++) {
+        if (levels[i] > 0) {
+            int parent = lastAtLevel[levels[i] - 1];
+            state.parent[i] = parent;
+            if (++state.degree[parent] > 4 || ++state.degree[i] > 4) return false;
+        }
+        lastAtLevel[levels[i]] = i;
+    }
+    return true;
+}
+
+// Fills molecule with the skeleton plus one halogen per chosen slot
+static void buildMolecule(MolecularGraph& molecule, int n, const WorkerState& state) {
+    molecule.clear();
+    for (int i = 0; i < n; i++) {
+        int atom = molecule.addAtom(Element::C);
+        molecule.C_H_bonds[atom] = 4 - state.degree[i];
+    }
+    for (int i = 1; i < n; i++) {
+        molecule.addEdge(state.parent[i], i);
+    }
+    for (int slot : state.chosen) {
+        int carbon = state.slotAtom[slot];
+        int halogen = molecule.addAtom((Element)state.slotHalogen[slot]);
+        molecule.C_H_bonds[carbon]--;
+        molecule.addEdge(carbon, halogen);
+    }
+    molecule.finalize();
+}
+
+// Condensed formula in the notation the parser reads: every branch but the last is
+// parenthesized, halogens are written as (Cl) after their carbon
+static void writeFormula(const MolecularGraph& molecule, int atom, int from, string& out) {
+    out += 'C';
+    int hydrogens = molecule.C_H_bonds[atom];
+    if (hydrogens > 0) out += 'H';
+    if (hydrogens > 1) out += char('0' + hydrogens);
+
+    int lastCarbon = -1;
+    for (int neighbor : molecule.neighbors(atom)) {
+        if (neighbor == from) continue;
+        if (molecule.element[neighbor] != Element::C) {
+            out += '(';
+            out += elementSymbol(molecule.element[neighbor]);
+            out += ')';
+        } else {
+            lastCarbon = neighbor;
+        }
+    }
+    for (int neighbor : molecule.neighbors(atom)) {
+        if (neighbor == from || neighbor == lastCarbon || molecule.element[neighbor] != Element::C) continue;
+        out += '(';
+        writeFormula(molecule, neighbor, atom, out);
+        out += ')';
+    }
+    if (lastCarbon != -1) writeFormula(molecule, lastCarbon, atom, out);
+}
+
+// Names one isomer and appends its output line
+static void emitIsomer(MolecularGraph& molecule, const EnumerateOptions& options, const NamerOptions& namerOptions,
+                       WorkerState& state, string& out, Counters& counters) {
+    NamingResult result = processMolecularGraph(molecule, 0, state.scratch, namerOptions, nullptr);
+    counters.isomers++;
+    if (!result.error.empty()) counters.errors++;
+
+    string formula;
+    if (options.formulas || options.check) {
+        // Start from a terminal carbon so the formula reads as a chain
+        int start = 0;
+        for (int atom = 0; atom < molecule.atomCount(); atom++) {
+            if (molecule.element[atom] == Element::C && molecule.C_C_bonds[atom] <= 1) {
+                start = atom;
+                break;
+            }
+        }
+        writeFormula(molecule, start, -1, formula);
+    }
+
+    if (options.check) {
+        NamingResult reparsed;
+        if (!state.reparsed.parseMolecularFormula(formula)) {
+            reparsed = processMolecularGraph(state.reparsed, 0, state.scratch, namerOptions, nullptr);
+        }
+        if (reparsed.name != result.name) counters.roundTripMismatches++;
+    }
+
+    out += result.error.empty() ? result.name : "Error: " + result.error;
+    if (options.formulas) {
+        out += '\t';
+        out += formula;
+    }
+    out += '\n';
+}
+
+// Chooses the remaining substituents from slots >= firstSlot, then names the result
+// unless a symmetric placement was already named
+static void placeSubstituents(int firstSlot, int n, const EnumerateOptions& options, const NamerOptions& namerOptions,
+                              WorkerState& state, string& out, Counters& counters) {
+    if ((int)state.chosen.size() == options.substitutions) {
+        MolecularGraph& molecule = state.scratch.molecule;
+        buildMolecule(molecule, n, state);
+        if (state.seen.insert(canonicalize(molecule).code).second) {
+            emitIsomer(molecule, options, namerOptions, state, out, counters);
+        }
+        return;
+    }
+
+    for (int slot = firstSlot; slot < (int)state.slotAtom.size(); slot++) {
+        int carbon = state.slotAtom[slot];
+        if (state.used[carbon] >= 4 - state.degree[carbon]) continue;  // No hydrogen left
+        state.used[carbon]++;
+        state.chosen.push_back(slot);
+        placeSubstituents(slot, n, options, namerOptions, state, out, counters);  // Slots may repeat
+        state.chosen.pop_back();
+        state.used[carbon]--;
+    }
+}
+
+// Every placement of the substituents on one skeleton, up to symmetry. Slots are
+// (carbon, halogen) pairs; a multiset of slots is chosen in nondecreasing order so no
+// placement is generated twice, then symmetric placements are dropped by canonical code.
+static void enumerateSubstitutions(int n, const EnumerateOptions& options, const NamerOptions& namerOptions,
+                                   WorkerState& state, string& out, Counters& counters) {
+    MolecularGraph& molecule = state.scratch.molecule;
+    if (options.substitutions == 0) {
+        state.chosen.clear();
+        buildMolecule(molecule, n, state);
+        emitIsomer(molecule, options, namerOptions, state, out, counters);
+        return;
+    }
+
+    state.slotAtom.clear();
+    state.slotHalogen.clear();
+    for (int atom = 0; atom < n; atom++) {
+        for (Element halogen : options.halogens) {
+            state.slotAtom.push_back(atom);
+            state.slotHalogen.push_back((int)halogen);
+        }
+    }
+    state.seen.clear();
+
+    state.used.assign(n, 0);
+    state.chosen.clear();
+    placeSubstituents(0, n, options, namerOptions, state, out, counters);
+}
+
+// -------------------- Main Code --------------------
+
+static bool parseHalogens(const string& list, vector<Element>& halogens) {
+    size_t start = 0;
+    while (start <= list.size()) {
+        size_t end = list.find(',', start);
+        if (end == string::npos) end = list.size();
+        string item = list.substr(start, end - start);
+        if (item == "Cl") {
+            halogens.push_back(Element::Cl);
+        } else if (item == "Br") {
+            halogens.push_back(Element::Br);
+        } else {
+            return false;
+        }
+        start = end + 1;
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    EnumerateOptions options;
+    size_t batchSize = 4096;
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--halogens" && i + 1 < argc) {
+            if (!parseHalogens(argv[++i], options.halogens)) {
+                cerr << "Halogens must be a list of Cl and Br" << endl;
+                return 1;
+            }
+        } else if (arg == "--substitutions" && i + 1 < argc) {
+            options.substitutions = stoi(argv[++i]);
+        } else if (arg == "--formulas") {
+            options.formulas = true;
+        } else if (arg == "--check") {
+            options.check = true;
+        } else if (arg == "--threads" && i + 1 < argc) {
+            options.threads = stoul(argv[++i]);
+        } else if (arg == "--batch" && i + 1 < argc) {
+            batchSize = max(1ul, stoul(argv[++i]));
+        } else if (options.carbons == 0 && !arg.empty() && isdigit((unsigned char)arg[0])) {
+            options.carbons = stoi(arg);
+        } else {
+            options.carbons = 0;
+            break;
+        }
+    }
+    if (options.carbons <= 0) {
+        cerr << "Usage: enumerate CARBONS [--halogens Cl,Br] [--substitutions K] [--formulas] [--check]"
+                " [--threads N] [--batch N]" << endl;
+        return 1;
+    }
+    if (options.substitutions > 0 && options.halogens.empty()) {
+        options.halogens = {Element::Cl};
+    }
+
+    ios::sync_with_stdio(false);
+    int n = options.carbons;
+    NamerOptions namerOptions;
+    WorkStealingPool pool(options.threads);
+    vector<WorkerState> states(pool.size());
+    vector<Counters> workerCounters(pool.size());
+
+    // Skeletons are generated on this thread in batches; each batch is named across
+    // the pool and written in generation order
+    FreeTreeGenerator generator(n);
+    vector<int> batchLevels;
+    vector<string> outputs(batchSize);
+    vector<char> validSkeleton(batchSize);
+    unordered_set<string> names;
+    size_t skeletons = 0;
+    size_t nameClashes = 0;
+    bool more = true;
+
+    while (more) {
+        batchLevels.clear();
+        size_t count = 0;
+        while (count < batchSize && (more = generator.next())) {
+            const vector<int>& levels = generator.current();
+            batchLevels.insert(batchLevels.end(), levels.begin(), levels.end());
+            count++;
+        }
+        if (count == 0) break;
+
+        pool.parallelFor(count, 16, [&](size_t index, unsigned worker) {
+            WorkerState& state = states[worker];
+            string& out = outputs[index];
+            out.clear();
+            validSkeleton[index] = buildSkeleton(&batchLevels[index * n], n, state);
+            if (validSkeleton[index]) {
+                enumerateSubstitutions(n, options, namerOptions, state, out, workerCounters[worker]);
+            }
+        });
+
+        for (size_t index = 0; index < count; index++) {
+            const string& out = outputs[index];
+            skeletons += validSkeleton[index];
+            if (options.check) {
+                for (size_t start = 0; start < out.size();) {
+                    size_t end = out.find('\n', start);
+                    size_t tab = out.find('\t', start);
+                    string name = out.substr(start, min(end, tab) - start);
+                    if (!names.insert(name).second) nameClashes++;
+                    start = end + 1;
+                }
+            }
+            cout << out;
+        }
+    }
+    cout.flush();
+
+    Counters total;
+    for (const Counters& counters : workerCounters) {
+        total.isomers += counters.isomers;
+        total.errors += counters.errors;
+        total.roundTripMismatches += counters.roundTripMismatches;
+    }
+    cerr << "Skeletons: " << skeletons << " isomers: " << total.isomers << " errors: " << total.errors;
+    if (options.check) {
+        cerr << " name clashes: " << nameClashes << " round-trip mismatches: " << total.roundTripMismatches;
+    }
+    cerr << endl;
+    return 0;
+}
@@ -0,0 +1,329 @@
+#include "fingerprint.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#include <fcntl.h>
+#include <immintrin.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "thread_pool.h"
+
+using namespace std;
+
+// -------------------- Fingerprints --------------------
+
+int Fingerprint::bitCount() const {
+    int count = 0;
+    for (uint64_t word : words) count += popcount(word);
+    return count;
+}
+
+// splitmix64 finalizer: every input bit affects every output bit
+static uint64_t mix(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ull;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebull;
+    x ^= x >> 31;
+    return x;
+}
+
+Fingerprint circularFingerprint(const MolecularGraph& molecule, int radius) {
+    Fingerprint fingerprint;
+    auto setBit = [&](uint64_t hash) { fingerprint.words[(hash >> 6) % fingerprintWords] |= 1ull << (hash & 63); };
+
+    int n = molecule.atomCount();
+    vector<uint64_t> hashes(n);
+    for (int atom = 0; atom < n; atom++) {
+        uint64_t invariant = (uint64_t)molecule.element[atom] | (uint64_t)molecule.neighbors(atom).size() << 8 |
+                             (uint64_t)molecule.C_H_bonds[atom] << 16;
+        hashes[atom] = mix(invariant);
+        setBit(hashes[atom]);
+    }
+
+    vector<uint64_t> next(n);
+    vector<uint64_t> around;
+    for (int round = 1; round <= radius; round++) {
+        for (int atom = 0; atom < n; atom++) {
+            around.clear();
+            for (int neighbor : molecule.neighbors(atom)) around.push_back(hashes[neighbor]);
+            sort(around.begin(), around.end());  // Neighbour order in the formula must not matter
+
+            uint64_t hash = mix(hashes[atom] ^ round);
+            for (uint64_t neighborHash : around) hash = mix(hash ^ neighborHash);
+            next[atom] = hash;
+            setBit(hash);
+        }
+        swap(hashes, next);
+    }
+    return fingerprint;
+}
+
+double tanimoto(const Fingerprint& a, const Fingerprint& b) {
+    int common = 0;
+    int either = 0;
+    for (int i = 0; i < fingerprintWords; i++) {
+        common += popcount(a.words[i] & b.words[i]);
+        either += popcount(a.words[i] | b.words[i]);
+    }
+    return either ? (double)common / either : 0;
+}
+
+// -------------------- Index File --------------------
+
+namespace {
+
+struct IndexHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t wordsPerFingerprint;
+    uint64_t entries;
+    uint64_t bitCountOffset;
+    uint64_t formulaOffsetsOffset;
+    uint64_t formulaBytesOffset;
+    uint64_t fileBytes;
+    uint64_t reserved;
+};
+static_assert(sizeof(IndexHeader) == 64);
+
+constexpr char indexMagic[8] = {'T', 'K', 'F', 'P', 'I', 'D', 'X', '\0'};
+constexpr uint32_t indexVersion = 1;
+
+}  // namespace
+
+void FingerprintIndexWriter::add(string_view formula, const Fingerprint& fingerprint) {
+    words.insert(words.end(), fingerprint.words.begin(), fingerprint.words.end());
+    bitCounts.push_back(fingerprint.bitCount());
+    formulas += formula;
+    formulaOffsets.push_back(formulas.size());
+}
+
+bool FingerprintIndexWriter::save(const string& path) const {
+    IndexHeader header{};
+    memcpy(header.magic, indexMagic, sizeof(indexMagic));
+    header.version = indexVersion;
+    header.wordsPerFingerprint = fingerprintWords;
+    header.entries = size();
+    header.bitCountOffset = sizeof(IndexHeader) + words.size() * sizeof(uint64_t);
+    header.formulaOffsetsOffset = (header.bitCountOffset + bitCounts.size() * sizeof(uint16_t) + 7) / 8 * 8;
+    header.formulaBytesOffset = header.formulaOffsetsOffset + formulaOffsets.size() * sizeof(uint64_t);
+    header.fileBytes = header.formulaBytesOffset + formulas.size();
+
+    string temporary = path + ".tmp." + to_string(getpid());
+    {
+        ofstream out(temporary, ios::binary);
+        if (!out) return false;
+        const char padding[8] = {};
+        out.write((const char*)&header, sizeof(header));
+        out.write((const char*)words.data(), words.size() * sizeof(uint64_t));
+        out.write((const char*)bitCounts.data(), bitCounts.size() * sizeof(uint16_t));
+        out.write(padding, header.formulaOffsetsOffset - header.bitCountOffset - bitCounts.size() * sizeof(uint16_t));
+        out.write((const char*)formulaOffsets.data(), formulaOffsets.size() * sizeof(uint64_t));
+        out.write(formulas.data(), formulas.size());
+        if (!out) return false;
+    }
+    return rename(temporary.c_str(), path.c_str()) == 0;
+}
+
+FingerprintIndex::~FingerprintIndex() {
+    if (mapped) munmap(const_cast<char*>(mapped), mappedBytes);
+}
+
+bool FingerprintIndex::open(const string& path, string& error) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        error = strerror(errno);
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        error = strerror(errno);
+        ::close(fd);
+        return false;
+    }
+    size_t bytes = info.st_size;
+    if (bytes < sizeof(IndexHeader)) {
+        error = "not a fingerprint index";
+        ::close(fd);
+        return false;
+    }
+    void* data = mmap(nullptr, bytes, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED) {
+        error = strerror(errno);
+        return false;
+    }
+
+    // Every section has to lie inside the file before anything points into it
+    const IndexHeader& header = *static_cast<const IndexHeader*>(data);
+    const char* base = static_cast<const char*>(data);
+    uint64_t n = header.entries;
+    bool valid = memcmp(header.magic, indexMagic, sizeof(indexMagic)) == 0 && header.fileBytes == bytes &&
+                 n <= bytes / (fingerprintWords * sizeof(uint64_t)) &&
+                 header.bitCountOffset == sizeof(IndexHeader) + n * fingerprintWords * sizeof(uint64_t) &&
+                 header.formulaOffsetsOffset >= header.bitCountOffset + n * sizeof(uint16_t) &&
+                 header.formulaOffsetsOffset % 8 == 0 &&
+                 header.formulaBytesOffset == header.formulaOffsetsOffset + (n + 1) * sizeof(uint64_t) &&
+                 header.formulaBytesOffset <= bytes;
+    if (valid && (header.version != indexVersion || header.wordsPerFingerprint != fingerprintWords)) {
+        munmap(data, bytes);
+        error = "unsupported fingerprint index version";
+        return false;
+    }
+    if (valid) {
+        const uint64_t* offsets = reinterpret_cast<const uint64_t*>(base + header.formulaOffsetsOffset);
+        valid = offsets[0] == 0 && offsets[n] == bytes - header.formulaBytesOffset;
+    }
+    if (!valid) {
+        munmap(data, bytes);
+        error = "not a fingerprint index";
+        return false;
+    }
+
+    if (mapped) munmap(const_cast<char*>(mapped), mappedBytes);
+    madvise(data, bytes, MADV_WILLNEED);
+    mapped = base;
+    mappedBytes = bytes;
+    entries = n;
+    fingerprints = reinterpret_cast<const uint64_t*>(base + sizeof(IndexHeader));
+    bitCounts = reinterpret_cast<const uint16_t*>(base + header.bitCountOffset);
+    formulaOffsets = reinterpret_cast<const uint64_t*>(base + header.formulaOffsetsOffset);
+    formulaBytes = base + header.formulaBytesOffset;
+    __builtin_cpu_init();
+    useAvx2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt");
+    return true;
+}
+
+string_view FingerprintIndex::formula(size_t entry) const {
+    uint64_t first = formulaOffsets[entry];
+    uint64_t last = formulaOffsets[entry + 1];
+    if (first > last || last > formulaOffsets[entries]) return {};  // Damaged offsets
+    return string_view(formulaBytes + first, last - first);
+}
+
+// -------------------- Similarity Search --------------------
+
+// Higher similarity first, then lower entry
+static bool betterHit(const SimilarityHit& a, const SimilarityHit& b) {
+    return a.similarity > b.similarity || (a.similarity == b.similarity && a.entry < b.entry);
+}
+
+// The best k hits seen so far, as a heap with the worst of them on top
+namespace {
+
+class TopHits {
+public:
+    TopHits(vector<SimilarityHit>& hits, size_t k) : hits(hits), k(k) {}
+
+    // Lowest score that can still get in, or -1 while there is room
+    float threshold() const { return hits.size() < k ? -1.0f : hits.front().similarity; }
+
+    void offer(uint32_t entry, float similarity) {
+        SimilarityHit hit{entry, similarity};
+        if (hits.size() < k) {
+            hits.push_back(hit);
+            push_heap(hits.begin(), hits.end(), betterHit);
+        } else if (betterHit(hit, hits.front())) {
+            pop_heap(hits.begin(), hits.end(), betterHit);
+            hits.back() = hit;
+            push_heap(hits.begin(), hits.end(), betterHit);
+        }
+    }
+
+private:
+    vector<SimilarityHit>& hits;
+    size_t k;
+};
+
+}  // namespace
+
+// Tanimoto from bit counts. A score can be at most min / max of the two bit counts, so
+// entries whose bound is below the threshold are skipped; the division rounds the same
+// way for both, so the bound never undercuts the real score.
+static inline float similarityFrom(int query, int stored, int common) {
+    int either = query + stored - common;
+    return either ? (float)common / either : 0.0f;
+}
+
+static inline bool ruledOut(int query, int stored, float threshold) {
+    int larger = max(query, stored);
+    return larger && (float)min(query, stored) / larger < threshold;
+}
+
+__attribute__((target("popcnt"))) static void scanPopcnt(const uint64_t* query, int queryBits, const uint64_t* fingerprints,
+                                                         const uint16_t* bitCounts, size_t first, size_t last, TopHits& top) {
+    for (size_t entry = first; entry < last; entry++) {
+        if (ruledOut(queryBits, bitCounts[entry], top.threshold())) continue;
+        const uint64_t* stored = fingerprints + entry * fingerprintWords;
+        int common = 0;
+        for (int i = 0; i < fingerprintWords; i++) common += popcount(query[i] & stored[i]);
+        top.offer(entry, similarityFrom(queryBits, bitCounts[entry], common));
+    }
+}
+
+// Counts bits a nibble at a time with a 16-entry table lookup per byte lane, then adds
+// the byte counts up with a sum of absolute differences against zero
+__attribute__((target("avx2,popcnt"))) static void scanAvx2(const uint64_t* query, int queryBits, const uint64_t* fingerprints,
+                                                            const uint16_t* bitCounts, size_t first, size_t last, TopHits& top) {
+    const __m256i table = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                           0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i lowNibbles = _mm256_set1_epi8(0x0f);
+    __m256i queryWords[fingerprintWords / 4];
+    for (int i = 0; i < fingerprintWords / 4; i++) {
+        queryWords[i] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(query) + i);
+    }
+
+    for (size_t entry = first; entry < last; entry++) {
+        if (ruledOut(queryBits, bitCounts[entry], top.threshold())) continue;
+        const __m256i* stored = reinterpret_cast<const __m256i*>(fingerprints + entry * fingerprintWords);
+        __m256i byteCounts = _mm256_setzero_si256();
+        for (int i = 0; i < fingerprintWords / 4; i++) {
+            __m256i both = _mm256_and_si256(queryWords[i], _mm256_loadu_si256(stored + i));
+            __m256i low = _mm256_shuffle_epi8(table, _mm256_and_si256(both, lowNibbles));
+            __m256i high = _mm256_shuffle_epi8(table, _mm256_and_si256(_mm256_srli_epi16(both, 4), lowNibbles));
+            byteCounts = _mm256_add_epi8(byteCounts, _mm256_add_epi8(low, high));  // At most 32 per byte
+        }
+        __m256i sums = _mm256_sad_epu8(byteCounts, _mm256_setzero_si256());
+        __m128i halves = _mm_add_epi64(_mm256_castsi256_si128(sums), _mm256_extracti128_si256(sums, 1));
+        int common = _mm_cvtsi128_si64(halves) + _mm_extract_epi64(halves, 1);
+        top.offer(entry, similarityFrom(queryBits, bitCounts[entry], common));
+    }
+}
+
+void FingerprintIndex::scan(const Fingerprint& query, size_t first, size_t last, size_t k, vector<SimilarityHit>& best) const {
+    TopHits top(best, k);
+    if (useAvx2) {
+        scanAvx2(query.words.data(), query.bitCount(), fingerprints, bitCounts, first, last, top);
+    } else {
+        scanPopcnt(query.words.data(), query.bitCount(), fingerprints, bitCounts, first, last, top);
+    }
+}
+
+vector<SimilarityHit> FingerprintIndex::search(const Fingerprint& query, size_t k, WorkStealingPool* pool) const {
+    vector<SimilarityHit> hits;
+    if (k == 0 || entries == 0) return hits;
+
+    const size_t blockEntries = 1 << 14;  // 2 MiB of fingerprints per task
+    size_t blocks = (entries + blockEntries - 1) / blockEntries;
+    if (!pool || blocks == 1) {
+        scan(query, 0, entries, k, hits);
+    } else {
+        // Each worker keeps its own top k across the blocks it scans; the overall top k
+        // is among their union
+        vector<vector<SimilarityHit>> perWorker(pool->size());
+        pool->parallelFor(blocks, 1, [&](size_t block, unsigned worker) {
+            scan(query, block * blockEntries, min(entries, (block + 1) * blockEntries), k, perWorker[worker]);
+        });
+        for (const auto& workerHits : perWorker) hits.insert(hits.end(), workerHits.begin(), workerHits.end());
+    }
+
+    sort(hits.begin(), hits.end(), betterHit);
+    if (hits.size() > k) hits.resize(k);
+    return hits;
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "molecule.h"
+
+class WorkStealingPool;
+
+// 1024-bit structural fingerprint
+constexpr int fingerprintWords = 16;
+constexpr int fingerprintBits = fingerprintWords * 64;
+
+struct Fingerprint {
+    alignas(32) std::array<uint64_t, fingerprintWords> words{};
+
+    int bitCount() const;
+};
+
+// Circular (ECFP-style) fingerprint. Every atom starts from a hash of its element,
+// heavy-atom degree and hydrogens; each round rehashes it with the sorted hashes of
+// its neighbours, so after `radius` rounds it describes the atoms within that many
+// bonds. Every hash of every round sets one bit.
+Fingerprint circularFingerprint(const MolecularGraph& molecule, int radius = 2);
+
+// |a & b| / |a | b|; two empty fingerprints score 0
+double tanimoto(const Fingerprint& a, const Fingerprint& b);
+
+struct SimilarityHit {
+    uint32_t entry;
+    float similarity;
+};
+
+// Collects fingerprints with the formula they came from and writes them out as an
+// index file (see FingerprintIndex for the layout)
+class FingerprintIndexWriter {
+public:
+    void add(std::string_view formula, const Fingerprint& fingerprint);
+    size_t size() const { return bitCounts.size(); }
+
+    // Writes to a temporary file and renames it into place
+    bool save(const std::string& path) const;
+
+private:
+    std::vector<uint64_t> words;
+    std::vector<uint16_t> bitCounts;
+    std::vector<uint64_t> formulaOffsets = {0};
+    std::string formulas;
+};
+
+// Read-only fingerprint index, mapped from disk and used in place. The file is a
+// 64-byte header, then the fingerprints (128 bytes each, so every one is cache-line
+// aligned), their bit counts (uint16), formula offsets (uint64, one more than entries)
+// and the formula bytes. Numbers are in host byte order.
+class FingerprintIndex {
+public:
+    FingerprintIndex() = default;
+    ~FingerprintIndex();
+
+    FingerprintIndex(const FingerprintIndex&) = delete;
+    FingerprintIndex& operator=(const FingerprintIndex&) = delete;
+
+    bool open(const std::string& path, std::string& error);
+
+    size_t size() const { return entries; }
+    std::string_view formula(size_t entry) const;
+
+    // The k entries most similar to the query, best first; equal scores keep index
+    // order. Entries whose bit count alone rules them out of the current top k are
+    // skipped without reading their fingerprint. With a pool the index is scanned in
+    // blocks across its workers.
+    std::vector<SimilarityHit> search(const Fingerprint& query, size_t k, WorkStealingPool* pool = nullptr) const;
+
+private:
+    void scan(const Fingerprint& query, size_t first, size_t last, size_t k, std::vector<SimilarityHit>& best) const;
+
+    const char* mapped = nullptr;
+    size_t mappedBytes = 0;
+    size_t entries = 0;
+    const uint64_t* fingerprints = nullptr;
+    const uint16_t* bitCounts = nullptr;
+    const uint64_t* formulaOffsets = nullptr;
+    const char* formulaBytes = nullptr;
+    bool useAvx2 = false;
+};
@@ -0,0 +1,209 @@
+#include "graph_store.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+struct StoreHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t flags;  // No optional sections yet; must be 0
+    uint64_t records;
+    uint64_t atoms;
+    uint64_t extraBonds;
+    uint64_t atomBytesOffset;
+    uint64_t fileBytes;
+    uint64_t reserved;
+};
+static_assert(sizeof(StoreHeader) == 64);
+
+constexpr char storeMagic[8] = {'T', 'K', 'G', 'R', 'A', 'P', 'H', '\0'};
+constexpr uint32_t storeVersion = 1;
+
+constexpr int maxLink = 255;
+
+}  // namespace
+
+// -------------------- Writing --------------------
+
+bool GraphStoreWriter::add(const MolecularGraph& molecule) {
+    int n = molecule.atomCount();
+    if (n > 65535) {
+        addEmpty();
+        return false;
+    }
+
+    size_t first = atoms.size();
+    for (int atom = 0; atom < n; atom++) {
+        atoms.push_back((uint8_t)molecule.element[atom] | molecule.C_H_bonds[atom] << 3);
+    }
+    links.resize(first + n, 0);
+
+    // Each atom links back to the first earlier atom it is bonded to within reach
+    for (auto [a, b] : molecule.edges) {
+        int later = max(a, b), earlier = min(a, b);
+        uint8_t& link = links[first + later];
+        if (link == 0 && later - earlier <= maxLink) {
+            link = later - earlier;
+        } else {
+            extraBonds.push_back(earlier);
+            extraBonds.push_back(later);
+        }
+    }
+    atomOffsets.push_back(atoms.size());
+    bondOffsets.push_back(extraBonds.size() / 2);
+    return true;
+}
+
+void GraphStoreWriter::addEmpty() {
+    atomOffsets.push_back(atoms.size());
+    bondOffsets.push_back(extraBonds.size() / 2);
+}
+
+bool GraphStoreWriter::save(const string& path) const {
+    StoreHeader header{};
+    memcpy(header.magic, storeMagic, sizeof(storeMagic));
+    header.version = storeVersion;
+    header.records = size();
+    header.atoms = atoms.size();
+    header.extraBonds = extraBonds.size() / 2;
+    header.atomBytesOffset = sizeof(StoreHeader) + (atomOffsets.size() + bondOffsets.size()) * sizeof(uint64_t);
+    // The atom and link bytes add up to an even count, so the extra bonds stay aligned
+    header.fileBytes = header.atomBytesOffset + 2 * atoms.size() + extraBonds.size() * sizeof(uint16_t);
+
+    string temporary = path + ".tmp." + to_string(getpid());
+    {
+        ofstream out(temporary, ios::binary);
+        if (!out) return false;
+        out.write((const char*)&header, sizeof(header));
+        out.write((const char*)atomOffsets.data(), atomOffsets.size() * sizeof(uint64_t));
+        out.write((const char*)bondOffsets.data(), bondOffsets.size() * sizeof(uint64_t));
+        out.write((const char*)atoms.data(), atoms.size());
+        out.write((const char*)links.data(), links.size());
+        out.write((const char*)extraBonds.data(), extraBonds.size() * sizeof(uint16_t));
+        if (!out) return false;
+    }
+    return rename(temporary.c_str(), path.c_str()) == 0;
+}
+
+// -------------------- Reading --------------------
+
+GraphStore::~GraphStore() {
+    if (mapped) munmap(const_cast<char*>(mapped), mappedBytes);
+}
+
+bool GraphStore::open(const string& path, string& error) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        error = strerror(errno);
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        error = strerror(errno);
+        ::close(fd);
+        return false;
+    }
+    size_t bytes = info.st_size;
+    if (bytes < sizeof(StoreHeader)) {
+        error = "not a graph store";
+        ::close(fd);
+        return false;
+    }
+    void* data = mmap(nullptr, bytes, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED) {
+        error = strerror(errno);
+        return false;
+    }
+
+    // Every section has to lie inside the file before anything points into it
+    const StoreHeader& header = *static_cast<const StoreHeader*>(data);
+    const char* base = static_cast<const char*>(data);
+    uint64_t n = header.records;
+    uint64_t atomBytes = header.atomBytesOffset + 2 * header.atoms;
+    bool valid = memcmp(header.magic, storeMagic, sizeof(storeMagic)) == 0 && header.fileBytes == bytes &&
+                 n < bytes / (2 * sizeof(uint64_t)) && header.atoms <= bytes && header.extraBonds <= bytes &&
+                 header.atomBytesOffset == sizeof(StoreHeader) + 2 * (n + 1) * sizeof(uint64_t) &&
+                 atomBytes + header.extraBonds * 2 * sizeof(uint16_t) == bytes;
+    if (valid && (header.version != storeVersion || header.flags != 0)) {
+        munmap(data, bytes);
+        error = "unsupported graph store version";
+        return false;
+    }
+    if (valid) {
+        const uint64_t* offsets = reinterpret_cast<const uint64_t*>(base + sizeof(StoreHeader));
+        valid = offsets[0] == 0 && offsets[n] == header.atoms && offsets[n + 1] == 0 &&
+                offsets[2 * n + 1] == header.extraBonds;
+    }
+    if (!valid) {
+        munmap(data, bytes);
+        error = "not a graph store";
+        return false;
+    }
+
+    if (mapped) munmap(const_cast<char*>(mapped), mappedBytes);
+    madvise(data, bytes, MADV_SEQUENTIAL);
+    mapped = base;
+    mappedBytes = bytes;
+    records = n;
+    atomOffsets = reinterpret_cast<const uint64_t*>(base + sizeof(StoreHeader));
+    bondOffsets = atomOffsets + n + 1;
+    atoms = reinterpret_cast<const uint8_t*>(base + header.atomBytesOffset);
+    links = atoms + header.atoms;
+    extraBonds = reinterpret_cast<const uint16_t*>(base + atomBytes);
+    return true;
+}
+
+bool GraphStore::load(size_t record, MolecularGraph& molecule) const {
+    molecule.clear();
+    uint64_t first = atomOffsets[record], last = atomOffsets[record + 1];
+    uint64_t firstBond = bondOffsets[record], lastBond = bondOffsets[record + 1];
+    if (first >= last || last > atomOffsets[records] || last - first > 65535 || firstBond > lastBond ||
+        lastBond > bondOffsets[records]) {
+        return false;  // Empty or damaged
+    }
+
+    // Sized once and filled in place: the atom bytes are all there is to read
+    int n = last - first;
+    molecule.element.resize(n);
+    molecule.C_H_bonds.resize(n);
+    molecule.C_C_bonds.assign(n, 0);
+    molecule.C_X_bonds.assign(n, 0);
+    molecule.sourceOffset.resize(n);
+    molecule.edges.reserve(n - 1 + (lastBond - firstBond));
+    for (int atom = 0; atom < n; atom++) {
+        uint8_t code = atoms[first + atom];
+        molecule.element[atom] = Element(code & 7);
+        molecule.C_H_bonds[atom] = code >> 3;
+        molecule.sourceOffset[atom] = atom;
+    }
+    for (int atom = 1; atom < n; atom++) {
+        int link = links[first + atom];
+        if (link > atom) {
+            molecule.clear();
+            return false;
+        }
+        if (link) molecule.addEdge(atom - link, atom);
+    }
+    for (uint64_t bond = firstBond; bond < lastBond; bond++) {
+        int a = extraBonds[2 * bond], b = extraBonds[2 * bond + 1];
+        if (a >= n || b >= n || a == b) {
+            molecule.clear();
+            return false;
+        }
+        molecule.addEdge(a, b);
+    }
+    molecule.finalize();
+    return true;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "molecule.h"
+
+// Collects parsed molecules and writes them out as a graph store file (see GraphStore
+// for the layout). Records keep the order they were added in.
+class GraphStoreWriter {
+public:
+    // Adds molecule, or an empty record when it cannot be stored (more than 65535
+    // atoms); returns false in that case
+    bool add(const MolecularGraph& molecule);
+
+    // An empty record, keeping the numbering in step with the input lines
+    void addEmpty();
+
+    size_t size() const { return atomOffsets.size() - 1; }
+
+    // Writes to a temporary file and renames it into place
+    bool save(const std::string& path) const;
+
+private:
+    std::vector<uint8_t> atoms;
+    std::vector<uint8_t> links;
+    std::vector<uint64_t> atomOffsets = {0};
+    std::vector<uint16_t> extraBonds;
+    std::vector<uint64_t> bondOffsets = {0};
+};
+
+// Read-only graph store, mapped from disk and read in place: molecules parsed once,
+// so naming them again needs no parsing. The file is a 64-byte header, then per record
+// the offset of its first atom (uint64, one more than records) and of its first extra
+// bond (likewise), then one byte per atom (element code in the low 3 bits, hydrogens
+// above), one link byte per atom, and the extra bonds as uint16 pairs of atom numbers
+// within the record. Atoms come in parse order, so nearly every atom is bonded to one
+// a few places before it; its link byte holds that distance (0 for none), and only
+// ring closures and far branch points need an extra bond. That takes about two bytes
+// per atom against three or more for a condensed formula. Numbers are in host byte
+// order.
+class GraphStore {
+public:
+    GraphStore() = default;
+    ~GraphStore();
+
+    GraphStore(const GraphStore&) = delete;
+    GraphStore& operator=(const GraphStore&) = delete;
+
+    bool open(const std::string& path, std::string& error);
+
+    size_t size() const { return records; }
+
+    // Replaces molecule with record's atoms and bonds, adjacency built. sourceOffset
+    // holds atom numbers. Returns false for an empty record or a damaged one, leaving
+    // molecule empty.
+    bool load(size_t record, MolecularGraph& molecule) const;
+
+private:
+    const char* mapped = nullptr;
+    size_t mappedBytes = 0;
+    size_t records = 0;
+    const uint64_t* atomOffsets = nullptr;
+    const uint64_t* bondOffsets = nullptr;
+    const uint8_t* atoms = nullptr;
+    const uint8_t* links = nullptr;
+    const uint16_t* extraBonds = nullptr;
+};
@@ -1,612 +1,871 @@
-#include <iostream>
-#include <vector>
-#include <unordered_map>
-#include <unordered_set>
-#include <string>
-#include <algorithm>
-#include <stack>
-#include <sstream>
-
-using namespace std;
-
-class CarbonNode {
-public:
-    int id;
-    int C_C_bonds = 0;
-    int C_H_bonds = 0;
-    int C_X_bonds = 0;
-    string label;
-
-    CarbonNode() : id(0), label("C") {}
-
-    CarbonNode(int id, const string& label = "C") : id(id), label(label) {}
-
-    void incrementC_C() { C_C_bonds++; }
-    void incrementC_H(int numH) { C_H_bonds = numH; }
-    void incrementC_X() { C_X_bonds++; }
-
-    int getTotalBonds() const { return C_C_bonds + C_H_bonds + C_X_bonds; }
-
-    void printInfo() const {
-        cout << label << id << ": C-C=" << C_C_bonds << ", C-H=" << C_H_bonds << ", C-X=" << C_X_bonds << "; ";
-    }
-};
-
-class MolecularGraph {
-public:
-    unordered_map<int, CarbonNode> carbons;
-    unordered_map<int, vector<int>> adjacencyList;
-    vector<pair<int, int>> edges;
-    vector<pair<string, string>> input;
-    
-    int counter = 1;
-
-    void addCarbon(const string& label) {
-        carbons[counter] = CarbonNode(counter, label);
-        counter++;
-    }
-
-    void addEdge(int id1, int id2) {
-        carbons[id1].incrementC_C();
-        carbons[id2].incrementC_C();
-        edges.emplace_back(id1, id2);
-        adjacencyList[id1].push_back(id2);
-        adjacencyList[id2].push_back(id1);
-    }
-
-    void parseMolecularFormula(const string& formula) {
-        stack<int> branchPoints;
-        int previousCarbon = 0;
-
-        for (size_t i = 0; i < formula.size();) {
-            char ch = formula[i];
-            string label(1, ch);
-
-            if (ch == 'C') {
-                if (i + 1 < formula.size() && formula[i + 1] == 'l') {
-                    label = "Cl";
-                    carbons[counter - 1].incrementC_X();
-                    i++;
-                } else if (i + 1 < formula.size() && formula[i + 1] == 'O') {
-                    label = "COOH";
-                    i += 3;
-                }
-
-                addCarbon(label);
-                int currentCarbon = counter - 1;
-
-                if (i + 1 < formula.size() && formula[i + 1] == 'H') {
-                    int numH = 1;
-                    i++;
-                    if (i + 1 < formula.size() && isdigit(formula[i + 1])) {
-                        numH = formula[i + 1] - '0';
-                        i++;
-                    }
-                    carbons[currentCarbon].incrementC_H(numH);
-                }
-
-                if (previousCarbon != 0) {
-                    addEdge(previousCarbon, currentCarbon);
-                }
-
-                previousCarbon = currentCarbon;
-                i++;
-            } else if (ch == '(') {
-                branchPoints.push(previousCarbon);
-                i++;
-            } else if (ch == ')') {
-                if (!branchPoints.empty()) {
-                    previousCarbon = branchPoints.top();
-                    branchPoints.pop();
-                }
-                i++;
-            } else {
-                if (isalpha(ch)) {
-                    string halogenLabel(1, ch);
-                    if (i + 1 < formula.size() && islower(formula[i + 1])) {
-                        halogenLabel += formula[i + 1];
-                        i++;
-                    }
-                    addCarbon(halogenLabel);
-                    int currentAtom = counter - 1;
-
-                    previousCarbon = currentAtom;
-                    i++;
-                }
-            }
-        }
-    }
-
-    bool hasCyclicEdge() {
-        vector<int> candidates;
-        for (const auto& pair : carbons) {
-            if (pair.second.getTotalBonds() == 3) {
-                candidates.push_back(pair.first);
-            }
-        }
-
-        if (candidates.size() >= 2) {
-            addEdge(candidates[0], candidates[1]);
-            cout << "Added cyclic edge between nodes " << candidates[0] << " and " << candidates[1] << endl;
-            cout << endl;
-            return true;
-        }
-        return false;
-    }
-
-    void printAtomsInfo() const {
-        cout << "Atoms Info" << endl;
-        for (const auto& pair : carbons) {
-            pair.second.printInfo();
-            cout << endl;
-        }
-        cout << endl;
-    }
-
-    void printEdges()
-    {
-        cout << "Edges" << endl;
-        for (const auto& edge : edges) {
-            cout << carbons.at(edge.first).label << edge.first << "-"
-                 << carbons.at(edge.second).label << edge.second << endl;
-            
-            string label1 = carbons.at(edge.first).label + to_string(edge.first);
-            string label2 = carbons.at(edge.second).label + to_string(edge.second);
-            input.emplace_back(label1, label2);
-        }
-        cout << endl;
-    }
-};
-
-// -------------------- Helper Functions --------------------
-
-// Graph represented as an adjacency list
-unordered_map<int, vector<int>> graph;
-
-// Function to add an edge to the graph
-void addEdge(int u, int v) {
-    graph[u].push_back(v);
-    graph[v].push_back(u);
-}
-
-// Modified DFS to track path
-pair<int, vector<int>> dfsWithConditions(int node, unordered_set<int>& visited, const unordered_set<int>& ignoredNodes) {
-    visited.insert(node);
-    int maxLength = 0;
-    vector<int> longestPath = {node};
-
-    for (int neighbor : graph[node]) {
-        if (visited.find(neighbor) == visited.end() && ignoredNodes.find(neighbor) == ignoredNodes.end()) {
-            auto [length, path] = dfsWithConditions(neighbor, visited, ignoredNodes);
-            if (length + 1 > maxLength) {
-                maxLength = length + 1;
-                longestPath = {node};
-                longestPath.insert(longestPath.end(), path.begin(), path.end());
-            }
-        }
-    }
-    visited.erase(node); // Backtrack
-    return {maxLength, longestPath};
-}
-
-// Function to find the longest carbon chain with path tracking
-vector<int> findLongestCarbonChain(int startNode, const unordered_set<int>& ignoredNodes) {
-    unordered_set<int> visited;
-
-    // Step 1: First DFS to find the farthest node from startNode
-    auto [_, farthestNodePath] = dfsWithConditions(startNode, visited, ignoredNodes);
-    int farthestNode = farthestNodePath.back();
-
-    // Step 2: Second DFS from the farthest node found in the first DFS
-    visited.clear();
-    auto [longestChainLength, longestChainPath] = dfsWithConditions(farthestNode, visited, ignoredNodes);
-
-    return longestChainPath; // Returns the path (chain of nodes) in one direction
-}
-
-vector<int> getOptimalChainDirection(const vector<int>& chain, const unordered_map<int, vector<int>>& branchInfo) {
-    vector<int> leftLocants, rightLocants;
-
-    // Calculate left-to-right locants for branches
-    for (size_t i = 0; i < chain.size(); i++) {
-        int atom = chain[i];
-        if (branchInfo.find(atom) != branchInfo.end()) {
-            leftLocants.push_back(i + 1); // Locants from left side
-        }
-    }
-
-    // Calculate right-to-left locants for branches
-    for (size_t i = 0; i < chain.size(); i++) {
-        int atom = chain[chain.size() - i - 1];
-        if (branchInfo.find(atom) != branchInfo.end()) {
-            rightLocants.push_back(i + 1); // Locants from right side
-        }
-    }
-
-    // Perform lexicographical comparison
-    if (leftLocants < rightLocants) {
-        return chain; // Left-to-right is lexicographically smaller
-    } else {
-        return vector<int>(chain.rbegin(), chain.rend()); // Reverse for right-to-left
-    }
-}
-
-
-
-string formatBranchName(int numCarbons, int halogenType) {
-    string branchName;
-
-    // Set the branch name based on the number of carbons
-    if (numCarbons == 1) {
-        branchName = "methyl";
-    } else if (numCarbons == 2) {
-        branchName = "ethyl";
-    } else if (numCarbons == 3) {
-        branchName = "propyl";
-    } else if (numCarbons == 4) {
-        branchName = "butyl";
-    } 
-    // else {
-    //     branchName = to_string(numCarbons) + "-butyl";  // For simplicity, use "butyl" as a generic name for larger chains
-    // }
-
-    // Add the specific halogen prefix if halogenType is set
-    if (halogenType > 0) {
-        switch (halogenType) {
-            case 1:
-                branchName = "chloro-" + branchName;
-                break;
-            case 2:
-                branchName = "bromo-" + branchName;
-                break;
-            // Add other cases for additional halogens as needed
-            default:
-                branchName = "halo-" + branchName;  // Fallback for unspecified halogens
-        }
-    }
-
-    return branchName;
-}
-
-
-/// Helper function to combine branches with identical names and add prefixes for duplicates
-vector<string> combineBranches(const vector<string>& branches) {
-    vector<string> combinedBranches;
-    int i = 0;
-
-    while (i < branches.size()) {
-        // Extract locant and branch name
-        size_t dashPos = branches[i].find('-');
-        string locant = branches[i].substr(0, dashPos);
-        string branchName = branches[i].substr(dashPos + 1);
-
-        vector<string> locants = {locant};
-
-        // Check for identical consecutive branch names and collect their locants
-        while (i + 1 < branches.size() && branches[i + 1].find("-" + branchName) != string::npos) {
-            size_t nextDashPos = branches[i + 1].find('-');
-            string nextLocant = branches[i + 1].substr(0, nextDashPos);
-            locants.push_back(nextLocant);
-            i++;
-        }
-
-        // Combine locants if there are multiple, otherwise keep single locant
-        if (locants.size() > 1) {
-            string prefix = ""; // Prefix for naming based on the count
-            if (locants.size() == 2) {
-                prefix = "di";
-            } else if (locants.size() == 3) {
-                prefix = "tri";
-            } else if (locants.size() > 3) {
-                prefix = to_string(locants.size()) + "-";
-            }
-
-            string combinedLocants = "(" + locants[0];
-            for (size_t j = 1; j < locants.size(); j++) {
-                combinedLocants += "," + locants[j];
-            }
-            combinedLocants += ")";
-            combinedBranches.push_back(combinedLocants + "-" + prefix + branchName);
-        } else {
-            combinedBranches.push_back(locants[0] + "-" + branchName);
-        }
-
-        i++;
-    }
-
-    return combinedBranches;
-}
-
-
-
-string generateIUPACName(const vector<int>& longestChain, const unordered_map<int, string>& idToLabel, unordered_map<int, vector<int>>& branchInfo, int counter) {
-    int numCarbons = longestChain.size();
-    string chainName;
-    if (numCarbons == 1) chainName = "Meth";
-    else if (numCarbons == 2) chainName = "Eth";
-    else if (numCarbons == 3) chainName = "Prop";
-    else if (numCarbons == 4) chainName = "But";
-    else if (numCarbons == 5) chainName = "Pent";
-    else if (numCarbons == 6) chainName = "Hex";
-    else if (numCarbons == 7) chainName = "Hept";
-    else if (numCarbons == 8) chainName = "Oct";
-    else if (numCarbons == 9) chainName = "Non";
-    else if (numCarbons == 10) chainName = "Dec";
-
-    if(counter==0)
-    {
-        chainName = chainName + "ane";
-    }
-    else if (counter==1)
-    {
-        chainName = chainName + "an";
-    }
-    else if(counter==2)
-    {
-        chainName = chainName + "yl";
-    }
-    
-
-    // Generate branch names with locants
-    vector<string> branches;
-    for (size_t i = 0; i < longestChain.size(); i++) {
-        int atom = longestChain[i];
-        if (branchInfo.find(atom) != branchInfo.end()) {
-            int numCarbonsInBranch = branchInfo[atom][0];
-            int halogenType = branchInfo[atom][1];
-            string branchName = formatBranchName(numCarbonsInBranch, halogenType);
-            int locant = i + 1;  // 1-based locant
-            branches.push_back(to_string(locant) + "-" + branchName);
-        }
-    }
-
-    // Sort branches by locants to ensure correct order
-    sort(branches.begin(), branches.end());
-
-    // Combine branches with identical names
-    vector<string> combinedBranches = combineBranches(branches);
-
-    // Combine branch information with the main chain name
-    string finalName;
-    for (const string& branch : combinedBranches) {
-        finalName += branch + " ";
-    }
-    finalName += chainName; // Append main chain name after branches
-
-    return finalName;
-}
-
-
-#include <stack>
-
-// Helper function to count carbons and detect halogens in a branch starting from a given node
-pair<int, int> countBranchCarbons(int start, const unordered_set<int>& mainChainNodes, const unordered_map<int, string>& idToLabel) {
-    unordered_set<int> visited;  // Track visited nodes within the branch
-    stack<int> toVisit;
-    toVisit.push(start);
-
-    int carbonCount = 0;
-    int halogenType = 0;  // 0 indicates no halogen; 1 for chlorine, 2 for bromine, etc.
-
-    // Iterative DFS to explore the branch fully
-    while (!toVisit.empty()) {
-        int node = toVisit.top();
-        toVisit.pop();
-
-        // Get the label for the current node
-        string label = idToLabel.at(node);
-
-        // Debugging print to see the label being processed
-        cout << "Processing label: " << label << endl;
-
-        // Check if the node is a carbon (must start with "C" followed by a number)
-        if (label[0] == 'C' && label.substr(1).find_first_not_of("0123456789") == string::npos) {
-            carbonCount++;
-        } 
-        // Check if the node is a halogen (specific labels that start with Cl, Br, F, I, etc.)
-        else if (label.substr(0, 2) == "Cl" && label.length() > 2 && isdigit(label[2]) && halogenType == 0) {
-            halogenType = 1;  // Chlorine
-        } else if (label.substr(0, 2) == "Br" && label.length() > 2 && isdigit(label[2]) && halogenType == 0) {
-            halogenType = 2;  // Bromine
-        } else if (label.substr(0, 1) == "F" && label.length() > 1 && isdigit(label[1]) && halogenType == 0) {
-            halogenType = 3;  // Fluorine
-        } else if (label.substr(0, 1) == "I" && label.length() > 1 && isdigit(label[1]) && halogenType == 0) {
-            halogenType = 4;  // Iodine
-        }
-        // Add more halogens as needed
-
-        // Debug print to check halogenType and carbonCount
-        cout << "Detected label: " << label << ", halogenType: " << halogenType << ", carbonCount: " << carbonCount << endl;
-
-        visited.insert(node);  // Mark this node as visited
-
-        // Explore neighbors to find other carbons in the branch
-        for (int neighbor : graph[node]) {
-            if (visited.find(neighbor) == visited.end() && mainChainNodes.find(neighbor) == mainChainNodes.end()) {
-                visited.insert(neighbor);  // Mark the neighbor as visited in the branch
-                toVisit.push(neighbor);
-            }
-        }
-    }
-
-    return {carbonCount, halogenType};
-}
-
-// Helper function to detect if a node is a COOH group (e.g., COOH1, COOH2)
-bool isCOOHGroup(const string& label) {
-    return label.substr(0, 4) == "COOH" && label.length() > 4 && isdigit(label[4]);
-}
-
-vector<int> findLongestChainWithCOOH(const unordered_set<int>& coohNodes, const unordered_set<int>& ignoredNodes) {
-    vector<int> longestChain;
-
-    for (int coohNode : coohNodes) {
-        unordered_set<int> visited;
-        // Start DFS from the COOH node
-        auto [_, path] = dfsWithConditions(coohNode, visited, ignoredNodes);
-
-        // Keep track of the longest path found
-        if (path.size() > longestChain.size()) {
-            longestChain = path;
-        }
-    }
-
-    // If the COOH group is at the end of the chain, reverse the chain
-    // if (!longestChain.empty() && longestChain.back() == *coohNodes.begin()) {
-    reverse(longestChain.begin(), longestChain.end());
-    // }
-
-    return longestChain;
-}
-
-// Modify the function signature to return a string
-string processMolecularGraph(MolecularGraph& graph1, int hint) {
-    graph1.printAtomsInfo();
-    bool cycle = graph1.hasCyclicEdge();
-    if(cycle) return 0;
-    graph1.printEdges();
-
-    vector<pair<string, string>> edgeList = graph1.input;
-
-    int counter = 0;
-
-    unordered_map<string, int> labelToID;
-    unordered_map<int, string> idToLabel;
-    int currentID = 0;
-    unordered_set<int> coohNodes;  // Set to store COOH node IDs
-    unordered_map<int, vector<int>> branchInfo;
-
-    unordered_set<int> ignoredNodes;
-
-    // Assign IDs and build graph
-    for (const auto& edge : edgeList) {
-        string nodeA = edge.first;
-        string nodeB = edge.second;
-
-        if (labelToID.find(nodeA) == labelToID.end()) {
-            labelToID[nodeA] = currentID;
-            idToLabel[currentID] = nodeA;
-            currentID++;
-        }
-        if (labelToID.find(nodeB) == labelToID.end()) {
-            labelToID[nodeB] = currentID;
-            idToLabel[currentID] = nodeB;
-            currentID++;
-        }
-
-        int idA = labelToID[nodeA];
-        int idB = labelToID[nodeB];
-        addEdge(idA, idB);
-
-        // Check if the node is a COOH group
-        if (isCOOHGroup(nodeA)) {
-            coohNodes.insert(idA);
-        }
-        if (isCOOHGroup(nodeB)) {
-            coohNodes.insert(idB);
-        }
-
-        // Ignore non-carbon nodes for main chain detection
-        if (nodeA[0] != 'C') ignoredNodes.insert(idA);
-        if (nodeB[0] != 'C') ignoredNodes.insert(idB);
-    }
-
-    vector<int> carbonNodes;
-    for (const auto& pair : labelToID) {
-        if (pair.first[0] == 'C') {
-            carbonNodes.push_back(pair.second);
-        }
-    }
-
-    if (carbonNodes.empty()) {
-        cout << "No carbon atoms found in the input.\n";
-        return "";
-    }
-
-   // Step 1: If COOH group is found, find the longest chain starting from COOH
-    vector<int> longestChain;
-    if (!coohNodes.empty()) {
-        counter = 1;
-        longestChain = findLongestChainWithCOOH(coohNodes, ignoredNodes);
-    } else {
-        // If no COOH group, find the longest chain normally
-        int startNode = carbonNodes[0];
-        longestChain = findLongestCarbonChain(startNode, ignoredNodes);
-    }
-
-    vector<int> optimalChain = getOptimalChainDirection(longestChain, branchInfo);
-    if(hint == 1) counter = 2;
-
-    // Print the longest carbon chain using node labels
-    cout << "Longest carbon chain: ";
-    for (int node : optimalChain) {
-        cout << idToLabel[node] << " ";
-    }
-    cout << endl;
-
-    // Step 3: Store branch information
-    for (int atom : optimalChain) {
-        for (int neighbor : graph[atom]) {
-            if (ignoredNodes.find(neighbor) == ignoredNodes.end() && find(optimalChain.begin(), optimalChain.end(), neighbor) == optimalChain.end()) {
-                // Neighbor is a branch starting point, call countBranchCarbons
-                auto [numCarbonsInBranch, halogenPresent] = countBranchCarbons(neighbor, unordered_set<int>(optimalChain.begin(), optimalChain.end()), idToLabel);
-                branchInfo[atom] = {numCarbonsInBranch, halogenPresent};
-            }
-        }
-    }
-
-    // Step 4: Generate IUPAC name with '-oic acid' if COOH is present
-    string iupacName = generateIUPACName(optimalChain, idToLabel, branchInfo, counter);
-    if (!coohNodes.empty()) {
-        iupacName += "oic acid";
-    }
-
-    // string iupacName = generateIUPACName(optimalChain, idToLabel, branchInfo, counter);
-    cout << "IUPAC Name: " << iupacName << endl;
-
-    return iupacName; // Return the IUPAC name for use in ethers
-}
-
-// Helper function to generate IUPAC name for a single molecular graph
-string generateIUPACNameForGraph(MolecularGraph& graph) {
-    return processMolecularGraph(graph, 1); // This will print atom info and IUPAC name internally
-    
-}
-
-
-// -------------------- Main Code --------------------
-
-int main() {
-    MolecularGraph graph;
-    string formula;
-    getline(cin, formula);
-    cout << endl;
-
-    size_t pos = formula.find('-');
-    if(pos != string::npos && pos + 2 < formula.length() && formula[pos + 1] == 'O' && formula[pos + 2] == '-') {
-        string f1 = formula.substr(0, pos);
-        string f2 = formula.substr(pos + 3);
-        
-        cout<<f1<<" "<<f2<<endl;
-
-        MolecularGraph g1, g2;
-        g1.parseMolecularFormula(f1);
-        g2.parseMolecularFormula(f2);
-        
-        string name1 = generateIUPACNameForGraph(g1);
-        string name2 = generateIUPACNameForGraph(g2);
-
-        // Ensure the smaller group name comes first
-        if (name1 > name2) {
-            swap(name1, name2);
-        }
-
-        cout << "IUPAC NAME: " << name1 << " " << name2 << " ether" << endl;
-        return 0;
-    }
-
-    graph.parseMolecularFormula(formula);
-    processMolecularGraph(graph, 0);
-
-    return 0;
-}
\ No newline at end of file
+#include <iostream>
+#include <vector>
+#include <string>
+#include <string_view>
+#include <sstream>
+#include <atomic>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <cctype>
+#include <charconv>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "canonical.h"
+#include "fingerprint.h"
+#include "graph_store.h"
+#include "name_parser.h"
+#include "namer.h"
+#include "properties.h"
+#include "smiles.h"
+#include "thread_pool.h"
+
+using namespace std;
+
+// -------------------- Main Code --------------------
+
+// Longest record --length-prefixed accepts
+constexpr size_t maxRecordBytes = 64 << 20;
+
+// Reads the next input record for persistent mode. Records are either one line each
+// (line breaks stripped) or "<length>\n<bytes>" when lengthPrefixed is set, taken
+// byte for byte. A record longer than maxRecordBytes is skipped and gives an error. So
+// does a header that is not just a decimal length, but as the next header cannot be
+// found after it, input ends there. Returns false at end of input.
+bool readRecord(istream& in, string& record, bool lengthPrefixed, string& error) {
+    error.clear();
+    if (!lengthPrefixed) {
+        if (!getline(in, record)) return false;
+        while (!record.empty() && record.back() == '\r') record.pop_back();
+        return true;
+    }
+
+    string header;
+    if (!getline(in, header)) return false;
+    size_t length = 0;
+    const char* end = header.data() + header.size();
+    auto [parsed, status] = from_chars(header.data(), end, length);
+    if (status != errc() || parsed != end || length > (size_t)numeric_limits<streamsize>::max()) {
+        error = "invalid record header";
+        in.setstate(ios::failbit);
+        return true;
+    }
+    if (length > maxRecordBytes) {
+        error = "record longer than " + to_string(maxRecordBytes) + " bytes";
+        in.ignore(length);
+        return true;
+    }
+    record.resize(length);
+    return length == 0 || (bool)in.read(&record[0], length);
+}
+
+struct OutputOptions {
+    bool verbose = false;  // Include the per-stage trace
+    bool json = false;     // One compact JSON object per result instead of plain text
+    bool roundTrip = false;  // Bulk mode: parse each name back and compare the structures
+    bool properties = false;  // Bulk mode: add formula, masses and unsaturation per record
+    bool canonicalSmiles = false;  // Bulk mode: add the canonical SMILES of each record
+};
+
+// The error message, pointing at the byte for parse errors
+string errorText(const NamingResult& result) {
+    string text = result.error;
+    if (result.errorOffset >= 0) text += " at byte " + to_string(result.errorOffset);
+    return text;
+}
+
+// "Error: ..." line for plain-text output
+string errorLine(const NamingResult& result) {
+    return "Error: " + errorText(result);
+}
+
+// Renders one result the way the CLI prints it. In JSON mode the trace is not part
+// of the object; callers send it to stderr instead.
+string formatResult(const NamingResult& result, const string& trace, const OutputOptions& output) {
+    string text;
+    if (output.json) {
+        appendJson(text, result);
+        text += '\n';
+        return text;
+    }
+
+    if (output.verbose) {
+        text = trace;
+    } else if (result.error.empty()) {
+        text = result.name + "\n";
+    }
+    if (!result.error.empty()) {
+        text += errorLine(result) + "\n";
+    }
+    return text;
+}
+
+// JSON snapshot of the namer's pipeline metrics, one line
+string metricsText(const Namer& namer) {
+    string text;
+    if (namer.getMetrics()) {
+        namer.getMetrics()->appendJson(text);
+    } else {
+        text = "{\"error\":\"metrics are disabled\"}";
+    }
+    text += '\n';
+    return text;
+}
+
+// ----- Similarity search -----
+
+// With --index, single-formula and --serve mode also list the most similar formulas in
+// the index next to each name
+struct SimilaritySearch {
+    FingerprintIndex index;
+    size_t top = 10;
+    unique_ptr<WorkStealingPool> pool;
+    MolecularGraph molecule;
+    MolecularGraph etherHalf;
+    bool smiles = false;  // Queries are SMILES
+};
+
+static bool parseFormulaGraph(string_view formula, bool smiles, MolecularGraph& molecule, MolecularGraph& half);
+
+// Adds the hits for formula to one rendered result: a "similar" array in JSON, or a
+// "<similarity>\t<formula>" line per hit. Formulas that do not parse get no hits.
+void appendSimilar(string& text, string_view formula, SimilaritySearch& search, bool json) {
+    vector<SimilarityHit> hits;
+    if (parseFormulaGraph(formula, search.smiles, search.molecule, search.etherHalf)) {
+        hits = search.index.search(circularFingerprint(search.molecule), search.top, search.pool.get());
+    }
+
+    char score[32];
+    if (json) {
+        text.resize(text.size() - 2);  // Reopen the object before its "}\n"
+        text += ",\"similar\":[";
+        for (size_t i = 0; i < hits.size(); i++) {
+            snprintf(score, sizeof(score), "%.4f", hits[i].similarity);
+            if (i) text += ',';
+            text += "{\"formula\":";
+            appendJsonString(text, search.index.formula(hits[i].entry));
+            text += ",\"similarity\":";
+            text += score;
+            text += '}';
+        }
+        text += "]}\n";
+        return;
+    }
+    for (const SimilarityHit& hit : hits) {
+        snprintf(score, sizeof(score), "%.4f\t", hit.similarity);
+        text += score;
+        text += search.index.formula(hit.entry);
+        text += '\n';
+    }
+}
+
+// What the index keeps of a line that parsed: the formula without surrounding
+// whitespace, or just the SMILES, without a title after it
+static string_view indexedText(string_view line, bool smiles) {
+    while (!line.empty() && isspace((unsigned char)line.front())) line.remove_prefix(1);
+    if (smiles) {
+        size_t end = 0;
+        while (end < line.size() && !isspace((unsigned char)line[end])) end++;
+        return line.substr(0, end);
+    }
+    while (!line.empty() && isspace((unsigned char)line.back())) line.remove_suffix(1);
+    return line;
+}
+
+// Fingerprints every formula (or SMILES) of the input file that parses and writes the index
+int buildIndex(const string& inputPath, const string& indexPath, bool smiles) {
+    ifstream in(inputPath);
+    if (!in) {
+        cerr << "Cannot open " << inputPath << ": " << strerror(errno) << endl;
+        return 1;
+    }
+    FingerprintIndexWriter writer;
+    MolecularGraph molecule;
+    MolecularGraph etherHalf;
+    size_t skipped = 0;
+    string line;
+    while (getline(in, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (!parseFormulaGraph(line, smiles, molecule, etherHalf)) {
+            skipped++;
+            continue;
+        }
+        writer.add(indexedText(line, smiles), circularFingerprint(molecule));
+    }
+    if (!writer.save(indexPath)) {
+        cerr << "Could not write fingerprint index to " << indexPath << endl;
+        return 1;
+    }
+    cerr << "Fingerprint index: entries=" << writer.size() << " skipped=" << skipped << endl;
+    return 0;
+}
+
+// With --json and --metrics, each --serve answer also carries what naming it cost:
+// heap allocations and bytes, and what the arena served instead
+void appendAllocations(string& text, const MoleculeCounters& counters) {
+    text.resize(text.size() - 2);  // Reopen the object before its "}\n"
+    text += ",\"allocations\":{\"heap\":" + to_string(counters.allocations);
+    text += ",\"heap_bytes\":" + to_string(counters.allocatedBytes);
+    text += ",\"arena\":" + to_string(counters.arenaAllocations);
+    text += ",\"arena_bytes\":" + to_string(counters.arenaBytes);
+    text += "}}\n";
+}
+
+// Long-lived worker mode: names every record on stdin and answers each one with a
+// single "<length>\n<bytes>" frame on stdout, so callers can keep the process around
+int runPersistent(const Namer& namer, bool lengthPrefixed, const OutputOptions& output, SimilaritySearch* similar) {
+    ios::sync_with_stdio(false);
+    NamerScratch scratch;
+
+    string record;
+    string error;
+    while (readRecord(cin, record, lengthPrefixed, error)) {
+        if (!error.empty()) {
+            NamingResult result;
+            result.error = error;
+            const string payload = formatResult(result, "", output);
+            cout << payload.size() << '\n' << payload;
+            cout.flush();
+            continue;
+        }
+
+        // '#' never starts a formula, so it marks control records
+        if (record == "#metrics") {
+            const string payload = metricsText(namer);
+            cout << payload.size() << '\n' << payload;
+            cout.flush();
+            continue;
+        }
+
+        ostringstream trace;
+        bool wantTrace = output.verbose;
+        if (wantTrace && !output.json) trace << endl;
+
+        NamingResult result;
+        try {
+            result = namer.name(record, scratch, wantTrace ? &trace : nullptr);
+        } catch (const exception& e) {
+            result.error = e.what();
+        }
+
+        if (wantTrace && output.json) cerr << trace.str();
+        string payload = formatResult(result, trace.str(), output);
+        if (output.json && namer.getMetrics()) appendAllocations(payload, scratch.counters);
+        if (similar) appendSimilar(payload, record, *similar, output.json);
+        cout << payload.size() << '\n' << payload;
+        cout.flush();
+    }
+    return 0;
+}
+
+// Batch mode: reads every line of stdin, names them across the worker pool and
+// prints one result per line in input order (NDJSON with --json)
+int runBatch(Namer& namer, const OutputOptions& output) {
+    ios::sync_with_stdio(false);
+
+    vector<string> lines;
+    string line;
+    while (getline(cin, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        lines.push_back(line);
+    }
+
+    vector<string_view> formulas(lines.begin(), lines.end());
+    vector<NamingResult> results = namer.nameBatch(formulas);
+
+    string text;
+    for (const NamingResult& result : results) {
+        text.clear();
+        if (output.json) {
+            appendJson(text, result);
+        } else {
+            text = result.error.empty() ? result.name : errorLine(result);
+        }
+        text += '\n';
+        cout << text;
+    }
+    return 0;
+}
+
+// ----- Round-trip validation -----
+
+// Per-worker graphs for checking formula -> name -> structure
+struct RoundTripScratch {
+    MolecularGraph fromFormula;
+    MolecularGraph etherHalf;
+    MolecularGraph fromName;
+};
+
+struct RoundTripCounts {
+    atomic<size_t> matched{0};
+    atomic<size_t> mismatched{0};
+    atomic<size_t> unparsed{0};
+};
+
+// The structure the formula (or SMILES) describes. An ether's halves are joined through
+// one O atom bonded to the carbon of each that has a bond free for it; half is scratch
+// for the second.
+static bool parseFormulaGraph(string_view formula, bool smiles, MolecularGraph& molecule, MolecularGraph& half) {
+    while (!formula.empty() && isspace((unsigned char)formula.front())) formula.remove_prefix(1);
+    while (!formula.empty() && isspace((unsigned char)formula.back())) formula.remove_suffix(1);
+    if (smiles) return !molecule.parseSmiles(formula);
+
+    size_t dash = findEtherLink(formula);
+    if (dash == string_view::npos) return !molecule.parseMolecularFormula(formula);
+
+    if (molecule.parseMolecularFormula(formula.substr(0, dash)) || half.parseMolecularFormula(formula.substr(dash + 3))) {
+        return false;
+    }
+    int first = molecule.openValenceAtom();
+    int base = molecule.atomCount();
+    for (int atom = 0; atom < half.atomCount(); atom++) {
+        molecule.C_H_bonds[molecule.addAtom(half.element[atom])] = half.C_H_bonds[atom];
+    }
+    for (auto [a, b] : half.edges) {
+        molecule.addEdge(base + a, base + b);
+    }
+    int oxygen = molecule.addAtom(Element::O);
+    molecule.addEdge(first, oxygen);
+    molecule.addEdge(base + half.openValenceAtom(), oxygen);
+    molecule.finalize();
+    return true;
+}
+
+// "ok", "mismatch" or "unparsed: <error>" for one named formula
+static string roundTrip(string_view formula, bool smiles, const NamingResult& result, RoundTripScratch& scratch,
+                        RoundTripCounts& counts) {
+    ParseError error = parseName(result.name, scratch.fromName);
+    if (error) {
+        counts.unparsed++;
+        return string("unparsed: ") + error.message + " at byte " + to_string(error.offset);
+    }
+    if (!parseFormulaGraph(formula, smiles, scratch.fromFormula, scratch.etherHalf) || canonicalize(scratch.fromFormula).code != canonicalize(scratch.fromName).code) {
+        counts.mismatched++;
+        return "mismatch";
+    }
+    counts.matched++;
+    return "ok";
+}
+
+// ----- Molecular properties -----
+
+// Per-worker buffers for --properties: a chunk's formulas are parsed into one batch and
+// measured in a single pass before its rows are written
+struct PropertyScratch {
+    MolecularGraph molecule;
+    MolecularGraph etherHalf;
+    MoleculeBatch batch;
+    BatchProperties properties;
+    vector<char> parsed;
+};
+
+// Calls body(line, index) for every line of a chunk, without the line break
+template <typename Body>
+void forEachLine(string_view chunk, Body&& body) {
+    size_t start = 0;
+    for (size_t index = 0; start < chunk.size(); index++) {
+        size_t end = chunk.find('\n', start);
+        if (end == string_view::npos) end = chunk.size();
+        string_view line = chunk.substr(start, end - start);
+        if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+        start = end + 1;
+        body(line, index);
+    }
+}
+
+// Formulas that do not parse get an empty molecule and parsed = 0
+void measureChunk(string_view chunk, bool smiles, PropertyScratch& scratch) {
+    scratch.batch.clear();
+    scratch.parsed.clear();
+    forEachLine(chunk, [&](string_view line, size_t) {
+        bool parsed = parseFormulaGraph(line, smiles, scratch.molecule, scratch.etherHalf);
+        if (!parsed) scratch.molecule.clear();
+        scratch.batch.add(scratch.molecule);
+        scratch.parsed.push_back(parsed);
+    });
+    computeProperties(scratch.batch, scratch.properties);
+}
+
+// Per-worker buffers for --canonical-smiles
+struct SmilesScratch {
+    MolecularGraph molecule;
+    MolecularGraph etherHalf;
+};
+
+// Names every line of one chunk and appends the output rows to text: TSV of formula,
+// name and error, or NDJSON with --json. With a round-trip scratch every name that was
+// produced is parsed back and checked, adding a fourth column ("round_trip" in JSON).
+// With a property scratch the row goes on with the molecular formula, weight, exact
+// mass, unsaturation, heavy atoms and halogens ("properties" in JSON, null if
+// unparsed). With a SMILES scratch it ends with the canonical SMILES of the structure
+// ("canonical_smiles" in JSON, null if unparsed).
+void nameChunk(const Namer& namer, string_view chunk, NamerScratch& scratch, const OutputOptions& output, string& text,
+               RoundTripScratch* roundTripScratch, RoundTripCounts& counts, PropertyScratch* propertyScratch,
+               SmilesScratch* smilesScratch) {
+    const bool smiles = namer.getOptions().smiles;
+    if (propertyScratch) measureChunk(chunk, smiles, *propertyScratch);
+
+    forEachLine(chunk, [&](string_view line, size_t index) {
+        NamingResult result;
+        try {
+            result = namer.name(line, scratch, nullptr);
+        } catch (const exception& e) {
+            result.error = e.what();
+        }
+
+        // Names that came with an error are not checked
+        string check;
+        if (roundTripScratch && result.error.empty()) {
+            check = roundTrip(line, smiles, result, *roundTripScratch, counts);
+        }
+
+        bool measured = propertyScratch && propertyScratch->parsed[index];
+        const BatchProperties* properties = propertyScratch ? &propertyScratch->properties : nullptr;
+        bool drawn = smilesScratch && parseFormulaGraph(line, smiles, smilesScratch->molecule, smilesScratch->etherHalf);
+        bool extended = roundTripScratch || properties || smilesScratch;
+        if (output.json) {
+            appendJson(text, result);
+            if (extended) text.pop_back();  // Reopen the object
+            if (roundTripScratch) {
+                text += ",\"round_trip\":\"";
+                text += check;
+                text += '"';
+            }
+            if (properties) {
+                text += ",\"properties\":";
+                if (measured) {
+                    properties->appendJson(text, index);
+                } else {
+                    text += "null";
+                }
+            }
+            if (smilesScratch) {
+                text += ",\"canonical_smiles\":";
+                if (drawn) {
+                    text += '"';
+                    appendSmiles(text, smilesScratch->molecule, canonicalize(smilesScratch->molecule).rank);  // Never needs escaping
+                    text += '"';
+                } else {
+                    text += "null";
+                }
+            }
+            if (extended) text += '}';
+        } else {
+            text += line;
+            text += '\t';
+            text += result.name;
+            text += '\t';
+            if (!result.error.empty()) text += errorText(result);
+            if (roundTripScratch) {
+                text += '\t';
+                text += check;
+            }
+            if (properties) {
+                char numbers[96] = "\t\t\t\t\t";
+                if (measured) {
+                    snprintf(numbers, sizeof(numbers), "\t%.3f\t%.5f\t%g\t%u\t%u", properties->molecularWeight[index],
+                             properties->exactMass[index], properties->unsaturation[index], properties->heavyAtoms[index],
+                             properties->halogens(index));
+                }
+                text += '\t';
+                if (measured) text += properties->formula(index);
+                text += numbers;
+            }
+            if (smilesScratch) {
+                text += '\t';
+                if (drawn) appendSmiles(text, smilesScratch->molecule, canonicalize(smilesScratch->molecule).rank);
+            }
+        }
+        text += '\n';
+    });
+}
+
+bool writeAll(int fd, const string& text) {
+    size_t written = 0;
+    while (written < text.size()) {
+        ssize_t count = write(fd, text.data() + written, text.size() - written);
+        if (count < 0 && errno == EINTR) continue;
+        if (count <= 0) return false;
+        written += count;
+    }
+    return true;
+}
+
+// Bulk file mode: maps the input, cuts it into line-aligned chunks and names them
+// across a pool, one chunk per task. Chunks are processed in waves so memory stays
+// bounded on huge inputs; each wave's buffers are written out in input order.
+int runBulk(const Namer& namer, const string& inputPath, const string& outputPath, const OutputOptions& output) {
+    int in = open(inputPath.c_str(), O_RDONLY);
+    if (in < 0) {
+        cerr << "Cannot open " << inputPath << ": " << strerror(errno) << endl;
+        return 1;
+    }
+    struct stat info;
+    if (fstat(in, &info) != 0) {
+        cerr << "Cannot stat " << inputPath << ": " << strerror(errno) << endl;
+        close(in);
+        return 1;
+    }
+    size_t size = info.st_size;
+    const char* data = nullptr;
+    if (size > 0) {
+        void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, in, 0);
+        if (mapped == MAP_FAILED) {
+            cerr << "Cannot map " << inputPath << ": " << strerror(errno) << endl;
+            close(in);
+            return 1;
+        }
+        madvise(mapped, size, MADV_SEQUENTIAL);
+        data = static_cast<const char*>(mapped);
+    }
+
+    int out = STDOUT_FILENO;
+    if (!outputPath.empty()) {
+        out = open(outputPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (out < 0) {
+            cerr << "Cannot create " << outputPath << ": " << strerror(errno) << endl;
+            if (data) munmap(const_cast<char*>(data), size);
+            close(in);
+            return 1;
+        }
+    }
+
+    WorkStealingPool pool(namer.getOptions().threads);
+    vector<NamerScratch> scratch(pool.size());
+    vector<RoundTripScratch> roundTripScratch(output.roundTrip ? pool.size() : 0);
+    vector<PropertyScratch> propertyScratch(output.properties ? pool.size() : 0);
+    vector<SmilesScratch> smilesScratch(output.canonicalSmiles ? pool.size() : 0);
+    RoundTripCounts counts;
+    const size_t chunkBytes = 1 << 20;
+    const size_t wave = pool.size() * 4;  // Enough chunks per wave to balance the workers
+    vector<string_view> chunks;
+    vector<string> buffers(wave);
+
+    size_t position = 0;
+    bool ok = true;
+    while (position < size && ok) {
+        chunks.clear();
+        while (chunks.size() < wave && position < size) {
+            size_t end = min(size, position + chunkBytes);
+            if (end < size) {
+                const void* newline = memchr(data + end, '\n', size - end);
+                end = newline ? static_cast<const char*>(newline) - data + 1 : size;
+            }
+            chunks.emplace_back(data + position, end - position);
+            position = end;
+        }
+
+        pool.parallelFor(chunks.size(), 1, [&](size_t index, unsigned worker) {
+            buffers[index].clear();
+            nameChunk(namer, chunks[index], scratch[worker], output, buffers[index],
+                      output.roundTrip ? &roundTripScratch[worker] : nullptr, counts,
+                      output.properties ? &propertyScratch[worker] : nullptr,
+                      output.canonicalSmiles ? &smilesScratch[worker] : nullptr);
+        });
+
+        for (size_t i = 0; i < chunks.size() && ok; i++) {
+            ok = writeAll(out, buffers[i]);
+        }
+    }
+
+    if (!ok) cerr << "Could not write output: " << strerror(errno) << endl;
+    if (output.roundTrip) {
+        cerr << "Round trip: ok=" << counts.matched << " mismatch=" << counts.mismatched
+             << " unparsed=" << counts.unparsed << endl;
+    }
+    if (out != STDOUT_FILENO && close(out) != 0) ok = false;
+    if (data) munmap(const_cast<char*>(data), size);
+    close(in);
+    return ok ? 0 : 1;
+}
+
+// ----- Graph store -----
+
+// Parses every line of the input file (formulas, or SMILES) into a graph store. Lines
+// that do not parse get an empty record, so record numbers stay line numbers.
+int writeGraphStore(const string& inputPath, const string& storePath, bool smiles) {
+    ifstream in(inputPath);
+    if (!in) {
+        cerr << "Cannot open " << inputPath << ": " << strerror(errno) << endl;
+        return 1;
+    }
+    GraphStoreWriter writer;
+    MolecularGraph molecule;
+    MolecularGraph etherHalf;
+    size_t skipped = 0;
+    string line;
+    while (getline(in, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (!parseFormulaGraph(line, smiles, molecule, etherHalf)) {
+            writer.addEmpty();
+            skipped++;
+        } else if (!writer.add(molecule)) {
+            skipped++;
+        }
+    }
+    if (!writer.save(storePath)) {
+        cerr << "Could not write graph store to " << storePath << endl;
+        return 1;
+    }
+    cerr << "Graph store: records=" << writer.size() << " skipped=" << skipped << endl;
+    return 0;
+}
+
+// Names records [first, last) of the store and appends one row each to text: record
+// number, name and error, or NDJSON with a "record" key. The metrics list slow records
+// as "#<record>".
+void nameRecords(const Namer& namer, const GraphStore& store, size_t first, size_t last, NamerScratch& scratch,
+                 const OutputOptions& output, string& text) {
+    char label[24];
+    for (size_t record = first; record < last; record++) {
+        snprintf(label, sizeof(label), "#%zu", record + 1);
+        NamingResult result;
+        if (!store.load(record, scratch.wholeGraph)) {
+            result.error = "no molecule stored for this record";
+        } else {
+            try {
+                result = namer.nameGraph(label, scratch, nullptr);
+            } catch (const exception& e) {
+                result.error = e.what();
+            }
+        }
+
+        if (output.json) {
+            appendJson(text, result);
+            text.pop_back();  // Reopen the object
+            text += ",\"record\":";
+            text += label + 1;
+            text += '}';
+        } else {
+            text += label + 1;
+            text += '\t';
+            text += result.name;
+            text += '\t';
+            if (!result.error.empty()) text += errorText(result);
+        }
+        text += '\n';
+    }
+}
+
+// Bulk mode over a graph store: like runBulk, but the molecules come parsed, so each
+// task loads a range of records and goes straight to naming
+int runStoredBulk(const Namer& namer, const string& storePath, const string& outputPath, const OutputOptions& output) {
+    GraphStore store;
+    string error;
+    if (!store.open(storePath, error)) {
+        cerr << "Cannot open graph store " << storePath << ": " << error << endl;
+        return 1;
+    }
+
+    int out = STDOUT_FILENO;
+    if (!outputPath.empty()) {
+        out = open(outputPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (out < 0) {
+            cerr << "Cannot create " << outputPath << ": " << strerror(errno) << endl;
+            return 1;
+        }
+    }
+
+    WorkStealingPool pool(namer.getOptions().threads);
+    vector<NamerScratch> scratch(pool.size());
+    const size_t rangeRecords = 4096;
+    const size_t wave = pool.size() * 4;
+    vector<string> buffers(wave);
+
+    bool ok = true;
+    for (size_t position = 0; position < store.size() && ok; position += wave * rangeRecords) {
+        size_t ranges = min(wave, (store.size() - position + rangeRecords - 1) / rangeRecords);
+        pool.parallelFor(ranges, 1, [&](size_t index, unsigned worker) {
+            size_t first = position + index * rangeRecords;
+            buffers[index].clear();
+            nameRecords(namer, store, first, min(store.size(), first + rangeRecords), scratch[worker], output,
+                        buffers[index]);
+        });
+
+        for (size_t i = 0; i < ranges && ok; i++) {
+            ok = writeAll(out, buffers[i]);
+        }
+    }
+
+    if (!ok) cerr << "Could not write output: " << strerror(errno) << endl;
+    if (out != STDOUT_FILENO && close(out) != 0) ok = false;
+    return ok ? 0 : 1;
+}
+
+// Reports cache effectiveness on stderr so it never mixes with the names on stdout
+void printCacheStats(const Namer& namer) {
+    if (!namer.getCache()) return;
+    NameCache::Stats stats = namer.getCache()->stats();
+    cerr << "Name cache: hits=" << stats.hits << " misses=" << stats.misses
+         << " entries=" << stats.entries << " evictions=" << stats.evictions << endl;
+}
+
+int main(int argc, char* argv[]) {
+    bool serve = false;
+    bool batch = false;
+    bool lengthPrefixed = false;
+    OutputOptions output;
+    string cacheFile;
+    string inputPath;
+    string outputPath;
+    string buildIndexPath;
+    string indexPath;
+    string writeGraphsPath;
+    string graphsPath;
+    size_t top = 10;
+    NamerOptions options;
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        try {
+            if (arg == "--serve") {
+                serve = true;
+            } else if (arg == "--batch") {
+                batch = true;
+            } else if (arg == "--length-prefixed") {
+                lengthPrefixed = true;
+            } else if (arg == "--verbose") {
+                output.verbose = true;
+            } else if (arg == "--json") {
+                output.json = true;
+            } else if (arg == "--round-trip") {
+                output.roundTrip = true;
+            } else if (arg == "--properties") {
+                output.properties = true;
+            } else if (arg == "--canonical-smiles") {
+                output.canonicalSmiles = true;
+            } else if (arg == "--smiles") {
+                options.smiles = true;
+            } else if (arg == "--metrics") {
+                options.metrics = true;
+            } else if (arg == "--reference-chains") {
+                options.referenceChains = true;
+            } else if (arg == "--threads" && i + 1 < argc) {
+                options.threads = stoul(argv[++i]);
+            } else if (arg == "--cache" && i + 1 < argc) {
+                options.cacheCapacity = stoul(argv[++i]);
+            } else if (arg == "--cache-file" && i + 1 < argc) {
+                cacheFile = argv[++i];
+            } else if (arg == "--input" && i + 1 < argc) {
+                inputPath = argv[++i];
+            } else if (arg == "--output" && i + 1 < argc) {
+                outputPath = argv[++i];
+            } else if (arg == "--build-index" && i + 1 < argc) {
+                buildIndexPath = argv[++i];
+            } else if (arg == "--index" && i + 1 < argc) {
+                indexPath = argv[++i];
+            } else if (arg == "--write-graphs" && i + 1 < argc) {
+                writeGraphsPath = argv[++i];
+            } else if (arg == "--graphs" && i + 1 < argc) {
+                graphsPath = argv[++i];
+            } else if (arg == "--top" && i + 1 < argc) {
+                top = stoul(argv[++i]);
+            } else {
+                cerr << "Unknown option: " << arg << endl;
+                cerr << "Usage: toolkit [--serve [--length-prefixed] | --batch [--threads N] | --input PATH [--output PATH] [--threads N] [--round-trip] [--properties] [--canonical-smiles] | --input PATH --build-index PATH | --input PATH --write-graphs PATH | --graphs PATH [--output PATH] [--threads N]] [--index PATH [--top K]] [--smiles] [--verbose] [--json] [--cache N] [--cache-file PATH] [--metrics] [--reference-chains]" << endl;
+                return 1;
+            }
+        } catch (const logic_error&) {  // stoul on something that is not a number
+            cerr << "Invalid number for " << arg << ": " << argv[i] << endl;
+            return 1;
+        }
+    }
+
+    // A cache file on its own implies a cache worth persisting
+    if (!cacheFile.empty() && options.cacheCapacity == 0) {
+        options.cacheCapacity = 100000;
+    }
+
+    if (!buildIndexPath.empty()) {
+        if (inputPath.empty()) {
+            cerr << "--build-index needs --input" << endl;
+            return 1;
+        }
+        return buildIndex(inputPath, buildIndexPath, options.smiles);
+    }
+
+    if (!writeGraphsPath.empty()) {
+        if (inputPath.empty()) {
+            cerr << "--write-graphs needs --input" << endl;
+            return 1;
+        }
+        return writeGraphStore(inputPath, writeGraphsPath, options.smiles);
+    }
+    if (!graphsPath.empty() && (output.roundTrip || output.properties || output.canonicalSmiles)) {
+        cerr << "--graphs does not take --round-trip, --properties or --canonical-smiles" << endl;
+        return 1;
+    }
+
+    unique_ptr<SimilaritySearch> similar;
+    if (!indexPath.empty()) {
+        similar = make_unique<SimilaritySearch>();
+        string error;
+        if (!similar->index.open(indexPath, error)) {
+            cerr << "Cannot open fingerprint index " << indexPath << ": " << error << endl;
+            return 1;
+        }
+        similar->top = top;
+        similar->smiles = options.smiles;
+        similar->pool = make_unique<WorkStealingPool>(options.threads);
+    }
+
+    Namer namer(options);
+    if (!cacheFile.empty()) {
+        // A missing file just means a cold start
+        string error;
+        if (!namer.getCache()->load(cacheFile, error) && !error.empty()) {
+            cerr << "Ignoring name cache " << cacheFile << ": " << error << endl;
+        }
+    }
+
+    int status = 0;
+    if (!graphsPath.empty()) {
+        status = runStoredBulk(namer, graphsPath, outputPath, output);
+        printCacheStats(namer);
+    } else if (!inputPath.empty()) {
+        status = runBulk(namer, inputPath, outputPath, output);
+        printCacheStats(namer);
+    } else if (serve) {
+        status = runPersistent(namer, lengthPrefixed, output, similar.get());
+        printCacheStats(namer);
+    } else if (batch) {
+        status = runBatch(namer, output);
+        printCacheStats(namer);
+    } else {
+        string formula;
+        getline(cin, formula);
+
+        ostringstream trace;
+        if (output.verbose && !output.json) trace << endl;
+
+        NamerScratch scratch;
+        NamingResult result;
+        try {
+            result = namer.name(formula, scratch, output.verbose ? &trace : nullptr);
+        } catch (const exception& e) {
+            result.error = e.what();
+        }
+
+        if (output.verbose && output.json) cerr << trace.str();
+        string text = formatResult(result, trace.str(), output);
+        if (similar) appendSimilar(text, formula, *similar, output.json);
+        cout << text;
+        status = result.error.empty() ? 0 : 1;
+    }
+
+    if (namer.getMetrics()) {
+        cerr << "Metrics: " << metricsText(namer);
+    }
+    if (!cacheFile.empty() && !namer.getCache()->save(cacheFile)) {
+        cerr << "Could not write name cache to " << cacheFile << endl;
+    }
+    return status;
+}
@@ -0,0 +1,203 @@
+#include "metrics.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+using namespace std;
+
+// -------------------- Allocation Counting --------------------
+
+// Every binary links this file, so they all count. Kept out of line from the callers:
+// inlined next to a new-expression, the free() below trips -Wmismatched-new-delete.
+void* operator new(size_t size) {
+    threadAllocations++;
+    threadAllocatedBytes += size;
+    if (void* block = malloc(size ? size : 1)) return block;
+    throw bad_alloc();
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void* block) noexcept { free(block); }
+void operator delete[](void* block) noexcept { free(block); }
+void operator delete(void* block, size_t) noexcept { free(block); }
+void operator delete[](void* block, size_t) noexcept { free(block); }
+
+// -------------------- Stage Names --------------------
+
+static constexpr const char* stageNames[stageCount] = {
+    "parse", "graph_build", "cache_lookup", "ring_check", "chain_search", "branch_count", "name_assembly"};
+
+const char* stageName(Stage stage) {
+    return stageNames[(int)stage];
+}
+
+static constexpr size_t shardCount = 16;
+
+PipelineMetrics::PipelineMetrics() {
+    for (size_t i = 0; i < shardCount; i++) {
+        shards.push_back(make_unique<Shard>());
+    }
+}
+
+// Threads take shards in the order they first record, so a pool of up to shardCount
+// workers never shares one
+PipelineMetrics::Shard& PipelineMetrics::shardForThread() {
+    static atomic<unsigned> threadsSeen{0};
+    thread_local unsigned slot = threadsSeen.fetch_add(1, memory_order_relaxed);
+    return *shards[slot % shards.size()];
+}
+
+static void add(atomic<uint64_t>& counter, uint64_t value) {
+    counter.fetch_add(value, memory_order_relaxed);
+}
+
+void PipelineMetrics::record(const MoleculeCounters& counters, string_view formula, uint64_t totalNanos, bool failed) {
+    Shard& shard = shardForThread();
+    add(shard.molecules, 1);
+    if (failed) add(shard.errors, 1);
+    add(shard.atoms, counters.atoms);
+    add(shard.bonds, counters.bonds);
+    add(shard.nodesVisited, counters.nodesVisited);
+    add(shard.allocations, counters.allocations);
+    add(shard.allocatedBytes, counters.allocatedBytes);
+    add(shard.arenaAllocations, counters.arenaAllocations);
+    add(shard.arenaBytes, counters.arenaBytes);
+    add(shard.cacheHits, counters.cacheHits);
+    add(shard.cacheMisses, counters.cacheMisses);
+
+    int slowestStage = 0;
+    for (int stage = 0; stage < stageCount; stage++) {
+        if (!(counters.stagesRun & (1u << stage))) continue;
+        Histogram& histogram = shard.stages[stage];
+        add(histogram.buckets[bucketFor(counters.stageNanos[stage])], 1);
+        add(histogram.count, 1);
+        add(histogram.nanos, counters.stageNanos[stage]);
+        if (counters.stageNanos[stage] > counters.stageNanos[slowestStage]) slowestStage = stage;
+    }
+    add(shard.total.buckets[bucketFor(totalNanos)], 1);
+    add(shard.total.count, 1);
+    add(shard.total.nanos, totalNanos);
+
+    if (totalNanos <= slowThreshold.load(memory_order_relaxed)) return;
+    lock_guard<mutex> lock(slowLock);
+    SlowMolecule entry{string(formula.substr(0, 200)), totalNanos, (Stage)slowestStage,
+                       counters.stageNanos[slowestStage], counters.atoms};
+    auto at = find_if(slowest.begin(), slowest.end(), [&](const SlowMolecule& kept) { return kept.nanos < totalNanos; });
+    slowest.insert(at, move(entry));
+    if ((int)slowest.size() > slowestKept) slowest.pop_back();
+    if ((int)slowest.size() == slowestKept) slowThreshold.store(slowest.back().nanos, memory_order_relaxed);
+}
+
+static void appendNumber(string& out, const char* key, uint64_t value) {
+    out += '"';
+    out += key;
+    out += "\":";
+    out += to_string(value);
+}
+
+static void appendSeconds(string& out, uint64_t nanos) {
+    char text[32];
+    snprintf(text, sizeof(text), "%.9g", nanos * 1e-9);
+    out += text;
+}
+
+static void appendJsonString(string& out, string_view text) {
+    out += '"';
+    for (char ch : text) {
+        if (ch == '"' || ch == '\\') {
+            out += '\\';
+            out += ch;
+        } else if ((unsigned char)ch < 0x20) {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", ch);
+            out += escaped;
+        } else {
+            out += ch;
+        }
+    }
+    out += '"';
+}
+
+void PipelineMetrics::appendJson(string& out) const {
+    auto sum = [&](auto member) {
+        uint64_t total = 0;
+        for (const auto& shard : shards) total += member(*shard).load(memory_order_relaxed);
+        return total;
+    };
+
+    out += '{';
+    appendNumber(out, "molecules", sum([](const Shard& s) -> const auto& { return s.molecules; }));
+    out += ',';
+    appendNumber(out, "errors", sum([](const Shard& s) -> const auto& { return s.errors; }));
+    out += ',';
+    appendNumber(out, "atoms", sum([](const Shard& s) -> const auto& { return s.atoms; }));
+    out += ',';
+    appendNumber(out, "bonds", sum([](const Shard& s) -> const auto& { return s.bonds; }));
+    out += ',';
+    appendNumber(out, "nodes_visited", sum([](const Shard& s) -> const auto& { return s.nodesVisited; }));
+    out += ',';
+    appendNumber(out, "allocations", sum([](const Shard& s) -> const auto& { return s.allocations; }));
+    out += ',';
+    appendNumber(out, "allocated_bytes", sum([](const Shard& s) -> const auto& { return s.allocatedBytes; }));
+    out += ',';
+    appendNumber(out, "arena_allocations", sum([](const Shard& s) -> const auto& { return s.arenaAllocations; }));
+    out += ',';
+    appendNumber(out, "arena_bytes", sum([](const Shard& s) -> const auto& { return s.arenaBytes; }));
+    out += ',';
+    appendNumber(out, "cache_hits", sum([](const Shard& s) -> const auto& { return s.cacheHits; }));
+    out += ',';
+    appendNumber(out, "cache_misses", sum([](const Shard& s) -> const auto& { return s.cacheMisses; }));
+
+    out += ",\"bucket_bounds\":[";
+    for (int bucket = 0; bucket + 1 < latencyBuckets; bucket++) {
+        if (bucket) out += ',';
+        appendSeconds(out, uint64_t(64) << bucket);
+    }
+
+    // Buckets are per bucket, not cumulative; the last one has no bound
+    auto appendHistogram = [&](const char* name, auto pick) {
+        out += '"';
+        out += name;
+        out += "\":{";
+        appendNumber(out, "count", sum([&](const Shard& s) -> const auto& { return pick(s).count; }));
+        out += ",\"seconds\":";
+        appendSeconds(out, sum([&](const Shard& s) -> const auto& { return pick(s).nanos; }));
+        out += ",\"buckets\":[";
+        for (int bucket = 0; bucket < latencyBuckets; bucket++) {
+            if (bucket) out += ',';
+            out += to_string(sum([&](const Shard& s) -> const auto& { return pick(s).buckets[bucket]; }));
+        }
+        out += "]}";
+    };
+    out += "],\"stages\":{";
+    for (int stage = 0; stage < stageCount; stage++) {
+        if (stage) out += ',';
+        appendHistogram(stageNames[stage], [&](const Shard& s) -> const Histogram& { return s.stages[stage]; });
+    }
+    out += "},";
+    appendHistogram("total", [](const Shard& s) -> const Histogram& { return s.total; });
+
+    out += ",\"slowest\":[";
+    lock_guard<mutex> lock(slowLock);
+    for (size_t i = 0; i < slowest.size(); i++) {
+        const SlowMolecule& entry = slowest[i];
+        if (i) out += ',';
+        out += "{\"formula\":";
+        appendJsonString(out, entry.formula);
+        out += ",\"seconds\":";
+        appendSeconds(out, entry.nanos);
+        out += ",\"slowest_stage\":\"";
+        out += stageName(entry.slowestStage);
+        out += "\",\"stage_seconds\":";
+        appendSeconds(out, entry.stageNanos);
+        out += ',';
+        appendNumber(out, "atoms", entry.atoms);
+        out += '}';
+    }
+    out += "]}";
+}
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Stages of naming one formula, in pipeline order
+enum class Stage : uint8_t { Parse, GraphBuild, CacheLookup, RingCheck, ChainSearch, BranchCount, NameAssembly };
+constexpr int stageCount = 7;
+
+// "parse", "graph_build", ... as used in the metrics output
+const char* stageName(Stage stage);
+
+// Heap allocations made by the current thread and the bytes they asked for, bumped
+// by the operator new that metrics.cpp installs for every binary.
+inline thread_local uint64_t threadAllocations = 0;
+inline thread_local uint64_t threadAllocatedBytes = 0;
+
+// Work done while naming one formula (both halves of an ether). Lives in NamerScratch;
+// stage times are only taken while enabled is set.
+struct MoleculeCounters {
+    bool enabled = false;
+    uint32_t stagesRun = 0;  // Bit per Stage
+    std::array<uint64_t, stageCount> stageNanos{};
+    uint64_t atoms = 0;
+    uint64_t bonds = 0;
+    uint64_t nodesVisited = 0;  // Atoms popped by the chain and branch walks
+    uint64_t allocations = 0;     // Heap allocations
+    uint64_t allocatedBytes = 0;
+    uint64_t arenaAllocations = 0;  // Served by NamerScratch::arena instead
+    uint64_t arenaBytes = 0;
+    uint64_t cacheHits = 0;
+    uint64_t cacheMisses = 0;
+};
+
+// Adds the time until stop() or the end of the scope, whichever comes first, to one
+// stage. Does nothing unless the counters are enabled.
+class StageTimer {
+public:
+    StageTimer(MoleculeCounters& counters, Stage stage) : counters(counters), stage(stage), running(counters.enabled) {
+        if (running) start = std::chrono::steady_clock::now();
+    }
+    ~StageTimer() { stop(); }
+
+    void stop() {
+        if (!running) return;
+        running = false;
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        counters.stageNanos[(int)stage] += std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+        counters.stagesRun |= 1u << (int)stage;
+    }
+
+    StageTimer(const StageTimer&) = delete;
+    StageTimer& operator=(const StageTimer&) = delete;
+
+private:
+    MoleculeCounters& counters;
+    Stage stage;
+    bool running;
+    std::chrono::steady_clock::time_point start;
+};
+
+// Totals and latency histograms over every formula a Namer has named. Counters are
+// relaxed atomics in per-thread shards, so recording never contends; readers sum the
+// shards and may see a molecule half recorded.
+//
+// Latency buckets are powers of two: bucket b counts times below 2^(b + 6) ns (64 ns
+// up to about 2.1 s), the last one everything slower.
+class PipelineMetrics {
+public:
+    static constexpr int latencyBuckets = 26;
+    static constexpr int slowestKept = 16;
+
+    static int bucketFor(uint64_t nanos) {
+        int bucket = nanos < 64 ? 0 : std::bit_width(nanos) - 6;
+        return bucket < latencyBuckets ? bucket : latencyBuckets - 1;
+    }
+
+    PipelineMetrics();
+
+    void record(const MoleculeCounters& counters, std::string_view formula, uint64_t totalNanos, bool failed);
+
+    // One JSON object: totals, a histogram per stage plus "total", bucket bounds and the
+    // slowest formulas seen with the stage that took longest in each
+    void appendJson(std::string& out) const;
+
+private:
+    struct Histogram {
+        std::array<std::atomic<uint64_t>, latencyBuckets> buckets{};
+        std::atomic<uint64_t> count{0};
+        std::atomic<uint64_t> nanos{0};
+    };
+
+    struct alignas(64) Shard {
+        std::atomic<uint64_t> molecules{0};
+        std::atomic<uint64_t> errors{0};
+        std::atomic<uint64_t> atoms{0};
+        std::atomic<uint64_t> bonds{0};
+        std::atomic<uint64_t> nodesVisited{0};
+        std::atomic<uint64_t> allocations{0};
+        std::atomic<uint64_t> allocatedBytes{0};
+        std::atomic<uint64_t> arenaAllocations{0};
+        std::atomic<uint64_t> arenaBytes{0};
+        std::atomic<uint64_t> cacheHits{0};
+        std::atomic<uint64_t> cacheMisses{0};
+        std::array<Histogram, stageCount> stages;
+        Histogram total;
+    };
+
+    struct SlowMolecule {
+        std::string formula;  // Cut to the first 200 bytes
+        uint64_t nanos;
+        Stage slowestStage;
+        uint64_t stageNanos;
+        uint64_t atoms;
+    };
+
+    Shard& shardForThread();
+
+    std::vector<std::unique_ptr<Shard>> shards;
+
+    // Slowest formulas, slowest first. Faster ones are turned away by slowThreshold
+    // without taking the lock once the list is full.
+    mutable std::mutex slowLock;
+    std::vector<SlowMolecule> slowest;
+    std::atomic<uint64_t> slowThreshold{0};
+};
@@ -0,0 +1,645 @@
+#include "molecule.h"
+
+#include <algorithm>
+#include <cctype>
+
+using namespace std;
+
+size_t findEtherLink(string_view formula) {
+    return formula.find("-O-");
+}
+
+const char* elementSymbol(Element element) {
+    switch (element) {
+        case Element::C: return "C";
+        case Element::COOH: return "COOH";
+        case Element::Cl: return "Cl";
+        case Element::Br: return "Br";
+        case Element::F: return "F";
+        case Element::I: return "I";
+        case Element::O: return "O";
+        default: return "X";
+    }
+}
+
+void MolecularGraph::clear() {
+    element.clear();
+    C_C_bonds.clear();
+    C_H_bonds.clear();
+    C_X_bonds.clear();
+    sourceOffset.clear();
+    edges.clear();
+    adjacencyOffsets.clear();
+    adjacencyTargets.clear();
+}
+
+int MolecularGraph::addAtom(Element code) {
+    element.push_back(code);
+    C_C_bonds.push_back(0);
+    C_H_bonds.push_back(0);
+    C_X_bonds.push_back(0);
+    return atomCount() - 1;
+}
+
+void MolecularGraph::addEdge(int id1, int id2) {
+    if (halogenType(element[id1]) || halogenType(element[id2])) {
+        C_X_bonds[id1]++;
+        C_X_bonds[id2]++;
+    } else {
+        C_C_bonds[id1]++;
+        C_C_bonds[id2]++;
+    }
+    edges.emplace_back(id1, id2);
+}
+
+void MolecularGraph::finalize() {
+    int n = atomCount();
+    adjacencyOffsets.assign(n + 1, 0);
+    for (const auto& edge : edges) {
+        adjacencyOffsets[edge.first + 1]++;
+        adjacencyOffsets[edge.second + 1]++;
+    }
+    for (int i = 0; i < n; i++) {
+        adjacencyOffsets[i + 1] += adjacencyOffsets[i];
+    }
+
+    // Each atom's offset serves as its write cursor, ending up at the next atom's start;
+    // shifting the offsets back by one restores them without a second array
+    adjacencyTargets.assign(adjacencyOffsets[n], 0);
+    for (const auto& edge : edges) {
+        adjacencyTargets[adjacencyOffsets[edge.first]++] = edge.second;
+        adjacencyTargets[adjacencyOffsets[edge.second]++] = edge.first;
+    }
+    for (int i = n; i > 0; i--) {
+        adjacencyOffsets[i] = adjacencyOffsets[i - 1];
+    }
+    adjacencyOffsets[0] = 0;
+}
+
+ParseError MolecularGraph::parseMolecularFormula(string_view formula, bool buildAdjacency) {
+    clear();
+    ParseError error = tokenize(formula);
+    if (error) {
+        clear();  // Never hand out a half-built graph
+        return error;
+    }
+    if (buildAdjacency) finalize();
+    return error;
+}
+
+// Single pass over the text. Atoms and bonds go straight into the table; the only
+// other state is the stack of open branch points.
+ParseError MolecularGraph::tokenize(string_view formula) {
+    const char* text = formula.data();
+    const size_t length = formula.size();
+    if (length == 0) return {0, "empty formula"};
+
+    // Every atom takes at least two bytes in practice ("CH3", "Cl", "(F)"), so this
+    // avoids regrowth for almost all inputs without a counting pre-pass
+    size_t expectedAtoms = length / 2 + 1;
+    element.reserve(expectedAtoms);
+    C_C_bonds.reserve(expectedAtoms);
+    C_H_bonds.reserve(expectedAtoms);
+    C_X_bonds.reserve(expectedAtoms);
+    sourceOffset.reserve(expectedAtoms);
+    edges.reserve(expectedAtoms);
+    branchPoints.clear();
+    branchOffsets.clear();
+    ringOpenAtom.assign(100, -1);
+    ringOpenOffset.assign(100, 0);
+    int openRings = 0;
+
+    int previousAtom = -1;
+    size_t i = 0;
+    while (i < length) {
+        const size_t atomStart = i;
+        Element code;
+        int hydrogens = 0;
+
+        switch (text[i]) {
+            case 'C':
+                if (i + 1 < length && text[i + 1] == 'l') {
+                    code = Element::Cl;
+                    i += 2;
+                } else if (i + 1 < length && text[i + 1] == 'O') {
+                    if (formula.compare(i, 4, "COOH") != 0) return {i, "expected COOH"};
+                    code = Element::COOH;
+                    i += 4;
+                } else {
+                    code = Element::C;
+                    i++;
+                    // Ring-closure labels come straight after the symbol: C1, C12, C%10
+                    ringLabels.clear();
+                    while (i < length && ((text[i] >= '0' && text[i] <= '9') || text[i] == '%')) {
+                        if (text[i] == '%') {
+                            if (i + 2 >= length || text[i + 1] < '0' || text[i + 1] > '9' || text[i + 2] < '0' || text[i + 2] > '9') {
+                                return {i, "expected two digits after '%'"};
+                            }
+                            ringLabels.emplace_back((text[i + 1] - '0') * 10 + (text[i + 2] - '0'), i);
+                            i += 3;
+                        } else {
+                            ringLabels.emplace_back(text[i] - '0', i);
+                            i++;
+                        }
+                    }
+                    if (i < length && text[i] == 'H') {
+                        i++;
+                        hydrogens = 1;
+                        if (i < length && text[i] >= '0' && text[i] <= '9') {
+                            hydrogens = 0;
+                            while (i < length && text[i] >= '0' && text[i] <= '9') {
+                                hydrogens = hydrogens * 10 + (text[i] - '0');
+                                if (hydrogens > 4) return {atomStart, "carbon cannot carry more than four hydrogens"};
+                                i++;
+                            }
+                        }
+                    }
+                }
+                break;
+            case 'B':
+                if (i + 1 >= length || text[i + 1] != 'r') return {i, "unknown element"};
+                code = Element::Br;
+                i += 2;
+                break;
+            case 'F':
+                code = Element::F;
+                i++;
+                break;
+            case 'I':
+                code = Element::I;
+                i++;
+                break;
+            case 'O':
+                return {i, "O is only supported in COOH and as the -O- of an ether"};
+            case '(':
+                if (previousAtom == -1) return {i, "branch opened before any atom"};
+                if (i + 1 < length && text[i + 1] == ')') return {i, "empty branch"};
+                branchPoints.push_back(previousAtom);
+                branchOffsets.push_back(i);
+                i++;
+                continue;
+            case ')':
+                if (branchPoints.empty()) return {i, "unmatched ')'"};
+                previousAtom = branchPoints.back();
+                branchPoints.pop_back();
+                branchOffsets.pop_back();
+                i++;
+                continue;
+            default:
+                if ((text[i] >= 'A' && text[i] <= 'Z') || (text[i] >= 'a' && text[i] <= 'z')) {
+                    return {i, "unknown element"};
+                }
+                return {i, "unexpected character"};
+        }
+
+        int currentAtom = addAtom(code);
+        C_H_bonds[currentAtom] = hydrogens;
+        sourceOffset.push_back(atomStart);
+
+        if (previousAtom != -1) {
+            addEdge(previousAtom, currentAtom);
+        }
+
+        // The first use of a label opens a ring bond, the second closes it
+        if (code == Element::C) {
+            int firstClosure = edges.size();
+            for (auto [label, offset] : ringLabels) {
+                int opener = ringOpenAtom[label];
+                if (opener == -1) {
+                    ringOpenAtom[label] = currentAtom;
+                    ringOpenOffset[label] = offset;
+                    openRings++;
+                    continue;
+                }
+                if (opener == currentAtom) return {offset, "ring bond to the same atom"};
+                if (opener == previousAtom) return {offset, "ring bond duplicates an existing bond"};
+                for (int k = firstClosure; k < (int)edges.size(); k++) {
+                    if (edges[k].first == opener) return {offset, "ring bond duplicates an existing bond"};
+                }
+                addEdge(opener, currentAtom);
+                ringOpenAtom[label] = -1;
+                openRings--;
+            }
+        }
+
+        // Halogens are terminal, so the chain carries on from the carbon they sit on,
+        // unless the halogen opens the formula ("ClCH2CH3")
+        if (!halogenType(code) || previousAtom == -1) {
+            previousAtom = currentAtom;
+        }
+    }
+
+    if (!branchOffsets.empty()) return {branchOffsets.back(), "unclosed '('"};
+    if (openRings > 0) {
+        size_t offset = length;
+        for (int label = 0; label < 100; label++) {
+            if (ringOpenAtom[label] != -1) offset = min(offset, ringOpenOffset[label]);
+        }
+        return {offset, "unclosed ring bond"};
+    }
+
+    for (int atom = 0; atom < atomCount(); atom++) {
+        if (getTotalBonds(atom) > maxBonds(element[atom])) {
+            return {sourceOffset[atom], "too many bonds on this atom"};
+        }
+    }
+    return {};
+}
+
+void MolecularGraph::printAtomsInfo(ostream& log) const {
+    log << "Atoms Info" << endl;
+    for (int atom = 0; atom < atomCount(); atom++) {
+        log << atomLabel(atom) << ": C-C=" << C_C_bonds[atom] << ", C-H=" << C_H_bonds[atom]
+            << ", C-X=" << C_X_bonds[atom] << "; " << endl;
+    }
+    log << endl;
+}
+
+void MolecularGraph::printEdges(ostream& log) const
+{
+    log << "Edges" << endl;
+    for (const auto& edge : edges) {
+        log << atomLabel(edge.first) << "-" << atomLabel(edge.second) << endl;
+    }
+    log << endl;
+}
+
+// -------------------- SMILES --------------------
+
+ParseError MolecularGraph::parseSmiles(string_view smiles, bool buildAdjacency) {
+    clear();
+    ParseError error = readSmiles(smiles);
+    if (error) {
+        clear();  // Never hand out a half-built graph
+        return error;
+    }
+    if (buildAdjacency) finalize();
+    return error;
+}
+
+// Reads the element symbol at text[i] into code; returns an error message, or null
+static const char* readElement(const char* text, size_t length, size_t& i, Element& code) {
+    switch (text[i]) {
+        case 'C':
+            if (i + 1 < length && text[i + 1] == 'l') {
+                code = Element::Cl;
+                i += 2;
+            } else {
+                code = Element::C;
+                i++;
+            }
+            return nullptr;
+        case 'B':
+            if (i + 1 >= length || text[i + 1] != 'r') return "unsupported element";
+            code = Element::Br;
+            i += 2;
+            return nullptr;
+        case 'F': code = Element::F; i++; return nullptr;
+        case 'I': code = Element::I; i++; return nullptr;
+        case 'O': code = Element::O; i++; return nullptr;
+        case 'b': case 'c': case 'n': case 'o': case 'p': case 's':
+            return "aromatic atoms are not supported";
+        default:
+            if ((text[i] >= 'A' && text[i] <= 'Z') || (text[i] >= 'a' && text[i] <= 'z')) return "unsupported element";
+            return "unexpected character";
+    }
+}
+
+// Single pass like tokenize(). Bonds keep their order until the end, where C(=O)O is
+// folded into COOH and the implicit hydrogens are filled in.
+ParseError MolecularGraph::readSmiles(string_view smiles) {
+    const char* text = smiles.data();
+    size_t length = 0;
+    while (length < smiles.size() && !isspace((unsigned char)text[length])) length++;
+    if (length == 0) return {0, "empty SMILES"};
+
+    // Most atoms take one byte
+    element.reserve(length);
+    C_C_bonds.reserve(length);
+    C_H_bonds.reserve(length);
+    C_X_bonds.reserve(length);
+    sourceOffset.reserve(length);
+    edges.reserve(length);
+    bondOrder.clear();
+    implicitHydrogens.clear();
+    branchPoints.clear();
+    branchOffsets.clear();
+    ringOpenAtom.assign(100, -1);
+    ringOpenOffset.assign(100, 0);
+    ringOpenOrder.assign(100, 0);
+    int openRings = 0;
+    bool multipleBonds = false;
+
+    int previousAtom = -1;
+    bool afterAtom = false;   // Ring labels must follow their atom directly
+    size_t atomEdges = 0;     // First edge added with previousAtom; all of its bonds so far follow
+    uint8_t pendingOrder = 0; // Bond symbol waiting for its atom or ring label
+    size_t pendingOffset = 0;
+    size_t i = 0;
+    while (i < length) {
+        const size_t atomStart = i;
+        const char ch = text[i];
+        Element code;
+        int hydrogens = 0;
+        bool bracket = false;
+
+        switch (ch) {
+            case '-': case '=': case '#': case '$': case '/': case '\\':
+                if (previousAtom == -1) return {i, "bond before any atom"};
+                if (pendingOrder) return {i, "two bonds in a row"};
+                pendingOrder = ch == '=' ? 2 : ch == '#' ? 3 : ch == '$' ? 4 : 1;
+                pendingOffset = i;
+                i++;
+                continue;
+            case ':':
+                return {i, "aromatic bonds are not supported"};
+            case '.':
+                return {i, "disconnected structures are not supported"};
+            case '(':
+                if (previousAtom == -1) return {i, "branch opened before any atom"};
+                if (pendingOrder) return {pendingOffset, "bond with no atom after it"};
+                if (i + 1 < length && text[i + 1] == ')') return {i, "empty branch"};
+                branchPoints.push_back(previousAtom);
+                branchOffsets.push_back(i);
+                afterAtom = false;
+                i++;
+                continue;
+            case ')':
+                if (branchPoints.empty()) return {i, "unmatched ')'"};
+                if (pendingOrder) return {pendingOffset, "bond with no atom after it"};
+                previousAtom = branchPoints.back();
+                branchPoints.pop_back();
+                branchOffsets.pop_back();
+                afterAtom = false;
+                i++;
+                continue;
+            case '%': case '0': case '1': case '2': case '3': case '4': case '5': case '6': case '7': case '8': case '9': {
+                if (!afterAtom) return {i, "ring bond label must follow its atom"};
+                int label;
+                if (ch == '%') {
+                    if (i + 2 >= length || text[i + 1] < '0' || text[i + 1] > '9' || text[i + 2] < '0' || text[i + 2] > '9') {
+                        return {i, "expected two digits after '%'"};
+                    }
+                    label = (text[i + 1] - '0') * 10 + (text[i + 2] - '0');
+                    i += 3;
+                } else {
+                    label = ch - '0';
+                    i++;
+                }
+
+                // The first use of a label opens a ring bond, the second closes it
+                int opener = ringOpenAtom[label];
+                if (opener == -1) {
+                    ringOpenAtom[label] = previousAtom;
+                    ringOpenOffset[label] = atomStart;
+                    ringOpenOrder[label] = pendingOrder;
+                    openRings++;
+                    pendingOrder = 0;
+                    continue;
+                }
+                if (opener == previousAtom) return {atomStart, "ring bond to the same atom"};
+                for (size_t k = atomEdges; k < edges.size(); k++) {
+                    if (edges[k].first == opener || edges[k].second == opener) {
+                        return {atomStart, "ring bond duplicates an existing bond"};
+                    }
+                }
+                uint8_t order = ringOpenOrder[label];
+                if (pendingOrder && order && pendingOrder != order) return {atomStart, "ring bond orders do not match"};
+                order = max<uint8_t>({order, pendingOrder, 1});
+                addEdge(opener, previousAtom);
+                bondOrder.push_back(order);
+                multipleBonds |= order > 1;
+                ringOpenAtom[label] = -1;
+                openRings--;
+                pendingOrder = 0;
+                continue;
+            }
+            case '[': {
+                bracket = true;
+                i++;
+                if (i < length && text[i] >= '0' && text[i] <= '9') return {i, "isotopes are not supported"};
+                if (i >= length) return {atomStart, "unclosed '['"};
+                if (const char* message = readElement(text, length, i, code)) return {i, message};
+                while (i < length && text[i] == '@') i++;  // Chirality does not change the name
+                if (i < length && text[i] == 'H') {
+                    i++;
+                    hydrogens = 1;
+                    if (i < length && text[i] >= '0' && text[i] <= '9') hydrogens = text[i++] - '0';
+                }
+                if (i < length && (text[i] == '+' || text[i] == '-')) return {i, "charged atoms are not supported"};
+                if (i < length && text[i] == ':') {
+                    i++;
+                    while (i < length && text[i] >= '0' && text[i] <= '9') i++;
+                }
+                if (i >= length || text[i] != ']') return {atomStart, "unclosed '['"};
+                i++;
+                break;
+            }
+            default:
+                if (const char* message = readElement(text, length, i, code)) return {i, message};
+        }
+
+        int currentAtom = addAtom(code);
+        C_H_bonds[currentAtom] = hydrogens;
+        implicitHydrogens.push_back(!bracket);
+        sourceOffset.push_back(atomStart);
+
+        atomEdges = edges.size();
+        if (previousAtom != -1) {
+            addEdge(previousAtom, currentAtom);
+            uint8_t order = pendingOrder ? pendingOrder : 1;
+            bondOrder.push_back(order);
+            multipleBonds |= order > 1;
+        }
+        pendingOrder = 0;
+        previousAtom = currentAtom;
+        afterAtom = true;
+    }
+
+    if (pendingOrder) return {pendingOffset, "bond with no atom after it"};
+    if (!branchOffsets.empty()) return {branchOffsets.back(), "unclosed '('"};
+    if (openRings > 0) {
+        size_t offset = length;
+        for (int label = 0; label < 100; label++) {
+            if (ringOpenAtom[label] != -1) offset = min(offset, ringOpenOffset[label]);
+        }
+        return {offset, "unclosed ring bond"};
+    }
+
+    if (multipleBonds) {
+        if (ParseError error = foldCarboxyls()) return error;
+    }
+
+    // Atoms written without brackets get the hydrogens their normal valence leaves free
+    for (int atom = 0; atom < atomCount(); atom++) {
+        int bonds = C_C_bonds[atom] + C_X_bonds[atom];
+        if (implicitHydrogens[atom]) C_H_bonds[atom] = max(0, maxBonds(element[atom]) - bonds);
+        if (getTotalBonds(atom) > maxBonds(element[atom])) {
+            return {sourceOffset[atom], "too many bonds on this atom"};
+        }
+    }
+
+    // Outside COOH, an O can only be the link of an ether: no hydrogens, two carbons
+    const char* badOxygen = "O is only supported in C(=O)O and as an ether O between two carbons";
+    for (auto [a, b] : edges) {
+        if (element[a] == Element::O && element[b] != Element::C) return {sourceOffset[a], badOxygen};
+        if (element[b] == Element::O && element[a] != Element::C) return {sourceOffset[b], badOxygen};
+    }
+    bool etherSeen = false;
+    for (int atom = 0; atom < atomCount(); atom++) {
+        if (element[atom] != Element::O) continue;
+        if (C_C_bonds[atom] != 2 || C_X_bonds[atom] != 0 || C_H_bonds[atom] != 0) return {sourceOffset[atom], badOxygen};
+        if (etherSeen) return {sourceOffset[atom], "only one ether O is supported"};
+        etherSeen = true;
+    }
+    return {};
+}
+
+// A carbon double-bonded to a terminal O and single-bonded to a terminal OH, with at
+// most one other (single) bond, is C(=O)O: it becomes a COOH atom and the two oxygens
+// go. Any other double or triple bond is an error.
+ParseError MolecularGraph::foldCarboxyls() {
+    finalize();
+    int n = atomCount();
+
+    // Valence each atom spends on multiple bonds beyond one per bond; atoms that are
+    // folded away are then marked -1
+    vector<int>& extra = atomMap;
+    extra.assign(n, 0);
+    for (size_t k = 0; k < edges.size(); k++) {
+        extra[edges[k].first] += bondOrder[k] - 1;
+        extra[edges[k].second] += bondOrder[k] - 1;
+    }
+    auto hydrogens = [&](int atom) {
+        int bonds = neighbors(atom).size() + extra[atom];
+        return implicitHydrogens[atom] ? max(0, maxBonds(element[atom]) - bonds) : C_H_bonds[atom];
+    };
+    auto terminalOxygen = [&](int atom, int multiple, int hydrogenCount) {
+        return element[atom] == Element::O && neighbors(atom).size() == 1 && extra[atom] == multiple &&
+               hydrogens(atom) == hydrogenCount;
+    };
+
+    for (size_t k = 0; k < edges.size(); k++) {
+        if (bondOrder[k] != 2) continue;
+        auto [carbon, oxygen] = edges[k];
+        if (element[carbon] != Element::C) swap(carbon, oxygen);
+        if (element[carbon] != Element::C || !terminalOxygen(oxygen, 1, 0)) continue;
+        int degree = neighbors(carbon).size();
+        if (extra[carbon] != 1 || degree > 3 || hydrogens(carbon) != 3 - degree) continue;
+        int hydroxyl = -1;
+        for (int neighbor : neighbors(carbon)) {
+            if (neighbor != oxygen && terminalOxygen(neighbor, 0, 1)) {
+                hydroxyl = neighbor;
+                break;
+            }
+        }
+        if (hydroxyl == -1) continue;
+        element[carbon] = Element::COOH;
+        implicitHydrogens[carbon] = 0;
+        C_H_bonds[carbon] = 0;
+        extra[oxygen] = -1;
+        extra[hydroxyl] = -1;
+    }
+
+    for (size_t k = 0; k < edges.size(); k++) {
+        auto [a, b] = edges[k];
+        if (bondOrder[k] > 1 && extra[a] != -1 && extra[b] != -1) {
+            return {sourceOffset[max(a, b)], "multiple bonds are only supported in COOH"};
+        }
+    }
+
+    // Close the gaps left by the folded oxygens and count the bonds again
+    int kept = 0;
+    for (int atom = 0; atom < n; atom++) {
+        if (atomMap[atom] == -1) continue;
+        element[kept] = element[atom];
+        C_H_bonds[kept] = C_H_bonds[atom];
+        sourceOffset[kept] = sourceOffset[atom];
+        implicitHydrogens[kept] = implicitHydrogens[atom];
+        atomMap[atom] = kept++;
+    }
+    element.resize(kept);
+    C_H_bonds.resize(kept);
+    sourceOffset.resize(kept);
+    implicitHydrogens.resize(kept);
+    C_C_bonds.assign(kept, 0);
+    C_X_bonds.assign(kept, 0);
+    size_t keptEdges = 0;
+    for (auto [a, b] : edges) {
+        if (atomMap[a] == -1 || atomMap[b] == -1) continue;
+        a = atomMap[a];
+        b = atomMap[b];
+        if (halogenType(element[a]) || halogenType(element[b])) {
+            C_X_bonds[a]++;
+            C_X_bonds[b]++;
+        } else {
+            C_C_bonds[a]++;
+            C_C_bonds[b]++;
+        }
+        edges[keptEdges++] = {a, b};
+    }
+    edges.resize(keptEdges);
+    adjacencyOffsets.clear();
+    adjacencyTargets.clear();
+    return {};
+}
+
+bool MolecularGraph::splitEther(MolecularGraph& first, MolecularGraph& second) const {
+    int oxygen = -1;
+    for (int atom = 0; atom < atomCount(); atom++) {
+        if (element[atom] != Element::O) continue;
+        if (oxygen != -1) return false;
+        oxygen = atom;
+    }
+    if (oxygen == -1 || neighbors(oxygen).size() != 2) return false;
+    int ends[2] = {neighbors(oxygen).begin()[0], neighbors(oxygen).begin()[1]};
+    if (element[ends[0]] != Element::C || element[ends[1]] != Element::C) return false;
+
+    // Lists each side's atoms in the order a walk from its carbon reaches them, without
+    // crossing the O; reaching the other carbon means the O is in a ring
+    vector<int> position(atomCount(), -1);  // Index into order
+    vector<int> order;
+    order.reserve(atomCount());
+    int sideStart[3] = {0, 0, 0};
+    position[oxygen] = atomCount();
+    for (int side = 0; side < 2; side++) {
+        sideStart[side] = order.size();
+        position[ends[side]] = order.size();
+        order.push_back(ends[side]);
+        for (size_t next = sideStart[side]; next < order.size(); next++) {
+            for (int neighbor : neighbors(order[next])) {
+                if (position[neighbor] != -1) continue;
+                position[neighbor] = order.size();
+                order.push_back(neighbor);
+            }
+        }
+        if (side == 0 && position[ends[1]] != -1) return false;
+    }
+    sideStart[2] = order.size();
+
+    MolecularGraph* groups[2] = {&first, &second};
+    for (int side = 0; side < 2; side++) {
+        MolecularGraph& group = *groups[side];
+        group.clear();
+        for (int k = sideStart[side]; k < sideStart[side + 1]; k++) {
+            int atom = order[k];
+            group.C_H_bonds[group.addAtom(element[atom])] = C_H_bonds[atom];
+            group.sourceOffset.push_back(sourceOffset[atom]);
+        }
+    }
+    for (auto [a, b] : edges) {
+        if (a == oxygen || b == oxygen) continue;
+        int side = position[a] >= sideStart[1];
+        groups[side]->addEdge(position[a] - sideStart[side], position[b] - sideStart[side]);
+    }
+    first.finalize();
+    second.finalize();
+    return true;
+}
+
+int MolecularGraph::openValenceAtom() const {
+    for (int atom = 0; atom < atomCount(); atom++) {
+        if (element[atom] == Element::C && getTotalBonds(atom) < 4) return atom;
+    }
+    return 0;
+}
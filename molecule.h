@@ -0,0 +1,146 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Element code for each atom in the table. COOH is written as one group in the
+// formula notation, so it is stored as a single pseudo-atom of its own.
+enum class Element : uint8_t { C, COOH, Cl, Br, F, I, O, Other };
+
+const char* elementSymbol(Element element);
+
+// Carbons (including the COOH carbon) are the only atoms a parent chain may run through
+inline bool isChainAtom(Element element) {
+    return element == Element::C || element == Element::COOH;
+}
+
+// Most bonds an atom of each kind may have; COOH only has its one free valence
+inline int maxBonds(Element element) {
+    switch (element) {
+        case Element::C: return 4;
+        case Element::O: return 2;
+        default: return 1;
+    }
+}
+
+// 0 indicates no halogen; 1 for chlorine, 2 for bromine, 3 for fluorine, 4 for iodine
+inline int halogenType(Element element) {
+    switch (element) {
+        case Element::Cl: return 1;
+        case Element::Br: return 2;
+        case Element::F: return 3;
+        case Element::I: return 4;
+        default: return 0;
+    }
+}
+
+// Outcome of parsing a formula. message is null on success; otherwise offset is the
+// byte in the input where parsing stopped.
+struct ParseError {
+    size_t offset = 0;
+    const char* message = nullptr;
+
+    explicit operator bool() const { return message != nullptr; }
+};
+
+// Byte where the "-O-" joining the two halves of an ether formula starts, or npos.
+// Every place that splits ether formulas uses it, so they all agree on the halves.
+size_t findEtherLink(std::string_view formula);
+
+class MolecularGraph {
+public:
+    // Atom table (struct of arrays), indexed by atom id in formula order
+    std::vector<Element> element;
+    std::vector<int> C_C_bonds;
+    std::vector<int> C_H_bonds;
+    std::vector<int> C_X_bonds;
+    std::vector<uint32_t> sourceOffset;  // Byte in the formula where each atom starts
+
+    // Bonds in the order they were parsed
+    std::vector<std::pair<int, int>> edges;
+
+    // CSR adjacency built by finalize(): the neighbours of atom a are
+    // adjacencyTargets[adjacencyOffsets[a] .. adjacencyOffsets[a + 1])
+    std::vector<int> adjacencyOffsets;
+    std::vector<int> adjacencyTargets;
+
+    struct NeighborRange {
+        const int* first;
+        const int* last;
+        const int* begin() const { return first; }
+        const int* end() const { return last; }
+        size_t size() const { return last - first; }
+    };
+
+    int atomCount() const { return element.size(); }
+
+    NeighborRange neighbors(int atom) const {
+        const int* base = adjacencyTargets.data();
+        return {base + adjacencyOffsets[atom], base + adjacencyOffsets[atom + 1]};
+    }
+
+    int getTotalBonds(int atom) const { return C_C_bonds[atom] + C_H_bonds[atom] + C_X_bonds[atom]; }
+
+    // Debug label in the legacy style, e.g. "C3" or "Cl4" (ids printed 1-based)
+    std::string atomLabel(int atom) const { return elementSymbol(element[atom]) + std::to_string(atom + 1); }
+
+    // Empties the molecule but keeps its buffers, so one graph can be reused per thread
+    void clear();
+
+    int addAtom(Element code);
+    void addEdge(int id1, int id2);
+
+    // Builds the CSR adjacency from the edge list; call once after the last addEdge
+    void finalize();
+
+    // Replaces the contents with the parsed formula. Accepts C with any hydrogen count
+    // (CH3, CH, C), COOH, Cl, Br, F, I and nested parenthesized branches; O only comes
+    // in COOH (ethers are split at findEtherLink before parsing). Carbons may
+    // carry ring-closure labels before their hydrogens (C1H2, C12, C%10); the two atoms
+    // sharing a label are bonded. On error the graph is left empty. Without
+    // buildAdjacency the caller runs finalize() itself.
+    ParseError parseMolecularFormula(std::string_view formula, bool buildAdjacency = true);
+
+    // Replaces the contents with the parsed SMILES, which ends at the first whitespace
+    // (a title may follow). Takes the organic subset C, O, F, Cl, Br, I with implicit
+    // hydrogens, bracket atoms of those elements ([CH2], [OH]), branches and ring
+    // closures (C1, C%12, with a bond order on either end). C(=O)O with a free OH
+    // becomes one COOH atom; any other O must be the one O of an ether, between two
+    // carbons. Other double and triple bonds, aromatic atoms, charges, isotopes and '.'
+    // are errors. Stereo marks (/, \, @) are skipped. On error the
+    // graph is left empty.
+    ParseError parseSmiles(std::string_view smiles, bool buildAdjacency = true);
+
+    // For an ether whose one O is bonded to two carbons and sits in no ring: the two
+    // groups on either side, finalized, each with the carbon that held the O as atom 0
+    // and one bond short there, like the halves of an "-O-" formula. Needs the
+    // adjacency; returns false for anything else, leaving first and second alone.
+    bool splitEther(MolecularGraph& first, MolecularGraph& second) const;
+
+    // The carbon of an ether half that is one bond short, where the O attaches: atom 0
+    // of a splitEther half, the last carbon written in the left half of "X-O-Y", the
+    // first in the right half. The first carbon with a bond free, else atom 0.
+    int openValenceAtom() const;
+    void printAtomsInfo(std::ostream& log) const;
+    void printEdges(std::ostream& log) const;
+
+private:
+    ParseError tokenize(std::string_view formula);
+    ParseError readSmiles(std::string_view smiles);
+    ParseError foldCarboxyls();
+
+    // Parser state, kept between calls so reused graphs do not reallocate it
+    std::vector<int> branchPoints;
+    std::vector<size_t> branchOffsets;
+    std::vector<std::pair<int, size_t>> ringLabels;  // Labels on the current atom
+    std::vector<int> ringOpenAtom;                   // Per label: atom that opened it, or -1
+    std::vector<size_t> ringOpenOffset;
+    std::vector<uint8_t> ringOpenOrder;   // SMILES: bond order written where the label opened
+    std::vector<uint8_t> bondOrder;       // SMILES: per edge
+    std::vector<char> implicitHydrogens;  // SMILES: per atom, 0 for bracket atoms
+    std::vector<int> atomMap;             // SMILES: new atom ids when COOH is folded
+};
@@ -0,0 +1,146 @@
+#include "name_cache.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <unistd.h>
+
+#include "canonical.h"
+
+using namespace std;
+
+NameCache::NameCache(size_t capacity, string version, size_t shardCount)
+    : header("# toolkit name cache v2 " + version) {
+    shardCount = max<size_t>(1, min(shardCount, capacity));
+    shardCapacity = max<size_t>(1, capacity / shardCount);
+    for (size_t i = 0; i < shardCount; i++) {
+        shards.push_back(make_unique<Shard>());
+    }
+}
+
+bool NameCache::lookup(uint64_t hash, const string& key, string& name) {
+    Shard& shard = shardFor(hash);
+    lock_guard<mutex> lock(shard.lock);
+
+    auto range = shard.index.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it) {
+        if (it->second->key == key) {
+            shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+            name = it->second->name;
+            hits++;
+            return true;
+        }
+    }
+    misses++;
+    return false;
+}
+
+void NameCache::insert(uint64_t hash, const string& key, const string& name) {
+    Shard& shard = shardFor(hash);
+    lock_guard<mutex> lock(shard.lock);
+
+    auto range = shard.index.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it) {
+        if (it->second->key == key) {
+            it->second->name = name;
+            shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+            return;
+        }
+    }
+
+    shard.entries.push_front({hash, key, name});
+    shard.index.emplace(hash, shard.entries.begin());
+    insertions++;
+
+    if (shard.entries.size() > shardCapacity) {
+        auto oldest = prev(shard.entries.end());
+        auto victims = shard.index.equal_range(oldest->hash);
+        for (auto it = victims.first; it != victims.second; ++it) {
+            if (it->second == oldest) {
+                shard.index.erase(it);
+                break;
+            }
+        }
+        shard.entries.pop_back();
+        evictions++;
+    }
+}
+
+NameCache::Stats NameCache::stats() const {
+    Stats result;
+    result.hits = hits;
+    result.misses = misses;
+    result.insertions = insertions;
+    result.evictions = evictions;
+    for (const auto& shard : shards) {
+        lock_guard<mutex> lock(shard->lock);
+        result.entries += shard->entries.size();
+    }
+    return result;
+}
+
+static string toHex(const string& bytes) {
+    static const char digits[] = "0123456789abcdef";
+    string hex;
+    hex.reserve(bytes.size() * 2);
+    for (unsigned char byte : bytes) {
+        hex.push_back(digits[byte >> 4]);
+        hex.push_back(digits[byte & 0xf]);
+    }
+    return hex;
+}
+
+static bool fromHex(const string& hex, string& bytes) {
+    if (hex.size() % 2) return false;
+    auto value = [](char c) {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        return -1;
+    };
+    bytes.clear();
+    for (size_t i = 0; i < hex.size(); i += 2) {
+        int high = value(hex[i]);
+        int low = value(hex[i + 1]);
+        if (high < 0 || low < 0) return false;
+        bytes.push_back((char)(high << 4 | low));
+    }
+    return true;
+}
+
+bool NameCache::load(const string& path, string& error) {
+    error.clear();
+    ifstream in(path);
+    if (!in) return false;
+
+    // Names from other rules or options would be served as if they were current
+    string line;
+    if (!getline(in, line) || line != header) {
+        error = "saved by other naming rules or options";
+        return false;
+    }
+    string key;
+    while (getline(in, line)) {
+        size_t tab = line.find('\t');
+        if (line.empty() || line[0] == '#' || tab == string::npos) continue;
+        if (!fromHex(line.substr(0, tab), key)) continue;
+        insert(fnv1a(key), key, line.substr(tab + 1));
+    }
+    return true;
+}
+
+bool NameCache::save(const string& path) const {
+    string temporary = path + ".tmp." + to_string(getpid());
+    {
+        ofstream out(temporary);
+        if (!out) return false;
+        out << header << '\n';
+        for (const auto& shard : shards) {
+            lock_guard<mutex> lock(shard->lock);
+            for (auto it = shard->entries.rbegin(); it != shard->entries.rend(); ++it) {
+                out << toHex(it->key) << '\t' << it->name << '\n';
+            }
+        }
+        if (!out) return false;
+    }
+    return rename(temporary.c_str(), path.c_str()) == 0;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Bounded LRU cache from canonical structure codes to IUPAC names. Entries are spread
+// over independently locked shards by hash so concurrent namers rarely contend.
+class NameCache {
+public:
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t insertions = 0;
+        uint64_t evictions = 0;
+        size_t entries = 0;
+    };
+
+    // version names the rules and options the names were made under; files saved
+    // under another version are not loaded
+    explicit NameCache(size_t capacity, std::string version = "", size_t shardCount = 16);
+
+    // key is the full canonical code; hash only picks the shard and bucket
+    bool lookup(uint64_t hash, const std::string& key, std::string& name);
+    void insert(uint64_t hash, const std::string& key, const std::string& name);
+
+    Stats stats() const;
+
+    // Text snapshot: a header line with the version, then one "<hex code>\t<name>" line
+    // per entry, least recently used first. load() fails with an empty error for a
+    // missing file, and loads nothing when the header does not match. save() writes
+    // to a temporary file and renames it into place.
+    bool load(const std::string& path, std::string& error);
+    bool save(const std::string& path) const;
+
+private:
+    struct Entry {
+        uint64_t hash;
+        std::string key;
+        std::string name;
+    };
+
+    struct Shard {
+        mutable std::mutex lock;
+        std::list<Entry> entries;  // Most recently used at the front
+        std::unordered_multimap<uint64_t, std::list<Entry>::iterator> index;
+    };
+
+    Shard& shardFor(uint64_t hash) { return *shards[hash % shards.size()]; }
+
+    std::string header;  // First line of a saved file
+    size_t shardCapacity;
+    std::vector<std::unique_ptr<Shard>> shards;
+    std::atomic<uint64_t> hits{0};
+    std::atomic<uint64_t> misses{0};
+    std::atomic<uint64_t> insertions{0};
+    std::atomic<uint64_t> evictions{0};
+};
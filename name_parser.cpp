@@ -0,0 +1,351 @@
+#include "name_parser.h"
+
+#include <string>
+#include <vector>
+
+#include "nomenclature.h"
+
+using namespace std;
+
+enum class Suffix { Ane, Yl, OicAcid, CarboxylicAcid };
+
+// The parent named by the root word of a name or ether group
+struct Parent {
+    int length = 0;
+    bool ring = false;
+    Suffix suffix = Suffix::Ane;
+};
+
+struct Token {
+    string_view text;
+    size_t offset = 0;
+};
+
+static constexpr Element halogenElements[] = {Element::Other, Element::Cl, Element::Br, Element::F, Element::I};
+
+// Words are separated by spaces; false at the end of the name
+static bool nextToken(string_view name, size_t& pos, Token& token) {
+    while (pos < name.size() && name[pos] == ' ') pos++;
+    if (pos >= name.size()) return false;
+    size_t end = name.find(' ', pos);
+    if (end == string_view::npos) end = name.size();
+    token = {name.substr(pos, end - pos), pos};
+    pos = end;
+    return true;
+}
+
+// Substituent prefixes start with their locants: "2-methyl", "(2,4)-dichloro"
+static bool isPrefixToken(string_view text) {
+    return !text.empty() && (text[0] == '(' || (text[0] >= '0' && text[0] <= '9'));
+}
+
+static bool expectWord(string_view name, size_t& pos, string_view word) {
+    Token token;
+    return nextToken(name, pos, token) && token.text == word;
+}
+
+// "Pentane", "Propanoic" (of "Propanoic acid"), "Cyclohexanecarboxylic", "Ethyl"
+static ParseError parseRoot(const Token& token, Parent& parent) {
+    string_view word = token.text;
+    size_t stemOffset = token.offset;
+    parent.ring = word.starts_with("Cyclo");
+    if (parent.ring) {
+        word.remove_prefix(5);
+        stemOffset += 5;
+    }
+
+    static constexpr pair<string_view, Suffix> endings[] = {
+        {"anecarboxylic", Suffix::CarboxylicAcid}, {"anoic", Suffix::OicAcid}, {"ane", Suffix::Ane}, {"yl", Suffix::Yl}};
+    bool matched = false;
+    for (const auto& [ending, suffix] : endings) {
+        if (word.size() > ending.size() && word.ends_with(ending)) {
+            word.remove_suffix(ending.size());
+            parent.suffix = suffix;
+            matched = true;
+            break;
+        }
+    }
+    if (!matched) return {token.offset, "expected a parent name ending in -ane, -yl or -oic acid"};
+    if (parent.ring ? parent.suffix == Suffix::OicAcid : parent.suffix == Suffix::CarboxylicAcid) {
+        return {token.offset, "acid suffix does not match the parent"};
+    }
+
+    // Roots are capitalized ("Undec"), ring stems follow "Cyclo" in lower case
+    char stem[64];
+    if (word.empty() || word.size() >= sizeof(stem)) return {stemOffset, "unknown chain stem"};
+    word.copy(stem, word.size());
+    if (stem[0] >= 'A' && stem[0] <= 'Z') stem[0] += 'a' - 'A';
+    parent.length = parseAlkaneStem(string_view(stem, word.size()));
+    if (parent.length == 0) return {stemOffset, "unknown chain stem"};
+    if (parent.ring && parent.length < 3) return {stemOffset, "a ring needs at least three carbons"};
+    return {};
+}
+
+// Adds the parent chain or ring; locant k is atom base + k - 1. Returns base.
+static int addParent(MolecularGraph& molecule, const Parent& parent) {
+    int base = molecule.atomCount();
+    for (int i = 0; i < parent.length; i++) {
+        molecule.addAtom(i == 0 && parent.suffix == Suffix::OicAcid ? Element::COOH : Element::C);
+        if (i > 0) molecule.addEdge(base + i - 1, base + i);
+    }
+    if (parent.ring) {
+        molecule.addEdge(base + parent.length - 1, base);
+    }
+    if (parent.suffix == Suffix::CarboxylicAcid) {
+        molecule.addEdge(base, molecule.addAtom(Element::COOH));
+    }
+    return base;
+}
+
+static bool overBonded(const MolecularGraph& molecule, int atom) {
+    return molecule.C_C_bonds[atom] + molecule.C_X_bonds[atom] > maxBonds(molecule.element[atom]);
+}
+
+// Reads "2", "1,1" or "2,4" (the part of a locant list between its brackets) and
+// attaches a copy of the substituent kind at each locant; chain[k - 1] is locant k
+static ParseError addAtLocants(string_view locants, size_t offset, string_view kind, size_t kindOffset,
+                               MolecularGraph& molecule, const vector<int>& chain);
+
+// Removes the multiplier matching count from the front of kind: "di", "tri", ... for
+// simple substituents ("di-" before sec-/tert-), "bis", "tris", ... before "(...)"
+static bool stripMultiplier(string_view& kind, int count) {
+    if (count == 1) return true;
+    string complex;
+    appendComplexMultiplier(complex, count);
+    if (kind.starts_with(complex) && kind.substr(complex.size()).starts_with('(')) {
+        kind.remove_prefix(complex.size());
+        return true;
+    }
+    string simple;
+    appendMultiplier(simple, count);
+    if (!kind.starts_with(simple)) return false;
+    kind.remove_prefix(simple.size());
+    if (kind.starts_with("-sec-") || kind.starts_with("-tert-")) kind.remove_prefix(1);
+    return true;
+}
+
+// Length of a complex name "(...)" at the front of text, brackets included, or 0
+static size_t bracketedLength(string_view text) {
+    if (!text.starts_with('(')) return 0;
+    int depth = 0;
+    for (size_t i = 0; i < text.size(); i++) {
+        if (text[i] == '(') depth++;
+        if (text[i] == ')' && --depth == 0) return i + 1;
+    }
+    return 0;
+}
+
+// Adds one substituent bonded to attach: a halogen ("chloro"), a straight alkyl
+// ("methyl"), a halogenated alkyl ("chloro-methyl", halogen on the far end), a retained
+// name ("isopropyl", "sec-butyl", "tert-butyl") or a complex one ("(2-methylpropyl)")
+static ParseError addBranch(string_view kind, size_t offset, MolecularGraph& molecule, int attach) {
+    static constexpr pair<string_view, string_view> retained[] = {
+        {"isopropyl", "(1-methylethyl)"}, {"sec-butyl", "(1-methylpropyl)"}, {"tert-butyl", "(1,1-dimethylethyl)"}};
+    for (const auto& [name, systematic] : retained) {
+        if (kind == name) kind = systematic;
+    }
+
+    if (kind.starts_with('(')) {
+        if (bracketedLength(kind) != kind.size()) return {offset, "unclosed '(' in a substituent"};
+        string_view body = kind.substr(1, kind.size() - 2);
+        size_t bodyOffset = offset + 1;
+
+        // Prefix groups ("1-ethyl-2-methyl") and then the stem of the substituent's own
+        // chain, which runs from attach: "butyl"
+        struct Group {
+            string_view locants, kind;
+            size_t offset, kindOffset;
+        };
+        vector<Group> groups;
+        size_t pos = 0;
+        while (pos < body.size() && body[pos] >= '0' && body[pos] <= '9') {
+            size_t dash = body.find('-', pos);
+            if (dash == string_view::npos) return {bodyOffset + pos, "expected '-' after the locants"};
+            Group group{body.substr(pos, dash - pos), {}, bodyOffset + pos, bodyOffset + dash + 1};
+            size_t nameStart = dash + 1;
+            string_view rest = body.substr(nameStart);
+            size_t open = rest.find('(');
+            size_t nameLength = open != string_view::npos && rest.find("yl") > open ? open + bracketedLength(rest.substr(open)) : 0;
+            if (nameLength == 0) {
+                size_t yl = rest.find("yl");
+                if (yl == string_view::npos) return {group.kindOffset, "unknown substituent"};
+                nameLength = yl + 2;
+            }
+            group.kind = rest.substr(0, nameLength);
+            groups.push_back(group);
+            pos = nameStart + nameLength;
+            if (pos < body.size() && body[pos] == '-') pos++;
+        }
+
+        string_view stem = body.substr(pos);
+        int length = stem.size() > 2 && stem.ends_with("yl") ? parseAlkaneStem(stem.substr(0, stem.size() - 2)) : 0;
+        if (length == 0) return {bodyOffset + pos, "unknown substituent"};
+        vector<int> chain;
+        for (int i = 0; i < length; i++) {
+            chain.push_back(molecule.addAtom(Element::C));
+            molecule.addEdge(i == 0 ? attach : chain[i - 1], chain[i]);
+        }
+        for (const Group& group : groups) {
+            if (ParseError error = addAtLocants(group.locants, group.offset, group.kind, group.kindOffset, molecule, chain)) {
+                return error;
+            }
+        }
+        return {};
+    }
+
+    int carbons = 0;
+    int halogen = 0;
+    for (int type = 1; type <= 4 && !halogen; type++) {
+        string_view prefix = halogenPrefix(type);
+        if (kind == prefix) {
+            halogen = type;
+            kind = {};
+        } else if (kind.size() > prefix.size() && kind.starts_with(prefix) && kind[prefix.size()] == '-') {
+            halogen = type;
+            kind.remove_prefix(prefix.size() + 1);
+        }
+    }
+    if (!kind.empty()) {
+        if (kind.size() <= 2 || !kind.ends_with("yl")) return {offset, "unknown substituent"};
+        kind.remove_suffix(2);
+        carbons = parseAlkaneStem(kind);
+        if (carbons == 0) return {offset, "unknown substituent"};
+    }
+
+    int previous = attach;
+    for (int c = 0; c < carbons; c++) {
+        int atom = molecule.addAtom(Element::C);
+        molecule.addEdge(previous, atom);
+        previous = atom;
+    }
+    if (halogen) {
+        molecule.addEdge(previous, molecule.addAtom(halogenElements[halogen]));
+    }
+    return {};
+}
+
+static ParseError addAtLocants(string_view locants, size_t offset, string_view kind, size_t kindOffset,
+                               MolecularGraph& molecule, const vector<int>& chain) {
+    int count = 1;
+    for (char ch : locants) {
+        if (ch == ',') count++;
+    }
+    string_view spelled = kind;
+    if (!stripMultiplier(kind, count)) return {kindOffset, "multiplier does not match the number of locants"};
+    kindOffset += spelled.size() - kind.size();
+
+    int length = chain.size();
+    size_t pos = 0;
+    while (pos < locants.size()) {
+        size_t numberStart = pos;
+        int locant = 0;
+        while (pos < locants.size() && locants[pos] >= '0' && locants[pos] <= '9') {
+            locant = locant * 10 + (locants[pos] - '0');
+            if (locant > length) break;
+            pos++;
+        }
+        if (pos == numberStart || locant < 1 || locant > length) return {offset + numberStart, "locant out of range"};
+        if (pos < locants.size() && locants[pos++] != ',') return {offset + pos - 1, "expected ',' between locants"};
+
+        int chainAtom = chain[locant - 1];
+        if (ParseError error = addBranch(kind, kindOffset, molecule, chainAtom)) return error;
+        if (overBonded(molecule, chainAtom)) return {offset + numberStart, "too many substituents on this atom"};
+    }
+    return {};
+}
+
+// One prefix word: locants, '-', an optional multiplier matching the locant count, then
+// the substituent name
+static ParseError addSubstituent(const Token& token, MolecularGraph& molecule, const vector<int>& chain) {
+    string_view text = token.text;
+    size_t locantsStart, locantsEnd, dash;
+    if (text[0] == '(') {
+        size_t close = text.find(')');
+        if (close == string_view::npos) return {token.offset, "unclosed locant list"};
+        locantsStart = 1;
+        locantsEnd = close;
+        dash = close + 1;
+    } else {
+        locantsStart = 0;
+        locantsEnd = text.find('-');
+        if (locantsEnd == string_view::npos) return {token.offset, "expected '-' after the locant"};
+        dash = locantsEnd;
+    }
+    if (dash >= text.size() || text[dash] != '-') return {token.offset + dash, "expected '-' after the locants"};
+
+    return addAtLocants(text.substr(locantsStart, locantsEnd - locantsStart), token.offset + locantsStart,
+                        text.substr(dash + 1), token.offset + dash + 1, molecule, chain);
+}
+
+// Parses the whole name into molecule, without hydrogens or adjacency
+static ParseError parseInto(string_view name, MolecularGraph& molecule) {
+    size_t pos = 0;
+    int attachments[2];
+    int groups = 0;
+
+    while (true) {
+        // Skip over the prefixes to the root word, build the parent, then attach them
+        size_t groupStart = pos;
+        Token root;
+        do {
+            if (!nextToken(name, pos, root)) return {name.size(), "expected a parent name"};
+        } while (isPrefixToken(root.text));
+
+        Parent parent;
+        if (ParseError error = parseRoot(root, parent)) return error;
+        int base = addParent(molecule, parent);
+
+        vector<int> chain(parent.length);
+        for (int i = 0; i < parent.length; i++) {
+            chain[i] = base + i;
+        }
+        size_t scan = groupStart;
+        Token prefix;
+        while (nextToken(name, scan, prefix) && prefix.offset < root.offset) {
+            if (ParseError error = addSubstituent(prefix, molecule, chain)) return error;
+        }
+        attachments[groups++] = base;
+
+        size_t end = pos;
+        Token extra;
+        switch (parent.suffix) {
+            case Suffix::OicAcid:
+            case Suffix::CarboxylicAcid:
+                if (groups > 1 || !expectWord(name, pos, "acid")) return {pos, "expected 'acid'"};
+                break;
+            case Suffix::Ane:
+                if (groups > 1) return {root.offset, "expected an alkyl group before 'ether'"};
+                break;
+            case Suffix::Yl: {
+                if (groups == 1) continue;  // First half of an ether
+                if (!expectWord(name, pos, "ether")) return {end, "expected 'ether'"};
+                int oxygen = molecule.addAtom(Element::O);
+                molecule.addEdge(attachments[0], oxygen);
+                molecule.addEdge(attachments[1], oxygen);
+                if (overBonded(molecule, attachments[0]) || overBonded(molecule, attachments[1])) {
+                    return {root.offset, "too many substituents on this atom"};
+                }
+                break;
+            }
+        }
+        if (nextToken(name, pos, extra)) return {extra.offset, "unexpected text after the name"};
+        return {};
+    }
+}
+
+ParseError parseName(string_view name, MolecularGraph& molecule) {
+    molecule.clear();
+    ParseError error = parseInto(name, molecule);
+    if (error) {
+        molecule.clear();
+        return error;
+    }
+
+    for (int atom = 0; atom < molecule.atomCount(); atom++) {
+        if (molecule.element[atom] == Element::C) {
+            molecule.C_H_bonds[atom] = 4 - molecule.C_C_bonds[atom] - molecule.C_X_bonds[atom];
+        }
+    }
+    molecule.finalize();
+    return {};
+}
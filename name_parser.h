@@ -0,0 +1,15 @@
+#pragma once
+
+#include <string_view>
+
+#include "molecule.h"
+
+// Name -> structure, the inverse of Namer for the names it writes:
+//   "(2,4)-dimethyl Pentane", "1-chloro 2-methyl Butane", "2-chloro-methyl Propane",
+//   "Propanoic acid", "1-chloro 3-methyl Cyclohexane", "Cyclobutanecarboxylic acid",
+//   "Ethyl Methyl ether", "(5,6)-di-tert-butyl Decane", "3-(2-methylpropyl) Hexane"
+// Replaces the contents of molecule. Retained and complex substituent names are built
+// out in full; a "chloro-ethyl" branch is a straight chain with the halogen on its
+// far end (the name does not say more). Ethers become one graph with an O atom joining locant 1 of both groups.
+// On error the graph is left empty and the offset points into name.
+ParseError parseName(std::string_view name, MolecularGraph& molecule);
@@ -0,0 +1,1655 @@
+#include "namer.h"
+
+#include <algorithm>
+#include <bit>
+#include <cctype>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+
+#include "canonical.h"
+#include "nomenclature.h"
+#include "rings.h"
+
+using namespace std;
+
+// -------------------- Helper Functions --------------------
+
+// Modified DFS to track path
+pair<int, vector<int>> dfsWithConditions(const MolecularGraph& molecule, int node, vector<char>& visited) {
+    visited[node] = 1;
+    int maxLength = 0;
+    vector<int> longestPath = {node};
+
+    for (int neighbor : molecule.neighbors(node)) {
+        if (!visited[neighbor] && isChainAtom(molecule.element[neighbor])) {
+            auto [length, path] = dfsWithConditions(molecule, neighbor, visited);
+            if (length + 1 > maxLength) {
+                maxLength = length + 1;
+                longestPath = {node};
+                longestPath.insert(longestPath.end(), path.begin(), path.end());
+            }
+        }
+    }
+    visited[node] = 0; // Backtrack
+    return {maxLength, longestPath};
+}
+
+// Reference longest-chain search: exhaustive backtracking over every simple path.
+// Exponential on branched skeletons; kept to cross-check the linear-time engine below.
+vector<int> findLongestCarbonChainReference(const MolecularGraph& molecule, int startNode) {
+    vector<char> visited(molecule.atomCount(), 0);
+
+    // Step 1: First DFS to find the farthest node from startNode
+    auto [_, farthestNodePath] = dfsWithConditions(molecule, startNode, visited);
+    int farthestNode = farthestNodePath.back();
+
+    // Step 2: Second DFS from the farthest node found in the first DFS
+    auto [longestChainLength, longestChainPath] = dfsWithConditions(molecule, farthestNode, visited);
+
+    return longestChainPath; // Returns the path (chain of nodes) in one direction
+}
+
+// Reference version of findLongestChainWithCOOH built on dfsWithConditions
+vector<int> findLongestChainWithCOOHReference(const MolecularGraph& molecule, const vector<int>& coohNodes) {
+    vector<int> longestChain;
+    vector<char> visited(molecule.atomCount(), 0);
+
+    for (int coohNode : coohNodes) {
+        // Start DFS from the COOH node
+        auto [_, path] = dfsWithConditions(molecule, coohNode, visited);
+
+        // Keep track of the longest path found
+        if (path.size() > longestChain.size()) {
+            longestChain = path;
+        }
+    }
+
+    // If the COOH group is at the end of the chain, reverse the chain
+    // if (!longestChain.empty() && longestChain.back() == *coohNodes.begin()) {
+    reverse(longestChain.begin(), longestChain.end());
+    // }
+
+    return longestChain;
+}
+
+// -------------------- Linear-Time Chain Engine --------------------
+// For acyclic skeletons the longest chain is the tree diameter: the farthest node from
+// any start is one end of it, and the farthest node from that end is the other.
+// Each pass is an iterative walk that only records a predecessor per atom.
+
+// Walks the carbon skeleton around startNode and returns the farthest atom;
+// scratch.parent is filled so the path back to startNode can be traced
+int findFarthestNode(const MolecularGraph& molecule, int startNode, NamerScratch& scratch) {
+    vector<int>& parent = scratch.parent;
+    vector<int>& depth = scratch.depth;
+    vector<int>& toVisit = scratch.toVisit;
+
+    parent.assign(molecule.atomCount(), -1);
+    depth.assign(molecule.atomCount(), -1);
+    toVisit.clear();
+
+    toVisit.push_back(startNode);
+    depth[startNode] = 0;
+    int farthestNode = startNode;
+
+    while (!toVisit.empty()) {
+        int node = toVisit.back();
+        toVisit.pop_back();
+        scratch.counters.nodesVisited++;
+
+        if (depth[node] > depth[farthestNode]) {
+            farthestNode = node;
+        }
+
+        for (int neighbor : molecule.neighbors(node)) {
+            if (depth[neighbor] == -1 && isChainAtom(molecule.element[neighbor])) {
+                depth[neighbor] = depth[node] + 1;
+                parent[neighbor] = node;
+                toVisit.push_back(neighbor);
+            }
+        }
+    }
+    return farthestNode;
+}
+
+// Follows predecessors from endNode back to the start of the walk
+vector<int> tracePath(int endNode, const vector<int>& parent) {
+    vector<int> path;
+    for (int node = endNode; node != -1; node = parent[node]) {
+        path.push_back(node);
+    }
+    return path;
+}
+
+// Function to find the longest carbon chain with path tracking
+vector<int> findLongestCarbonChain(const MolecularGraph& molecule, int startNode, NamerScratch& scratch) {
+    // Step 1: The farthest node from startNode is one end of the longest chain
+    int firstEnd = findFarthestNode(molecule, startNode, scratch);
+
+    // Step 2: The farthest node from that end is the other one
+    int secondEnd = findFarthestNode(molecule, firstEnd, scratch);
+
+    vector<int> path = tracePath(secondEnd, scratch.parent);
+    reverse(path.begin(), path.end());
+    return path; // Starts at firstEnd, like the reference search
+}
+
+// The longest chain starting at a COOH carbon ends at the atom farthest from it,
+// so one walk per COOH node is enough
+vector<int> findLongestChainWithCOOH(const MolecularGraph& molecule, const vector<int>& coohNodes, NamerScratch& scratch) {
+    vector<int> longestChain;
+
+    for (int coohNode : coohNodes) {
+        int farthestNode = findFarthestNode(molecule, coohNode, scratch);
+        if (longestChain.empty() || scratch.depth[farthestNode] + 1 > (int)longestChain.size()) {
+            longestChain = tracePath(farthestNode, scratch.parent);  // Ends at the COOH node
+        }
+    }
+
+    return longestChain;
+}
+
+void appendBranchName(string& out, int numCarbons, int halogenType) {
+    // A halogen bonded straight to the chain has no carbons of its own
+    if (numCarbons == 0) {
+        out += halogenPrefix(halogenType);
+        return;
+    }
+
+    // Halogenated alkyl branches keep the legacy "chloro-methyl" form
+    if (halogenType > 0) {
+        out += halogenPrefix(halogenType);
+        out += '-';
+    }
+    appendAlkaneStem(out, numCarbons);
+    out += "yl";
+}
+
+static void appendNumber(string& out, int value) {
+    char digits[16];
+    auto [end, _] = to_chars(digits, digits + sizeof(digits), value);
+    out.append(digits, end);
+}
+
+// -------------------- Substituent Names --------------------
+
+// Alphabetical order skips locants and the italic sec-/tert- prefixes:
+// "(1,2-dimethylpropyl)" files under d, "tert-butyl" under b
+static string_view alphabeticalKey(string_view name) {
+    size_t start = name.find_first_not_of("(0123456789,-");
+    name.remove_prefix(start == string_view::npos ? name.size() : start);
+    for (string_view italic : {"sec-", "tert-"}) {
+        if (name.starts_with(italic)) name.remove_prefix(italic.size());
+    }
+    return name;
+}
+
+bool alphabeticallyBefore(string_view a, string_view b) {
+    string_view keyA = alphabeticalKey(a);
+    string_view keyB = alphabeticalKey(b);
+    return keyA != keyB ? keyA < keyB : a < b;
+}
+
+// "methyl", "dimethyl", "di-tert-butyl", "bis(2-methylpropyl)"
+static void appendMultipliedName(string& out, int count, string_view name) {
+    if (count > 1 && name.starts_with('(')) {
+        appendComplexMultiplier(out, count);
+    } else {
+        appendMultiplier(out, count);
+        if (count > 1 && (name.starts_with("sec-") || name.starts_with("tert-"))) out += '-';
+    }
+    out += name;
+}
+
+// Fibonacci hashing: the top bits of the product, which every bit of the key reaches
+static size_t slotFor(uint64_t key, size_t slotCount) {
+    return (key * 0x9e3779b97f4a7c15ull) >> (64 - countr_zero(slotCount));
+}
+
+int BranchNamer::intern(const int* children, int count) {
+    Shape shape{{-1, -1, -1}, count, 0, -1, 0, true, -1};
+    copy(children, children + count, shape.children.begin());
+    sort(shape.children.begin(), shape.children.begin() + count);
+
+    // 21 bits per child shape, so ids stay below 2^21 - 1
+    uint64_t key = 0;
+    for (int child : shape.children) {
+        key = key << 21 | uint64_t(child + 1);
+    }
+    if (2 * (shapes.size() + 1) > slots.size()) growSlots();
+    size_t mask = slots.size() - 1;
+    size_t at = slotFor(key, slots.size());
+    while (slots[at].shape != -1) {
+        if (slots[at].key == key) return slots[at].shape;
+        at = (at + 1) & mask;
+    }
+    if (shapes.size() >= (1u << 21) - 2) return -1;
+
+    for (int i = 0; i < count; i++) {
+        shape.height = max(shape.height, shapes[shape.children[i]].height + 1);
+    }
+    shape.straight = count == 0 || (count == 1 && shapes[shape.children[0]].straight);
+
+    // The substituent's own chain goes on through a deepest child; between several, the
+    // one leaving more substituents, then lower locants, then alphabetical order
+    for (int i = 0; i < count; i++) {
+        int child = shape.children[i];
+        if (shapes[child].height + 1 != shape.height || child == shape.next) continue;
+        if (shape.next == -1 || betterContinuation(shape, child, shape.next)) shape.next = child;
+    }
+    if (shape.next != -1) shape.substituents = count - 1 + shapes[shape.next].substituents;
+
+    slots[at] = {key, (int)shapes.size()};
+    shapes.push_back(shape);
+    return shapes.size() - 1;
+}
+
+void BranchNamer::growSlots() {
+    vector<Slot> old = move(slots);
+    slots.assign(max<size_t>(1024, 2 * old.size()), Slot());
+    size_t mask = slots.size() - 1;
+    for (const Slot& slot : old) {
+        if (slot.shape == -1) continue;
+        size_t at = slotFor(slot.key, slots.size());
+        while (slots[at].shape != -1) at = (at + 1) & mask;
+        slots[at] = slot;
+    }
+}
+
+// Names of shape's children but one instance of skip, in alphabetical order
+void BranchNamer::siblingNames(const Shape& shape, int skip, vector<string_view>& out) {
+    bool skipped = false;
+    for (int i = 0; i < shape.childCount; i++) {
+        if (shape.children[i] == skip && !skipped) {
+            skipped = true;
+            continue;
+        }
+        out.push_back(shapeName(shape.children[i]));
+    }
+    sort(out.begin(), out.end(), alphabeticallyBefore);
+}
+
+// Whether parent's chain should continue into child a rather than b (equally deep)
+bool BranchNamer::betterContinuation(const Shape& parent, int a, int b) {
+    if (shapes[a].substituents != shapes[b].substituents) return shapes[a].substituents > shapes[b].substituents;
+
+    // As many substituents: the first carbon down carrying more of them gives lower locants
+    for (int x = a, y = b; x != -1; x = shapes[x].next, y = shapes[y].next) {
+        int here = max(shapes[x].childCount - 1, 0);
+        int there = max(shapes[y].childCount - 1, 0);
+        if (here != there) return here > there;
+    }
+
+    // Same locants: alphabetical order at the first point of difference
+    vector<string_view> namesA, namesB;
+    siblingNames(parent, a, namesA);
+    siblingNames(parent, b, namesB);
+    for (int x = a, y = b;; x = shapes[x].next, y = shapes[y].next) {
+        auto [atA, atB] = mismatch(namesA.begin(), namesA.end(), namesB.begin(), namesB.end());
+        if (atA != namesA.end() && atB != namesB.end()) return alphabeticallyBefore(*atA, *atB);
+        if (x == -1) return false;
+        namesA.clear();
+        namesB.clear();
+        siblingNames(shapes[x], shapes[x].next, namesA);
+        siblingNames(shapes[y], shapes[y].next, namesB);
+    }
+}
+
+string_view BranchNamer::shapeName(int shapeId) {
+    if (shapes[shapeId].name != -1) return names[shapes[shapeId].name];
+
+    const Shape& shape = shapes[shapeId];
+    string name;
+    if (shape.straight) {
+        appendAlkaneStem(name, shape.height + 1);
+        name += "yl";
+    } else {
+        // Substituents along the substituent's own chain, numbered from the carbon bonded
+        // to the parent, then grouped by name in alphabetical order. They are named
+        // first, so that gathering them below does not recurse.
+        auto forEachSubstituent = [&](auto visit) {
+            int locant = 1;
+            for (int x = shapeId; x != -1; x = shapes[x].next, locant++) {
+                bool skipped = false;
+                for (int i = 0; i < shapes[x].childCount; i++) {
+                    int child = shapes[x].children[i];
+                    if (child == shapes[x].next && !skipped) {
+                        skipped = true;
+                    } else {
+                        visit(child, locant);
+                    }
+                }
+            }
+        };
+        forEachSubstituent([&](int child, int) { shapeName(child); });
+        entries.clear();
+        forEachSubstituent([&](int child, int locant) {
+            string_view sub = names[shapes[child].name];
+            entries.emplace_back(alphabeticalKey(sub), sub, locant);
+        });
+        sort(entries.begin(), entries.end());
+
+        name += '(';
+        for (size_t first = 0; first < entries.size();) {
+            size_t last = first + 1;
+            while (last < entries.size() && get<1>(entries[last]) == get<1>(entries[first])) last++;
+            if (first > 0) name += '-';
+            for (size_t i = first; i < last; i++) {
+                if (i > first) name += ',';
+                appendNumber(name, get<2>(entries[i]));
+            }
+            name += '-';
+            appendMultipliedName(name, last - first, get<1>(entries[first]));
+            first = last;
+        }
+        appendAlkaneStem(name, shape.height + 1);
+        name += "yl)";
+
+        // Retained names
+        if (name == "(1-methylethyl)") {
+            name = "isopropyl";
+        } else if (name == "(1-methylpropyl)") {
+            name = "sec-butyl";
+        } else if (name == "(1,1-dimethylethyl)") {
+            name = "tert-butyl";
+        }
+    }
+
+    shapes[shapeId].name = names.size();
+    names.push_back(move(name));
+    return names.back();
+}
+
+string_view BranchNamer::legacyName(int numCarbons, int halogenType) {
+    auto [entry, added] = legacyNames.try_emplace(numCarbons * 8 + halogenType, names.size());
+    if (added) {
+        names.emplace_back();
+        appendBranchName(names.back(), numCarbons, halogenType);
+    }
+    return names[entry->second];
+}
+
+void BranchNamer::trim() {
+    constexpr size_t limit = 1 << 16;
+    if (shapes.size() < limit && names.size() < limit) return;
+    shapes.clear();
+    slots.assign(slots.size(), Slot());
+    legacyNames.clear();
+    names.clear();
+    trims++;
+}
+
+// Top-down: the branches of every atom in chain, and every atom in them with parents
+// before children in branchOrder
+static void walkBranches(const MolecularGraph& molecule, span<const int> chain, NamerScratch& scratch,
+                         bool skipAcids) {
+    int atomCount = molecule.atomCount();
+    const vector<char>& onMainChain = scratch.onMainChain;
+    vector<BranchInfo>& branches = scratch.branches;
+    branches.clear();
+    scratch.branchCount.assign(atomCount, 0);
+    scratch.firstBranch.assign(atomCount, -1);
+    if ((int)scratch.branchParent.size() < atomCount) {
+        scratch.branchParent.resize(atomCount);
+        scratch.branchCarbons.resize(atomCount);
+        scratch.branchHalogen.resize(atomCount);
+        scratch.branchShape.resize(atomCount);
+        scratch.shapeCount.resize(atomCount);
+        scratch.childShapes.resize(atomCount);
+    }
+    vector<int>& parent = scratch.branchParent;
+    vector<int>& order = scratch.branchOrder;
+    vector<int>& toVisit = scratch.toVisit;
+    order.clear();
+    for (int atom : chain) {
+        for (int root : molecule.neighbors(atom)) {
+            if (onMainChain[root] || (skipAcids && isCOOHGroup(molecule, root))) continue;
+            if (scratch.branchCount[atom]++ == 0) scratch.firstBranch[atom] = branches.size();
+            branches.push_back({atom, root, 0, 0, {}});
+
+            parent[root] = atom;
+            toVisit.assign(1, root);
+            while (!toVisit.empty()) {
+                int node = toVisit.back();
+                toVisit.pop_back();
+                order.push_back(node);
+                for (int neighbor : molecule.neighbors(node)) {
+                    if (neighbor == parent[node] || onMainChain[neighbor]) continue;
+                    parent[neighbor] = node;
+                    toVisit.push_back(neighbor);
+                }
+            }
+        }
+    }
+    scratch.counters.nodesVisited += order.size();
+}
+
+// Bottom-up over branchOrder: each atom hands its totals and shape to its parent
+static void summarizeBranches(const MolecularGraph& molecule, NamerScratch& scratch) {
+    const vector<char>& onMainChain = scratch.onMainChain;
+    const vector<int>& order = scratch.branchOrder;
+    const vector<int>& parent = scratch.branchParent;
+    vector<int>& carbons = scratch.branchCarbons;
+    vector<int>& halogen = scratch.branchHalogen;
+    vector<int>& shapeCount = scratch.shapeCount;
+    vector<array<int, 3>>& childShapes = scratch.childShapes;
+    for (int node : order) {
+        carbons[node] = 0;
+        halogen[node] = 0;
+        shapeCount[node] = 0;
+    }
+
+    for (size_t i = order.size(); i-- > 0;) {
+        int node = order[i];
+        Element code = molecule.element[node];
+        int shape = -1;
+        if (code == Element::C) {
+            carbons[node]++;
+            if (shapeCount[node] >= 0) shape = scratch.branchNamer.intern(childShapes[node].data(), shapeCount[node]);
+        } else if (int type = halogenType(code)) {
+            if (halogen[node] == 0 || type < halogen[node]) halogen[node] = type;
+        }
+        scratch.branchShape[node] = shape;
+
+        int up = parent[node];
+        if (onMainChain[up]) continue;
+        carbons[up] += carbons[node];
+        if (halogen[node] && (halogen[up] == 0 || halogen[node] < halogen[up])) halogen[up] = halogen[node];
+        if (shape == -1 || shapeCount[up] == -1 || shapeCount[up] == 3) {
+            shapeCount[up] = -1;
+        } else {
+            childShapes[up][shapeCount[up]++] = shape;
+        }
+    }
+}
+
+// Name of the branch from atom away from the chain, once summarizeBranches has run
+static string_view branchName(int atom, NamerScratch& scratch) {
+    int shape = scratch.branchShape[atom];
+    return shape >= 0 ? scratch.branchNamer.shapeName(shape)
+                      : scratch.branchNamer.legacyName(scratch.branchCarbons[atom], scratch.branchHalogen[atom]);
+}
+
+void analyzeBranches(const MolecularGraph& molecule, const vector<int>& chain, NamerScratch& scratch,
+                     bool skipAcids, ostream* trace) {
+    scratch.branchNamer.trim();
+    walkBranches(molecule, chain, scratch, skipAcids);
+    summarizeBranches(molecule, scratch);
+
+    vector<BranchInfo>& branches = scratch.branches;
+    for (BranchInfo& branch : branches) {
+        branch.numCarbons = scratch.branchCarbons[branch.root];
+        branch.halogenType = scratch.branchHalogen[branch.root];
+        branch.name = branchName(branch.root, scratch);
+        if (trace) *trace << "Branch at " << molecule.atomLabel(branch.atom) << ": " << branch.name << endl;
+    }
+    for (int atom : chain) {
+        int first = scratch.firstBranch[atom];
+        if (scratch.branchCount[atom] < 2) continue;
+        sort(branches.begin() + first, branches.begin() + first + scratch.branchCount[atom],
+             [](const BranchInfo& a, const BranchInfo& b) { return alphabeticallyBefore(a.name, b.name); });
+    }
+}
+
+pmr::vector<ChainSubstituent> substituentsAlong(const vector<int>& chain, NamerScratch& scratch) {
+    pmr::vector<ChainSubstituent> substituents(&scratch.arena);
+    substituents.reserve(scratch.branches.size());
+    for (size_t i = 0; i < chain.size(); i++) {
+        int first = scratch.firstBranch[chain[i]];
+        for (int k = 0; k < scratch.branchCount[chain[i]]; k++) {
+            substituents.push_back({(int)i + 1, scratch.branches[first + k].name});
+        }
+    }
+    return substituents;
+}
+
+string generateIUPACName(pmr::vector<ChainSubstituent> entries, int chainLength, int counter) {
+    // Identical names are cited once with all their locants
+    using Entry = ChainSubstituent;
+    sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+        return a.name != b.name ? a.name < b.name : a.locant < b.locant;
+    });
+
+    // Groups are runs of one name, cited in order of their lowest locant
+    pmr::vector<pair<int, int>> groups(entries.get_allocator());  // (first entry, end entry)
+    groups.reserve(entries.size());
+    for (size_t first = 0; first < entries.size();) {
+        size_t last = first + 1;
+        while (last < entries.size() && entries[last].name == entries[first].name) last++;
+        groups.emplace_back(first, last);
+        first = last;
+    }
+    sort(groups.begin(), groups.end(), [&](const pair<int, int>& a, const pair<int, int>& b) {
+        const Entry& entryA = entries[a.first];
+        const Entry& entryB = entries[b.first];
+        if (entryA.locant != entryB.locant) return entryA.locant < entryB.locant;
+        return alphabeticallyBefore(entryA.name, entryB.name);
+    });
+
+    string name;
+    name.reserve(16 * entries.size() + 8 * groups.size() + 24);
+    for (auto [first, last] : groups) {
+        if (last - first == 1) {
+            appendNumber(name, entries[first].locant);
+        } else {
+            name += '(';
+            for (int i = first; i < last; i++) {
+                if (i > first) name += ',';
+                appendNumber(name, entries[i].locant);
+            }
+            name += ')';
+        }
+        name += '-';
+        appendMultipliedName(name, last - first, entries[first].name);
+        name += ' ';
+    }
+
+    // Main chain name after the branches, e.g. "Pentane"
+    size_t root = name.size();
+    appendAlkaneStem(name, chainLength);
+    name[root] = toupper((unsigned char)name[root]);
+    if (counter == 0) {
+        name += "ane";
+    } else if (counter == 1) {
+        name += "an";
+    } else if (counter == 2) {
+        name += "yl";
+    }
+    return name;
+}
+
+
+// -------------------- Parent Chain Selection --------------------
+// Every longest chain of a tree runs through its center: the middle carbon of any
+// longest chain when that has an odd number of carbons, the middle bond when even.
+// Seen from the center, a longest chain is two arms of equal depth hanging from
+// different sides of it, so instead of listing chains (exponentially many on
+// symmetric skeletons) the search ranks arms. A level's arms are sorted once by the
+// chain rules, with the ranks one level down (arms read away from the center) or one
+// level up (arms read towards it) standing in for the rest of each arm. Names are
+// only worked out where the substituent counts tie.
+
+class ParentChainSearch {
+public:
+    ParentChainSearch(const MolecularGraph& molecule, NamerScratch& scratch)
+        : molecule(molecule), scratch(scratch), arms(scratch.chainArms) {}
+
+    vector<int> find(const vector<int>& coohNodes);
+
+private:
+    // Atom one bond closer to the center, -1 for the center atoms
+    int up(int atom) const { return scratch.onMainChain[atom] ? -1 : scratch.branchParent[atom]; }
+
+    // Substituents on atom when a longest chain runs through it
+    int substituents(int atom) const {
+        int links = (atom != start) + (arms[atom].depth < deepest);
+        return (int)molecule.neighbors(atom).size() - links;
+    }
+
+    bool deepChild(int atom, int child) const {
+        return child != up(atom) && !scratch.onMainChain[child] && arms[child].depth > arms[atom].depth &&
+               arms[child].reach == deepest;
+    }
+
+    const pair<string_view, int>* branchesOn(int atom);
+    int compareNames(int a, int skipA, int otherSkipA, int b, int skipB, int otherSkipB);
+    int compareEnds(const vector<int>& chain);
+    void rankDown(int* first, int* last);
+    void rankUp(int* first, int* last);
+    template <class CountCompare, class NameCompare>
+    void rank(int* first, int* last, CountCompare countCompare, NameCompare nameCompare, bool upward);
+
+    const MolecularGraph& molecule;
+    NamerScratch& scratch;
+    vector<ChainArm>& arms;
+    int start = -1;    // COOH atom the chain must start from
+    int deepest = 0;   // Depth of the deepest carbons
+    bool summarized = false;
+};
+
+// Branches on atom other than towards the center, sorted by name, each with the atom
+// it starts at; named the first time they are asked for
+const pair<string_view, int>* ParentChainSearch::branchesOn(int atom) {
+    ChainArm& arm = arms[atom];
+    if (arm.firstName == -1) {
+        if (!summarized) {
+            summarizeBranches(molecule, scratch);
+            summarized = true;
+        }
+        vector<pair<string_view, int>>& names = scratch.armNames;
+        arm.firstName = names.size();
+        for (int neighbor : molecule.neighbors(atom)) {
+            if (neighbor == up(atom) || scratch.onMainChain[neighbor]) continue;
+            names.emplace_back(branchName(neighbor, scratch), neighbor);
+        }
+        arm.nameCount = names.size() - arm.firstName;
+        sort(names.begin() + arm.firstName, names.end(),
+             [](const pair<string_view, int>& a, const pair<string_view, int>& b) { return alphabeticallyBefore(a.first, b.first); });
+    }
+    return scratch.armNames.data() + arm.firstName;
+}
+
+// > 0 when the branches on a, with the chain going on to skipA and otherSkipA, come
+// first alphabetically at the first point of difference from those on b
+int ParentChainSearch::compareNames(int a, int skipA, int otherSkipA, int b, int skipB, int otherSkipB) {
+    if (substituents(a) == 0) return 0;  // Only ever compared with counts that tie
+    // Naming b's branches may grow armNames, so a's are only pointed at afterwards
+    branchesOn(a);
+    const pair<string_view, int>* namesB = branchesOn(b);
+    const pair<string_view, int>* namesA = scratch.armNames.data() + arms[a].firstName;
+    const pair<string_view, int>* endA = namesA + arms[a].nameCount;
+    const pair<string_view, int>* endB = namesB + arms[b].nameCount;
+    while (true) {
+        while (namesA != endA && (namesA->second == skipA || namesA->second == otherSkipA)) namesA++;
+        while (namesB != endB && (namesB->second == skipB || namesB->second == otherSkipB)) namesB++;
+        if (namesA == endA || namesB == endB) return 0;
+        // Names are memoized, so equal ones mostly share their characters
+        string_view nameA = namesA++->first, nameB = namesB++->first;
+        if (nameA.data() != nameB.data() && nameA != nameB) return alphabeticallyBefore(nameA, nameB) ? 1 : -1;
+    }
+}
+
+// > 0 when chain numbered from its far end gets the most substituents on the first
+// atom where the two ways differ or, failing that, names earlier in the alphabet
+int ParentChainSearch::compareEnds(const vector<int>& chain) {
+    int length = chain.size();
+    for (int i = 0; i < length; i++) {
+        int order = substituents(chain[length - 1 - i]) - substituents(chain[i]);
+        if (order != 0) return order;
+    }
+    auto along = [&](int i, int step) { return i + step >= 0 && i + step < length ? chain[i + step] : -1; };
+    for (int i = 0; i < length; i++) {
+        int j = length - 1 - i;
+        int order = compareNames(chain[j], along(j, -1), along(j, 1), chain[i], along(i, -1), along(i, 1));
+        if (order != 0) return order;
+    }
+    return 0;
+}
+
+// Sorts one level worst first and numbers it: the count rank goes up whenever the
+// counts differ from the arm before, the name rank whenever anything does
+template <class CountCompare, class NameCompare>
+void ParentChainSearch::rank(int* first, int* last, CountCompare countCompare, NameCompare nameCompare, bool upward) {
+    if (last - first > 1) sort(first, last, [&](int a, int b) {
+        int order = countCompare(a, b);
+        return order != 0 ? order < 0 : nameCompare(a, b) < 0;
+    });
+    int counts = 0, names = 0;
+    for (int* atom = first; atom != last; atom++) {
+        if (atom != first) {
+            if (countCompare(atom[-1], *atom) != 0) {
+                counts++;
+                names++;
+            } else if (nameCompare(atom[-1], *atom) != 0) {
+                names++;
+            }
+        }
+        (upward ? arms[*atom].upCountRank : arms[*atom].countRank) = counts;
+        (upward ? arms[*atom].upNameRank : arms[*atom].nameRank) = names;
+    }
+}
+
+// Arms from the atoms of one level down to the deepest carbons, given the ranks of the
+// level below: most substituents, then the most on the first atom, and so on
+void ParentChainSearch::rankDown(int* first, int* last) {
+    for (int* it = first; it != last; it++) {
+        int atom = *it;
+        ChainArm& arm = arms[atom];
+        arm.next = -1;
+        for (int child : molecule.neighbors(atom)) {
+            if (!deepChild(atom, child)) continue;
+            int best = arm.next;
+            int order = best == -1 ? 1 : arms[child].countRank - arms[best].countRank;
+            if (order == 0) order = compareNames(atom, child, -1, atom, best, -1);
+            if (order == 0) order = arms[child].nameRank - arms[best].nameRank;
+            if (order > 0) arm.next = child;
+        }
+        arm.weight = substituents(atom) + (arm.next >= 0 ? arms[arm.next].weight : 0);
+    }
+
+    auto countCompare = [&](int a, int b) {
+        if (int order = arms[a].weight - arms[b].weight) return order;
+        if (int order = substituents(a) - substituents(b)) return order;
+        return arms[a].next >= 0 ? arms[arms[a].next].countRank - arms[arms[b].next].countRank : 0;
+    };
+    auto nameCompare = [&](int a, int b) {
+        if (int order = compareNames(a, arms[a].next, -1, b, arms[b].next, -1)) return order;
+        return arms[a].next >= 0 ? arms[arms[a].next].nameRank - arms[arms[b].next].nameRank : 0;
+    };
+    rank(first, last, countCompare, nameCompare, false);
+}
+
+// The way from each atom of one level up to its side of the center, given the ranks
+// of the level above. It starts at the parent, so a chain from a deepest carbon reads
+// the carbon itself and then this way.
+void ParentChainSearch::rankUp(int* first, int* last) {
+    // The sides of the center have nothing above them
+    auto above = [&](int atom) { return arms[atom].side == atom ? -1 : up(atom); };
+    for (int* it = first; it != last; it++) {
+        int parent = above(*it);
+        arms[*it].upWeight = parent >= 0 ? arms[parent].upWeight + substituents(parent) : 0;
+    }
+    auto countCompare = [&](int a, int b) {
+        int parentA = above(a), parentB = above(b);
+        if (parentA < 0) return 0;
+        if (int order = substituents(parentA) - substituents(parentB)) return order;
+        return arms[parentA].upCountRank - arms[parentB].upCountRank;
+    };
+    auto nameCompare = [&](int a, int b) {
+        int parentA = above(a), parentB = above(b);
+        if (parentA < 0) return 0;
+        if (int order = compareNames(parentA, a, -1, parentB, b, -1)) return order;
+        return arms[parentA].upNameRank - arms[parentB].upNameRank;
+    };
+    rank(first, last, countCompare, nameCompare, true);
+}
+
+vector<int> ParentChainSearch::find(const vector<int>& coohNodes) {
+    int atomCount = molecule.atomCount();
+    vector<char>& onMainChain = scratch.onMainChain;
+    onMainChain.assign(atomCount, 0);
+
+    // The center: the middle of one longest chain, or the start of the longest chain
+    // from a COOH node, whose other end is free
+    int center[2];
+    int centerSize = 1;
+    if (!coohNodes.empty()) {
+        int longest = -1;
+        for (int coohNode : coohNodes) {
+            int farthest = findFarthestNode(molecule, coohNode, scratch);
+            if (scratch.depth[farthest] > longest) {
+                longest = scratch.depth[farthest];
+                start = coohNode;
+            }
+        }
+        center[0] = start;
+    } else {
+        int any = 0;
+        while (!isChainAtom(molecule.element[any])) any++;
+        int end = findFarthestNode(molecule, findFarthestNode(molecule, any, scratch), scratch);
+        int length = scratch.depth[end] + 1;
+        if (length == 1) return {end};
+        int middle = end;
+        for (int steps = (length - 1) / 2; steps > 0; steps--) middle = scratch.parent[middle];
+        center[0] = middle;
+        if (length % 2 == 0) {
+            center[1] = scratch.parent[middle];
+            centerSize = 2;
+        }
+    }
+    span<const int> centerAtoms(center, centerSize);
+    bool centerAtom = start == -1 && centerSize == 1;  // Arms hang from its neighbours
+
+    for (int atom : centerAtoms) {
+        onMainChain[atom] = 1;
+    }
+    scratch.branchNamer.trim();
+    scratch.armNames.clear();
+    walkBranches(molecule, centerAtoms, scratch, false);
+    if ((int)arms.size() < atomCount) arms.resize(atomCount);
+    for (int atom : centerAtoms) {
+        arms[atom] = {0, 0, atom, 0, -1, 0, 0, 0, 0, 0, -1, 0};
+    }
+    // Depths, and the first two carbons found at the deepest one
+    int deepestFound[2] = {center[0], centerSize == 2 ? center[1] : -1};
+    int deepestCount = centerSize;
+    const vector<int>& order = scratch.branchOrder;
+    for (int atom : order) {
+        int parent = scratch.branchParent[atom];
+        ChainArm& arm = arms[atom];
+        arm.depth = isChainAtom(molecule.element[atom]) && arms[parent].depth >= 0 ? arms[parent].depth + 1 : -1;
+        arm.reach = arm.depth;
+        arm.side = centerAtom && arm.depth == 1 ? atom : arms[parent].side;
+        arm.firstName = -1;
+        if (arm.depth > deepest) {
+            deepest = arm.depth;
+            deepestCount = 0;
+        }
+        if (arm.depth == deepest && deepestCount++ < 2) deepestFound[deepestCount - 1] = atom;
+    }
+    if (start != -1 && deepest == 0) return {start};  // A COOH with no carbons
+
+    // Chains are put together from climbs, a deepest carbon up to its side
+    vector<int> chain;
+    chain.reserve(2 * deepest + 2);
+    auto climb = [&](int atom) {
+        size_t first = chain.size();
+        for (;; atom = up(atom)) {
+            chain.push_back(atom);
+            if (arms[atom].side == atom) break;
+        }
+        return chain.begin() + first;
+    };
+
+    // With one deepest carbon under a COOH, or two otherwise, there is one longest
+    // chain and only its numbering to pick
+    if (deepestCount == (start == -1 ? 2 : 1)) {
+        climb(deepestFound[0]);
+        if (start != -1) {
+            reverse(chain.begin(), chain.end());
+            return chain;
+        }
+        if (centerAtom) chain.push_back(center[0]);
+        auto secondHalf = climb(deepestFound[1]);
+        reverse(secondHalf, chain.end());
+        int ends = compareEnds(chain);
+        if (ends > 0 || (ends == 0 && chain.back() < chain.front())) reverse(chain.begin(), chain.end());
+        return chain;
+    }
+
+    for (size_t i = order.size(); i-- > 0;) {
+        int atom = order[i];
+        int parent = scratch.branchParent[atom];
+        if (arms[atom].depth >= 0) arms[parent].reach = max(arms[parent].reach, arms[atom].reach);
+    }
+
+    // Carbons on a deepest arm, grouped by depth; the center atoms head the arms unless
+    // a single one sits between them
+    vector<int>& levels = scratch.armLevels;
+    vector<int>& levelStart = scratch.levelStart;
+    levelStart.assign(deepest + 2, 0);
+    auto onArm = [&](int atom) { return arms[atom].depth >= (centerAtom ? 1 : 0) && arms[atom].reach == deepest; };
+    for (int atom : centerAtoms) {
+        if (onArm(atom)) levelStart[1]++;
+    }
+    for (int atom : order) {
+        if (onArm(atom)) levelStart[arms[atom].depth + 1]++;
+    }
+    for (int depth = 0; depth <= deepest; depth++) {
+        levelStart[depth + 1] += levelStart[depth];
+    }
+    levels.resize(levelStart[deepest + 1]);
+    for (int atom : centerAtoms) {
+        if (onArm(atom)) levels[levelStart[0]++] = atom;
+    }
+    for (int atom : order) {
+        if (onArm(atom)) levels[levelStart[arms[atom].depth]++] = atom;
+    }
+    for (int depth = deepest; depth > 0; depth--) {
+        levelStart[depth] = levelStart[depth - 1];  // Placing moved every start to the next one
+    }
+    levelStart[0] = 0;
+    auto level = [&](int depth) { return levels.data() + levelStart[depth]; };
+
+    int topLevel = centerAtom ? 1 : 0;
+    for (int depth = deepest; depth >= topLevel; depth--) {
+        rankDown(level(depth), level(depth + 1));
+    }
+
+    // From a COOH node the best arm down is the chain
+    if (start != -1) {
+        for (int atom = start; atom != -1; atom = arms[atom].next) chain.push_back(atom);
+        return chain;
+    }
+
+    // Otherwise the chain starts at a deepest carbon, climbs to its side, crosses the
+    // center and goes down the best arm of another side. First the most substituents:
+    // the two sides with the heaviest arms.
+    for (int depth = topLevel; depth <= deepest; depth++) {
+        rankUp(level(depth), level(depth + 1));
+    }
+    int* sides = level(topLevel);
+    int sideCount = level(topLevel + 1) - sides;
+    int heaviest = 0;
+    for (int i = 0; i < sideCount; i++) {
+        for (int j = i + 1; j < sideCount; j++) {
+            heaviest = max(heaviest, arms[sides[i]].weight + arms[sides[j]].weight);
+        }
+    }
+
+    // The side each chain goes down to, for every side it may start from
+    auto endCompare = [&](int from, int a, int b) {
+        if (int order = arms[a].countRank - arms[b].countRank) return order;
+        if (centerAtom) {
+            if (int order = compareNames(center[0], from, a, center[0], from, b)) return order;
+        }
+        return arms[a].nameRank - arms[b].nameRank;
+    };
+    int ends[4];
+    for (int i = 0; i < sideCount; i++) {
+        ends[i] = -1;
+        for (int j = 0; j < sideCount; j++) {
+            int from = sides[i], side = sides[j];
+            if (side == from || arms[from].weight + arms[side].weight != heaviest) continue;
+            if (ends[i] == -1 || endCompare(from, side, ends[i]) > 0) ends[i] = side;
+        }
+    }
+    auto endOf = [&](int leaf) { return ends[std::find(sides, sides + sideCount, arms[leaf].side) - sides]; };
+
+    // Then the lowest locants and names along the whole chain: the climb, the center and
+    // the way down, counts before names
+    auto chainCompare = [&](int leafA, int leafB) {
+        int endA = endOf(leafA), endB = endOf(leafB);
+        if (int order = substituents(leafA) - substituents(leafB)) return order;
+        if (int order = arms[leafA].upCountRank - arms[leafB].upCountRank) return order;
+        if (int order = arms[endA].countRank - arms[endB].countRank) return order;
+        if (int order = compareNames(leafA, -1, -1, leafB, -1, -1)) return order;
+        if (int order = arms[leafA].upNameRank - arms[leafB].upNameRank) return order;
+        if (centerAtom) {
+            if (int order = compareNames(center[0], arms[leafA].side, endA, center[0], arms[leafB].side, endB)) return order;
+        }
+        return arms[endA].nameRank - arms[endB].nameRank;
+    };
+    int bestLeaf = -1;
+    for (int* it = level(deepest); it != level(deepest + 1); it++) {
+        int leaf = *it;
+        int side = arms[leaf].side;
+        if (endOf(leaf) == -1 || substituents(leaf) + arms[leaf].upWeight != arms[side].weight) continue;
+        if (bestLeaf == -1 || chainCompare(leaf, bestLeaf) > 0) bestLeaf = leaf;
+    }
+
+    climb(bestLeaf);
+    if (centerAtom) chain.push_back(center[0]);
+    for (int atom = endOf(bestLeaf); atom != -1; atom = arms[atom].next) chain.push_back(atom);
+    return chain;
+}
+
+// ----- Small molecules -----
+// Up to 64 or 128 atoms the skeleton fits in one bitmask per atom, held inline. Breadth-
+// first levels are then unions of adjacency rows, and an atom's parent is the one bit
+// its row shares with the level above, so finding the center and a single longest
+// chain touches no heap. Anything that needs the arm ranks or branch names (several
+// longest chains, or ends whose substituent counts mirror each other with anything but
+// halogens on them) goes to ParentChainSearch, which gives the same answer for
+// everything handled here.
+
+using Mask128 = unsigned __int128;
+
+static int lowestBit(uint64_t mask) { return countr_zero(mask); }
+static int lowestBit(Mask128 mask) {
+    uint64_t low = (uint64_t)mask;
+    return low ? countr_zero(low) : 64 + countr_zero((uint64_t)(mask >> 64));
+}
+static int bitCount(uint64_t mask) { return popcount(mask); }
+static int bitCount(Mask128 mask) { return popcount((uint64_t)mask) + popcount((uint64_t)(mask >> 64)); }
+
+template <class Mask>
+class SmallTree {
+public:
+    static constexpr int capacity = sizeof(Mask) * 8;
+
+    explicit SmallTree(const MolecularGraph& molecule) : atomCount(molecule.atomCount()) {
+        for (int atom = 0; atom < atomCount; atom++) {
+            Mask row = 0;
+            for (int neighbor : molecule.neighbors(atom)) row |= bit(neighbor);
+            rows[atom] = row;
+            if (isChainAtom(molecule.element[atom])) chainAtoms |= bit(atom);
+            if (int halogen = halogenType(molecule.element[atom])) {
+                halogens |= bit(atom);
+                halogenOrder[atom] = alphabeticalHalogen[halogen];
+            }
+        }
+    }
+
+    // Chain atoms by distance from the sources, levels[0] being the sources; returns
+    // the index of the last level
+    int spread(Mask sources) {
+        int last = 0;
+        Mask seen = levels[0] = sources;
+        while (true) {
+            Mask next = 0;
+            for (Mask frontier = levels[last]; frontier; frontier &= frontier - 1) next |= rows[lowestBit(frontier)];
+            next &= chainAtoms & ~seen;
+            if (!next) return last;
+            seen |= next;
+            levels[++last] = next;
+        }
+    }
+
+    // The neighbour of atom (at level depth of the last spread) one level closer
+    int above(int atom, int depth) const { return lowestBit(rows[atom] & levels[depth - 1]); }
+
+    int degree(int atom) const { return bitCount(rows[atom]); }
+
+    bool find(const vector<int>& coohNodes, vector<int>& chain, uint64_t& visited);
+
+private:
+    static Mask bit(int atom) { return Mask(1) << atom; }
+
+    // Bromo, chloro, fluoro, iodo, indexed by halogenType
+    static constexpr uint8_t alphabeticalHalogen[5] = {0, 1, 0, 2, 3};
+
+    int compareHalogens(int a, int b, Mask onChain) const;
+
+    int atomCount;
+    Mask chainAtoms = 0;
+    Mask halogens = 0;
+    uint8_t halogenOrder[capacity];
+    Mask rows[capacity];
+    Mask levels[capacity];
+};
+
+// Fills chain and returns true when the molecule has a single longest chain whose
+// numbering the substituent counts settle
+template <class Mask>
+bool SmallTree<Mask>::find(const vector<int>& coohNodes, vector<int>& chain, uint64_t& visited) {
+    if (!coohNodes.empty()) {
+        int start = -1, longest = -1;
+        for (int coohNode : coohNodes) {
+            int depth = spread(bit(coohNode));
+            if (depth > longest) {
+                longest = depth;
+                start = coohNode;
+            }
+        }
+        int deepest = spread(bit(start));
+        visited += atomCount * (coohNodes.size() + 1);
+        if (bitCount(levels[deepest]) != 1) return false;
+        chain.resize(deepest + 1);
+        for (int atom = lowestBit(levels[deepest]), depth = deepest; depth >= 0; atom = depth ? above(atom, depth) : -1, depth--) {
+            chain[depth] = atom;
+        }
+        return true;
+    }
+
+    // The center: the middle atom or bond of a longest chain
+    int end = lowestBit(levels[spread(bit(lowestBit(chainAtoms)))]);
+    int length = spread(bit(end)) + 1;
+    int middle = lowestBit(levels[length - 1]);
+    int depth = length - 1;
+    for (int steps = (length - 1) / 2; steps > 0; steps--, depth--) middle = above(middle, depth);
+    Mask center = bit(middle);
+    if (length % 2 == 0) center |= bit(above(middle, depth));
+    bool centerAtom = length % 2 == 1;
+
+    int deepest = spread(center);
+    visited += atomCount * 3;
+    if (length == 1) {
+        chain.assign(1, middle);
+        return true;
+    }
+    if (bitCount(levels[deepest]) != 2) return false;
+
+    // Climb from each deepest carbon to the center, the second one read back down
+    chain.resize(length);
+    Mask ends = levels[deepest];
+    int atom = lowestBit(ends);
+    for (int i = 0, depth = deepest; depth >= 0; i++, depth--) {
+        chain[i] = atom;
+        if (depth) atom = above(atom, depth);
+    }
+    atom = lowestBit(ends & (ends - 1));
+    for (int i = length - 1, depth = deepest; depth >= (centerAtom ? 1 : 0); i--, depth--) {
+        chain[i] = atom;
+        if (depth) atom = above(atom, depth);
+    }
+
+    // Substituents on the first atom where the two numberings differ; mirrored counts
+    // leave it to the names unless there are no substituents at all
+    auto substituents = [&](int i) { return degree(chain[i]) - (i == 0 || i == length - 1 ? 1 : 2); };
+    int order = 0;
+    bool substituted = false;
+    for (int i = 0; i < length && order == 0; i++) {
+        order = substituents(length - 1 - i) - substituents(i);
+        substituted |= substituents(i) != 0;
+    }
+    if (order == 0 && substituted) {
+        Mask onChain = 0;
+        for (int atom : chain) onChain |= bit(atom);
+        for (int atom : chain) {
+            if (rows[atom] & ~onChain & ~halogens) return false;
+        }
+        for (int i = 0; i < length && order == 0; i++) order = compareHalogens(chain[length - 1 - i], chain[i], onChain);
+    }
+    if (order > 0 || (order == 0 && chain.back() < chain.front())) reverse(chain.begin(), chain.end());
+    return true;
+}
+
+// > 0 when the halogens on a come first alphabetically at the first point of difference
+// from those on b; both carry the same number of them
+template <class Mask>
+int SmallTree<Mask>::compareHalogens(int a, int b, Mask onChain) const {
+    uint8_t namesA[4], namesB[4];
+    int count = 0;
+    for (Mask on = rows[a] & ~onChain; on; on &= on - 1) namesA[count++] = halogenOrder[lowestBit(on)];
+    count = 0;
+    for (Mask on = rows[b] & ~onChain; on; on &= on - 1) namesB[count++] = halogenOrder[lowestBit(on)];
+    sort(namesA, namesA + count);
+    sort(namesB, namesB + count);
+    for (int i = 0; i < count; i++) {
+        if (namesA[i] != namesB[i]) return namesA[i] < namesB[i] ? 1 : -1;
+    }
+    return 0;
+}
+
+vector<int> findParentChain(const MolecularGraph& molecule, const vector<int>& coohNodes, NamerScratch& scratch) {
+    vector<int> chain;
+    int atomCount = molecule.atomCount();
+    if (atomCount <= SmallTree<uint64_t>::capacity) {
+        if (SmallTree<uint64_t>(molecule).find(coohNodes, chain, scratch.counters.nodesVisited)) return chain;
+    } else if (atomCount <= SmallTree<Mask128>::capacity) {
+        if (SmallTree<Mask128>(molecule).find(coohNodes, chain, scratch.counters.nodesVisited)) return chain;
+    }
+    return ParentChainSearch(molecule, scratch).find(coohNodes);
+}
+
+// Helper function to detect if an atom is a COOH group
+bool isCOOHGroup(const MolecularGraph& molecule, int atom) {
+    return molecule.element[atom] == Element::COOH;
+}
+
+// Lowest locants for the substituents, then alphabetical order of the names at the
+// first point of difference; order and best list the same atoms, both analysed
+static bool betterNumbering(const vector<int>& order, const vector<int>& best, const NamerScratch& scratch) {
+    if (best.empty()) return true;
+    const vector<int>& branchCount = scratch.branchCount;
+    for (size_t i = 0; i < order.size(); i++) {
+        int here = branchCount[order[i]];
+        int there = branchCount[best[i]];
+        if (here != there) return here > there;
+    }
+    for (size_t i = 0; i < order.size(); i++) {
+        const BranchInfo* a = scratch.branches.data() + scratch.firstBranch[order[i]];
+        const BranchInfo* b = scratch.branches.data() + scratch.firstBranch[best[i]];
+        for (int k = 0; k < branchCount[order[i]]; k++) {
+            if (a[k].name != b[k].name) return alphabeticallyBefore(a[k].name, b[k].name);
+        }
+    }
+    return false;
+}
+
+NamingResult nameMonocycle(const MolecularGraph& molecule, const vector<int>& ring, int hint,
+                           NamerScratch& scratch, ostream* trace) {
+    NamingResult result;
+    int atomCount = molecule.atomCount();
+    for (int atom : ring) {
+        if (molecule.element[atom] != Element::C) {
+            result.error = "heterocyclic rings are not supported";
+            return result;
+        }
+    }
+
+    vector<char>& onMainChain = scratch.onMainChain;
+    onMainChain.assign(atomCount, 0);
+    for (int atom : ring) {
+        onMainChain[atom] = 1;
+    }
+
+    // A COOH straight on the ring stays out of the substituents and fixes locant 1
+    int acidAtom = -1;
+    int ringAcids = 0;
+    StageTimer branchTimer(scratch.counters, Stage::BranchCount);
+    for (int atom : ring) {
+        for (int neighbor : molecule.neighbors(atom)) {
+            if (!onMainChain[neighbor] && isCOOHGroup(molecule, neighbor)) {
+                acidAtom = atom;
+                ringAcids++;
+            }
+        }
+    }
+    analyzeBranches(molecule, ring, scratch, true, trace);
+    branchTimer.stop();
+
+    int acids = 0;
+    for (int atom = 0; atom < atomCount; atom++) {
+        if (isCOOHGroup(molecule, atom)) acids++;
+    }
+    if (acids > ringAcids) {
+        result.error = "carboxylic acids on a ring side chain are not supported";
+        return result;
+    }
+    if (ringAcids > 1) {
+        result.error = "rings with more than one carboxylic acid group are not supported";
+        return result;
+    }
+
+    StageTimer nameTimer(scratch.counters, Stage::NameAssembly);
+
+    // Locant 1 goes to the COOH carbon, or the atom bonded to the ether oxygen;
+    // otherwise any substituted atom may start the numbering
+    int n = ring.size();
+    int fixedStart = acidAtom;
+    int attachment = hint == 1 ? molecule.openValenceAtom() : -1;
+    if (fixedStart == -1 && attachment != -1 && onMainChain[attachment]) fixedStart = attachment;
+
+    vector<int> best, order(n);
+    for (int start = 0; start < n; start++) {
+        if (fixedStart != -1 ? ring[start] != fixedStart : scratch.branchCount[ring[start]] == 0 && start != 0) continue;
+        for (int step : {1, n - 1}) {
+            for (int i = 0; i < n; i++) {
+                order[i] = ring[(start + (size_t)i * step) % n];
+            }
+            if (betterNumbering(order, best, scratch)) best = order;
+        }
+    }
+
+    // generateIUPACName gives e.g. "1-methyl Hexane"; the ring turns the root into "Cyclohexane"
+    pmr::vector<ChainSubstituent> substituents = substituentsAlong(best, scratch);
+    result.substituents.reserve(substituents.size());
+    for (const ChainSubstituent& substituent : substituents) {
+        result.substituents.push_back({substituent.locant, string(substituent.name)});
+    }
+    string iupacName = generateIUPACName(move(substituents), n, hint == 1 ? 2 : 0);
+    size_t root = iupacName.rfind(' ') == string::npos ? 0 : iupacName.rfind(' ') + 1;
+    iupacName[root] = tolower((unsigned char)iupacName[root]);
+    iupacName.insert(root, "Cyclo");
+    if (acidAtom != -1 && hint != 1) {
+        iupacName += "carboxylic acid";
+    }
+
+    if (trace) *trace << "IUPAC Name: " << iupacName << endl;
+
+    result.name = move(iupacName);
+    result.chain = move(best);
+    return result;
+}
+
+NamingResult processMolecularGraph(MolecularGraph& graph1, int hint, NamerScratch& scratch, const NamerOptions& options, ostream* trace) {
+    scratch.arena.reset();
+    NamingResult result;
+    if (trace) graph1.printAtomsInfo(*trace);
+    if (trace) graph1.printEdges(*trace);
+
+    // Names only cover one acid group; a second would be silently dropped
+    if (count(graph1.element.begin(), graph1.element.end(), Element::COOH) > 1) {
+        result.error = "more than one COOH group is not supported";
+        if (trace) *trace << result.error << "\n";
+        return result;
+    }
+
+    MoleculeCounters& counters = scratch.counters;
+    StageTimer ringTimer(counters, Stage::RingCheck);
+    if (countRings(graph1, scratch.ringSets) > 0) {
+        RingInfo rings = perceiveRings(graph1);
+        ringTimer.stop();
+        if (trace) {
+            *trace << "Rings: " << rings.ringCount << endl;
+            for (const vector<int>& ring : rings.rings) {
+                for (int atom : ring) *trace << graph1.atomLabel(atom) << " ";
+                *trace << endl;
+            }
+        }
+        if (rings.ringCount == 1) {
+            return nameMonocycle(graph1, rings.rings[0], hint, scratch, trace);
+        }
+
+        result.error = "polycyclic structures are not supported (" + to_string(rings.ringCount) + " rings";
+        if (rings.complete && rings.ringCount <= 8) {
+            result.error += " of sizes ";
+            for (size_t i = 0; i < rings.rings.size(); i++) {
+                result.error += (i ? "," : "") + to_string(rings.rings[i].size());
+            }
+        }
+        result.error += ")";
+        return result;
+    }
+    ringTimer.stop();
+
+    StageTimer chainTimer(counters, Stage::ChainSearch);
+    int counter = 0;
+    int atomCount = graph1.atomCount();
+
+    vector<int>& coohNodes = scratch.coohNodes;  // COOH atom ids
+    vector<int>& carbonNodes = scratch.carbonNodes;
+    coohNodes.clear();
+    carbonNodes.clear();
+    for (int atom = 0; atom < atomCount; atom++) {
+        if (isCOOHGroup(graph1, atom)) {
+            coohNodes.push_back(atom);
+        }
+        if (isChainAtom(graph1.element[atom])) {
+            carbonNodes.push_back(atom);
+        }
+    }
+
+    if (carbonNodes.empty()) {
+        result.error = "No carbon atoms found in the input.";
+        if (trace) *trace << result.error << "\n";
+        return result;
+    }
+
+   // Step 1: The parent chain, starting from the COOH group if there is one
+    vector<int> optimalChain;
+    if (!coohNodes.empty()) counter = 1;
+    if (!options.referenceChains) {
+        optimalChain = findParentChain(graph1, coohNodes, scratch);
+    } else if (!coohNodes.empty()) {
+        optimalChain = findLongestChainWithCOOHReference(graph1, coohNodes);
+    } else {
+        optimalChain = findLongestCarbonChainReference(graph1, carbonNodes[0]);
+    }
+    if(hint == 1) counter = 2;
+    chainTimer.stop();
+
+    // Step 3: Store branch information
+    StageTimer branchTimer(counters, Stage::BranchCount);
+    vector<char>& onMainChain = scratch.onMainChain;
+    onMainChain.assign(atomCount, 0);
+    for (int atom : optimalChain) {
+        onMainChain[atom] = 1;
+    }
+    analyzeBranches(graph1, optimalChain, scratch, false, trace);
+
+    // The reference search keeps the first longest chain it meets and only numbers it
+    if (options.referenceChains && coohNodes.empty()) {
+        vector<int> reversed(optimalChain.rbegin(), optimalChain.rend());
+        if (betterNumbering(reversed, optimalChain, scratch)) optimalChain = move(reversed);
+    }
+    branchTimer.stop();
+
+    // Print the parent chain using node labels
+    if (trace) {
+        *trace << "Longest carbon chain: ";
+        for (int node : optimalChain) {
+            *trace << graph1.atomLabel(node) << " ";
+        }
+        *trace << endl;
+    }
+
+    // Step 4: Generate IUPAC name with '-oic acid' if COOH is present
+    StageTimer nameTimer(counters, Stage::NameAssembly);
+    pmr::vector<ChainSubstituent> substituents = substituentsAlong(optimalChain, scratch);
+    result.substituents.reserve(substituents.size());
+    for (const ChainSubstituent& substituent : substituents) {
+        result.substituents.push_back({substituent.locant, string(substituent.name)});
+    }
+    string iupacName = generateIUPACName(move(substituents), optimalChain.size(), counter);
+    if (!coohNodes.empty()) {
+        iupacName += "oic acid";
+    }
+
+    if (trace) *trace << "IUPAC Name: " << iupacName << endl;
+
+    result.name = move(iupacName);
+    result.chain = move(optimalChain);
+    return result;
+}
+
+// -------------------- Results --------------------
+
+void appendJsonString(string& out, string_view text) {
+    out += '"';
+    for (char ch : text) {
+        switch (ch) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if ((unsigned char)ch < 0x20) {
+                    char escaped[8];
+                    snprintf(escaped, sizeof(escaped), "\\u%04x", ch);
+                    out += escaped;
+                } else {
+                    out += ch;
+                }
+        }
+    }
+    out += '"';
+}
+
+void appendJson(string& out, const NamingResult& result) {
+    out += "{\"name\":";
+    appendJsonString(out, result.name);
+
+    out += ",\"chain\":[";
+    for (size_t i = 0; i < result.chain.size(); i++) {
+        if (i) out += ',';
+        out += to_string(result.chain[i] + 1);
+    }
+
+    out += "],\"substituents\":[";
+    for (size_t i = 0; i < result.substituents.size(); i++) {
+        if (i) out += ',';
+        out += "{\"locant\":" + to_string(result.substituents[i].locant) + ",\"name\":";
+        appendJsonString(out, result.substituents[i].name);
+        out += '}';
+    }
+    out += ']';
+
+    if (!result.groups.empty()) {
+        out += ",\"groups\":[";
+        for (size_t i = 0; i < result.groups.size(); i++) {
+            if (i) out += ',';
+            appendJson(out, result.groups[i]);
+        }
+        out += ']';
+    }
+
+    out += ",\"error\":";
+    if (result.error.empty()) {
+        out += "null";
+    } else {
+        appendJsonString(out, result.error);
+        if (result.errorOffset >= 0) {
+            out += ",\"error_offset\":" + to_string(result.errorOffset);
+        }
+    }
+    out += '}';
+}
+
+// Cached entries hold "name|chain as canonical ranks|locant:substituent;..." so a hit
+// can rebuild the full result for whichever notation of the molecule was submitted
+static string encodeCachedResult(const NamingResult& result, const vector<int>& rank) {
+    string entry = result.name + "|";
+    for (size_t i = 0; i < result.chain.size(); i++) {
+        if (i) entry += ',';
+        entry += to_string(rank[result.chain[i]]);
+    }
+    entry += '|';
+    for (size_t i = 0; i < result.substituents.size(); i++) {
+        if (i) entry += ';';
+        entry += to_string(result.substituents[i].locant) + ":" + result.substituents[i].name;
+    }
+    return entry;
+}
+
+static int parseInt(string_view text) {
+    int value = 0;
+    from_chars(text.data(), text.data() + text.size(), value);
+    return value;
+}
+
+static NamingResult decodeCachedResult(const string& entry, const vector<int>& rank, pmr::memory_resource* memory) {
+    NamingResult result;
+    size_t nameEnd = entry.find('|');
+    result.name = entry.substr(0, nameEnd);
+    if (nameEnd == string::npos) return result;  // Older caches stored the name alone
+
+    pmr::vector<int> atomAt(rank.size(), memory);
+    for (size_t atom = 0; atom < rank.size(); atom++) {
+        atomAt[rank[atom]] = atom;
+    }
+
+    size_t chainEnd = entry.find('|', nameEnd + 1);
+    string_view chain = string_view(entry).substr(nameEnd + 1, chainEnd - nameEnd - 1);
+    while (!chain.empty()) {
+        size_t comma = chain.find(',');
+        result.chain.push_back(atomAt[parseInt(chain.substr(0, comma))]);
+        chain = comma == string_view::npos ? string_view() : chain.substr(comma + 1);
+    }
+
+    string_view substituents = chainEnd == string::npos ? string_view() : string_view(entry).substr(chainEnd + 1);
+    while (!substituents.empty()) {
+        size_t semicolon = substituents.find(';');
+        string_view item = substituents.substr(0, semicolon);
+        size_t colon = item.find(':');
+        result.substituents.push_back({parseInt(item.substr(0, colon)), string(item.substr(colon + 1))});
+        substituents = semicolon == string_view::npos ? string_view() : substituents.substr(semicolon + 1);
+    }
+    return result;
+}
+
+// -------------------- Namer --------------------
+
+Namer::Namer(NamerOptions options) : options(options) {
+    if (options.cacheCapacity > 0) {
+        string version = "rules " + to_string(namingRulesVersion);
+        if (options.referenceChains) version += " reference-chains";
+        cache = make_unique<NameCache>(options.cacheCapacity, version);
+    }
+    if (options.metrics) {
+        metrics = make_unique<PipelineMetrics>();
+    }
+}
+
+NamingResult Namer::nameMolecule(MolecularGraph& molecule, int hint, NamerScratch& scratch, ostream* trace) const {
+    if (!cache || molecule.atomCount() > options.cacheMaxAtoms) {
+        return processMolecularGraph(molecule, hint, scratch, options, trace);
+    }
+
+    StageTimer lookupTimer(scratch.counters, Stage::CacheLookup);
+    scratch.arena.reset();
+    CanonicalForm form = canonicalize(molecule, &scratch.arena);
+    form.code.push_back((char)hint);  // Alkyl (ether) names differ from the parent names
+    if (hint == 1) {
+        // A ring half is numbered from the carbon bonded to the O, so that atom is
+        // part of the key
+        int attachment = form.rank[molecule.openValenceAtom()];
+        form.code.append((const char*)&attachment, sizeof(attachment));
+    }
+    uint64_t key = fnv1a(form.code);
+
+    string entry;
+    if (cache->lookup(key, form.code, entry)) {
+        NamingResult cached = decodeCachedResult(entry, form.rank, &scratch.arena);
+        scratch.counters.cacheHits++;
+        if (trace) *trace << "IUPAC Name: " << cached.name << " (cached)" << endl;
+        return cached;
+    }
+    scratch.counters.cacheMisses++;
+    lookupTimer.stop();
+
+    NamingResult result = processMolecularGraph(molecule, hint, scratch, options, trace);
+    if (result.error.empty()) {
+        cache->insert(key, form.code, encodeCachedResult(result, form.rank));
+    }
+    return result;
+}
+
+// Parses one formula (or ether half), or a SMILES, into molecule; base is where it
+// starts in the text the caller submitted, so reported offsets point into that text
+static bool parseInto(MolecularGraph& molecule, string_view formula, bool smiles, size_t base, NamingResult& result,
+                      MoleculeCounters& counters) {
+    StageTimer parseTimer(counters, Stage::Parse);
+    ParseError error = smiles ? molecule.parseSmiles(formula, false) : molecule.parseMolecularFormula(formula, false);
+    parseTimer.stop();
+    if (error) {
+        result.error = error.message;
+        result.errorOffset = base + error.offset;
+        return false;
+    }
+
+    StageTimer buildTimer(counters, Stage::GraphBuild);
+    molecule.finalize();
+    counters.atoms += molecule.atomCount();
+    counters.bonds += molecule.edges.size();
+    return true;
+}
+
+template <typename Body>
+NamingResult Namer::measured(string_view label, NamerScratch& scratch, Body&& body) const {
+    if (!metrics) return body();
+
+    MoleculeCounters& counters = scratch.counters;
+    counters = MoleculeCounters();
+    counters.enabled = true;
+    uint64_t allocationsBefore = threadAllocations;
+    uint64_t bytesBefore = threadAllocatedBytes;
+    uint64_t arenaAllocationsBefore = scratch.arena.allocations();
+    uint64_t arenaBytesBefore = scratch.arena.bytes();
+    auto start = chrono::steady_clock::now();
+
+    NamingResult result = body();
+
+    uint64_t nanos = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+    counters.allocations = threadAllocations - allocationsBefore;
+    counters.allocatedBytes = threadAllocatedBytes - bytesBefore;
+    counters.arenaAllocations = scratch.arena.allocations() - arenaAllocationsBefore;
+    counters.arenaBytes = scratch.arena.bytes() - arenaBytesBefore;
+    counters.enabled = false;
+    metrics->record(counters, label, nanos, !result.error.empty());
+    return result;
+}
+
+NamingResult Namer::name(string_view formula, NamerScratch& scratch, ostream* trace) const {
+    return measured(formula, scratch, [&] { return nameFormula(formula, scratch, trace); });
+}
+
+NamingResult Namer::nameGraph(string_view label, NamerScratch& scratch, ostream* trace) const {
+    return measured(label, scratch, [&] {
+        scratch.counters.atoms += scratch.wholeGraph.atomCount();
+        scratch.counters.bonds += scratch.wholeGraph.edges.size();
+        return nameWholeGraph(scratch, trace);
+    });
+}
+
+NamingResult Namer::nameFormula(string_view formula, NamerScratch& scratch, ostream* trace) const {
+    size_t base = 0;
+    while (base < formula.size() && isspace((unsigned char)formula[base])) base++;
+    size_t end = formula.size();
+    while (end > base && isspace((unsigned char)formula[end - 1])) end--;
+    formula = formula.substr(base, end - base);
+
+    NamingResult result;
+    if (options.smiles) {
+        if (!parseInto(scratch.wholeGraph, formula, true, base, result, scratch.counters)) return result;
+        return nameWholeGraph(scratch, trace);
+    }
+
+    size_t pos = findEtherLink(formula);
+    if (pos != string_view::npos) {
+        string_view f1 = formula.substr(0, pos);
+        string_view f2 = formula.substr(pos + 3);
+
+        if (trace) *trace << f1 << " " << f2 << endl;
+
+        // Each half is named as an alkyl group
+        if (!parseInto(scratch.molecule, f1, false, base, result, scratch.counters)) return result;
+        if (!parseInto(scratch.etherHalf, f2, false, base + pos + 3, result, scratch.counters)) return result;
+        return nameEther(scratch, trace);
+    }
+
+    if (!parseInto(scratch.molecule, formula, false, base, result, scratch.counters)) return result;
+    return nameMolecule(scratch.molecule, 0, scratch, trace);
+}
+
+NamingResult Namer::nameWholeGraph(NamerScratch& scratch, ostream* trace) const {
+    if (scratch.wholeGraph.splitEther(scratch.molecule, scratch.etherHalf)) return nameEther(scratch, trace);
+    return nameMolecule(scratch.wholeGraph, 0, scratch, trace);
+}
+
+NamingResult Namer::nameEther(NamerScratch& scratch, ostream* trace) const {
+    NamingResult group1 = nameMolecule(scratch.molecule, 1, scratch, trace);
+    NamingResult group2 = nameMolecule(scratch.etherHalf, 1, scratch, trace);
+
+    // Ensure the smaller group name comes first
+    if (group1.name > group2.name) {
+        swap(group1, group2);
+    }
+
+    NamingResult result;
+    result.name.reserve(group1.name.size() + group2.name.size() + 7);
+    result.name.append(group1.name).append(" ").append(group2.name).append(" ether");
+    result.error = !group1.error.empty() ? group1.error : group2.error;
+    result.groups.reserve(2);
+    result.groups.push_back(move(group1));
+    result.groups.push_back(move(group2));
+    if (trace) *trace << "IUPAC NAME: " << result.name << endl;
+    return result;
+}
+
+string Namer::name(string_view formula) const {
+    NamerScratch scratch;
+    return name(formula, scratch, nullptr).name;
+}
+
+vector<NamingResult> Namer::nameBatch(span<const string_view> formulas) {
+    lock_guard<mutex> lock(poolLock);
+    if (!pool) {
+        pool = make_unique<WorkStealingPool>(options.threads);
+        workerScratch.resize(pool->size());
+    }
+
+    vector<NamingResult> results(formulas.size());
+    pool->parallelFor(formulas.size(), 64, [&](size_t index, unsigned worker) {
+        try {
+            results[index] = name(formulas[index], workerScratch[worker], nullptr);
+        } catch (const exception& e) {
+            results[index].error = e.what();
+        }
+    });
+    return results;
+}
@@ -0,0 +1,317 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <span>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "arena.h"
+#include "metrics.h"
+#include "molecule.h"
+#include "name_cache.h"
+#include "thread_pool.h"
+
+// One substituent of the parent chain or ring: the branch starting at root, which is
+// bonded to atom. name stays valid until the BranchNamer that gave it is trimmed.
+struct BranchInfo {
+    int atom;
+    int root;
+    int numCarbons;
+    int halogenType;  // Lowest halogen type in the branch, 0 for none
+    std::string_view name;
+};
+
+// A carbon seen from the center of the longest chains (see findParentChain). Arms run
+// from a side of the center down to a deepest carbon; ranks order the arms, or the way
+// up from here, against the others on the same level, higher being better.
+struct ChainArm {
+    int depth;        // Bonds from the center, -1 off the carbon tree
+    int reach;        // Depth of the deepest carbon below
+    int side;         // Atom of the center's side it hangs from
+    int weight;       // Substituents on the best arm down from here
+    int next;         // Where that arm goes on, -1 at its end
+    int countRank;    // That arm by substituent counts alone
+    int nameRank;     // ... then by names
+    int upWeight;     // Substituents on the way up from the parent
+    int upCountRank;  // That way by counts
+    int upNameRank;   // ... then by names
+    int firstName;    // Its branches in NamerScratch::armNames, -1 until named
+    int nameCount;
+};
+
+// One branch at its locant, as the name builder takes them
+struct ChainSubstituent {
+    int locant;
+    std::string_view name;
+};
+
+// Names substituent branches. All-carbon branches are interned bottom-up by skeleton
+// ("shape": a carbon plus the shapes of the carbons below it), so every distinct
+// skeleton is analysed and named once: "methyl", "isopropyl", "sec-butyl",
+// "tert-butyl", "(2-methylpropyl)", "(1-ethyl-2-methylbutyl)". Branches holding other
+// atoms keep the legacy form ("chloro", "chloro-ethyl"). Lives in NamerScratch, so the
+// memo carries over from one molecule to the next.
+class BranchNamer {
+public:
+    // Shape of a carbon whose branches away from the chain have the given shapes (at
+    // most three, any order); -1 once the memo cannot take more shapes
+    int intern(const int* children, int count);
+
+    // "propyl", "isopropyl", "(2-methylpropyl)"...
+    std::string_view shapeName(int shape);
+
+    // Legacy name from the carbon count and halogen type, as appendBranchName writes it
+    std::string_view legacyName(int numCarbons, int halogenType);
+
+    // Drops the memo once it has grown large; call between molecules, since shapes and
+    // names handed out before are invalid afterwards
+    void trim();
+
+    // Bumped by every trim() that drops the memo
+    unsigned generation() const { return trims; }
+
+private:
+    struct Shape {
+        std::array<int, 3> children;  // Sorted, unused slots -1
+        int childCount;
+        int height;        // Bonds on the longest way down
+        int next;          // Child the substituent's own chain continues into, -1 at its end
+        int substituents;  // Branches off that chain, counted from this carbon down
+        bool straight;
+        int name;          // Index into names, -1 until asked for
+    };
+
+    // Open-addressed table from packed child shapes to shape; shape -1 marks a free slot
+    struct Slot {
+        uint64_t key;
+        int shape = -1;
+    };
+
+    bool betterContinuation(const Shape& parent, int a, int b);
+    void siblingNames(const Shape& shape, int skip, std::vector<std::string_view>& out);
+    void growSlots();
+
+    std::vector<Shape> shapes;
+    std::vector<Slot> slots;
+    std::unordered_map<int, int> legacyNames;     // numCarbons * 8 + halogenType -> name
+    std::deque<std::string> names;                // Deque, so views stay put as it grows
+    std::vector<std::tuple<std::string_view, std::string_view, int>> entries;  // shapeName's (key, name, locant)
+    unsigned trims = 0;
+};
+
+// One substituent in the final name, e.g. {2, "methyl"}
+struct Substituent {
+    int locant;
+    std::string name;
+};
+
+// Everything a caller may want from naming one formula. chain holds atom ids in
+// numbering order; ethers report their two alkyl groups in groups.
+struct NamingResult {
+    std::string name;
+    std::vector<int> chain;
+    std::vector<Substituent> substituents;
+    std::vector<NamingResult> groups;
+    std::string error;       // Empty on success
+    long errorOffset = -1;   // Byte in the submitted formula for parse errors, else -1
+};
+
+// Appends result as one compact JSON object (atom ids are written 1-based)
+void appendJson(std::string& out, const NamingResult& result);
+
+// Appends text as a quoted JSON string
+void appendJsonString(std::string& out, std::string_view text);
+
+// Bumped whenever a change to the naming rules changes any name, so name cache files
+// saved before it are not loaded
+constexpr int namingRulesVersion = 1;
+
+struct NamerOptions {
+    bool referenceChains = false;  // Use the exhaustive chain search (differential runs)
+    unsigned threads = 0;          // Batch workers; 0 means one per hardware thread
+    size_t cacheCapacity = 0;      // Names kept in the canonical-form cache; 0 disables it
+    int cacheMaxAtoms = 256;       // Larger molecules skip canonicalization and the cache
+    bool metrics = false;          // Keep per-stage counters and latency histograms
+    bool smiles = false;           // Input is SMILES instead of condensed formulas
+};
+
+// Working memory for naming one molecule at a time. Each thread keeps its own, so the
+// buffers grow to the largest molecule seen and are then reused without reallocating.
+struct NamerScratch {
+    MolecularGraph molecule;
+    MolecularGraph etherHalf;
+    MolecularGraph wholeGraph;  // A SMILES or stored molecule, before an ether is split into the two above
+
+    // Chain walks
+    std::vector<int> parent;
+    std::vector<int> depth;
+    std::vector<int> toVisit;
+
+    // Ring detection (union-find sets)
+    std::vector<int> ringSets;
+
+    std::vector<char> onMainChain;
+
+    // Substituents of the chain or ring: branches lists them grouped by the atom they
+    // hang from, and per atom branchCount and firstBranch index into it
+    std::vector<BranchInfo> branches;
+    std::vector<int> branchCount;
+    std::vector<int> firstBranch;
+    BranchNamer branchNamer;
+
+    // Branch analysis, per atom: parent towards the chain, carbons and lowest halogen
+    // below, its own shape (-1 when not all carbon) and the shapes of the carbons below
+    // it (shapeCount -1 when one of them is not all carbon)
+    std::vector<int> branchParent;
+    std::vector<int> branchOrder;
+    std::vector<int> branchCarbons;
+    std::vector<int> branchHalogen;
+    std::vector<int> branchShape;
+    std::vector<int> shapeCount;
+    std::vector<std::array<int, 3>> childShapes;
+
+    // Parent chain search: per atom, and the deepest arms grouped by level
+    std::vector<ChainArm> chainArms;
+    std::vector<std::pair<std::string_view, int>> armNames;
+    std::vector<int> armLevels;
+    std::vector<int> levelStart;
+
+    std::vector<int> coohNodes;
+    std::vector<int> carbonNodes;
+
+    // Temporaries of one molecule (canonical ranking, substituent lists, name groups),
+    // reset before each molecule or ether half is canonicalized or named. Results never
+    // point into it.
+    MoleculeArena arena;
+
+    // Work done on the current formula, for PipelineMetrics
+    MoleculeCounters counters;
+};
+
+// -------------------- Pipeline Stages --------------------
+
+// Reference longest-chain search: exhaustive backtracking over every simple path
+std::pair<int, std::vector<int>> dfsWithConditions(const MolecularGraph& molecule, int node, std::vector<char>& visited);
+std::vector<int> findLongestCarbonChainReference(const MolecularGraph& molecule, int startNode);
+std::vector<int> findLongestChainWithCOOHReference(const MolecularGraph& molecule, const std::vector<int>& coohNodes);
+
+// Linear-time chain engine
+int findFarthestNode(const MolecularGraph& molecule, int startNode, NamerScratch& scratch);
+std::vector<int> tracePath(int endNode, const std::vector<int>& parent);
+std::vector<int> findLongestCarbonChain(const MolecularGraph& molecule, int startNode, NamerScratch& scratch);
+std::vector<int> findLongestChainWithCOOH(const MolecularGraph& molecule, const std::vector<int>& coohNodes, NamerScratch& scratch);
+
+// The parent chain, numbered: of all longest carbon chains, the one with the most
+// substituents, then the lowest locants, then names earliest in alphabetical order at
+// the first point of difference, numbered from the end those rules prefer. With COOH
+// nodes the chain starts at the one with the longest chain. Ties are settled by ranking
+// the arms around the center of the skeleton, never by listing the chains, so
+// symmetric skeletons with exponentially many longest chains stay near linear.
+std::vector<int> findParentChain(const MolecularGraph& molecule, const std::vector<int>& coohNodes, NamerScratch& scratch);
+
+// Finds and names every substituent of the atoms in chain, which onMainChain marks, in
+// one walk over the forest hanging off it: carbons, halogens and shapes are summed
+// bottom-up, so each branch atom is visited once however the branches nest. Branches
+// must be trees. With skipAcids, COOH bonded straight to a chain atom is left out.
+// Fills scratch.branches in chain order, each atom's branches sorted by name.
+void analyzeBranches(const MolecularGraph& molecule, const std::vector<int>& chain, NamerScratch& scratch,
+                     bool skipAcids, std::ostream* trace);
+
+// The analysed branches along chain (in numbering order) with their locants, in
+// scratch.arena
+std::pmr::vector<ChainSubstituent> substituentsAlong(const std::vector<int>& chain, NamerScratch& scratch);
+
+bool isCOOHGroup(const MolecularGraph& molecule, int atom);
+
+// Legacy branch names: "methyl", "undecyl", "chloro" for a bare halogen, "chloro-ethyl"
+void appendBranchName(std::string& out, int numCarbons, int halogenType);
+
+// Order substituent names are cited in, ignoring locants and sec-/tert-
+bool alphabeticallyBefore(std::string_view a, std::string_view b);
+
+// Substituent prefixes in order of lowest locant (ties alphabetical), identical ones
+// grouped as "(2,4)-dimethyl" or "(3,4)-bis(2-methylpropyl)", then the stem of a chain
+// of chainLength carbons with the suffix picked by counter (0 "ane", 1 "an" for acids,
+// 2 "yl" for alkyl groups). Substituents may come in any order, several on one locant;
+// the grouping works in the memory they were allocated from.
+std::string generateIUPACName(std::pmr::vector<ChainSubstituent> substituents, int chainLength, int counter);
+
+// Names a molecule with exactly one ring, given in ring order, as a cycloalkane.
+// Substituents are walked like chain branches; a COOH on the ring gives
+// "...carboxylic acid".
+NamingResult nameMonocycle(const MolecularGraph& molecule, const std::vector<int>& ring, int hint,
+                           NamerScratch& scratch, std::ostream* trace);
+
+// Names one parsed molecule. hint == 1 names it as an alkyl group (ether halves).
+// When trace is set, every stage writes its debug output there; nullptr stays silent.
+NamingResult processMolecularGraph(MolecularGraph& graph1, int hint, NamerScratch& scratch,
+                                   const NamerOptions& options, std::ostream* trace);
+
+// -------------------- Namer --------------------
+
+// Self-contained naming context. All state lives in the object or in caller-supplied
+// scratch, so any number of Namers (or concurrent name() calls) can run side by side.
+class Namer {
+public:
+    explicit Namer(NamerOptions options = {});
+
+    const NamerOptions& getOptions() const { return options; }
+
+    // Names one formula, splitting on "-O-" for ethers (with options.smiles, one SMILES,
+    // split at the O of a dialkyl ether). Surrounding whitespace is ignored; malformed
+    // formulas come back with error and errorOffset set. trace is optional.
+    NamingResult name(std::string_view formula, NamerScratch& scratch, std::ostream* trace) const;
+
+    // Just the name, using a temporary scratch
+    std::string name(std::string_view formula) const;
+
+    // Names the molecule already built in scratch.wholeGraph (e.g. loaded from a
+    // GraphStore), skipping the parse; a dialkyl ether is split at its O as for SMILES.
+    // label stands for it among the slowest formulas in the metrics.
+    NamingResult nameGraph(std::string_view label, NamerScratch& scratch, std::ostream* trace) const;
+
+    // Result cache shared by every thread using this Namer; null when disabled
+    NameCache* getCache() const { return cache.get(); }
+
+    // Stage timings and work counters over every name() call; null unless
+    // options.metrics is set
+    PipelineMetrics* getMetrics() const { return metrics.get(); }
+
+    // Names every formula across the worker pool. Results keep the input order;
+    // formulas that fail to name carry their error.
+    std::vector<NamingResult> nameBatch(std::span<const std::string_view> formulas);
+
+private:
+    // Runs body, timing it and counting its allocations into the metrics when enabled
+    template <typename Body>
+    NamingResult measured(std::string_view label, NamerScratch& scratch, Body&& body) const;
+
+    NamingResult nameFormula(std::string_view formula, NamerScratch& scratch, std::ostream* trace) const;
+
+    // scratch.wholeGraph, as one molecule or as an ether
+    NamingResult nameWholeGraph(NamerScratch& scratch, std::ostream* trace) const;
+
+    // "<group> <group> ether" from scratch.molecule and scratch.etherHalf
+    NamingResult nameEther(NamerScratch& scratch, std::ostream* trace) const;
+
+    // processMolecularGraph behind the cache: isomorphic molecules are looked up by
+    // their canonical code before any naming work is done
+    NamingResult nameMolecule(MolecularGraph& molecule, int hint, NamerScratch& scratch, std::ostream* trace) const;
+
+    NamerOptions options;
+    std::unique_ptr<NameCache> cache;
+    std::unique_ptr<PipelineMetrics> metrics;
+
+    std::mutex poolLock;
+    std::unique_ptr<WorkStealingPool> pool;       // Started on the first batch
+    std::vector<NamerScratch> workerScratch;      // One per pool worker
+};
@@ -0,0 +1,145 @@
+#include "nomenclature.h"
+
+#include <array>
+#include <string>
+
+using namespace std;
+
+// Index is the digit; unit 1 and 2 read "hen"/"do" inside larger numbers
+static constexpr array<string_view, 10> unitTerms = {
+    "", "hen", "do", "tri", "tetra", "penta", "hexa", "hepta", "octa", "nona"};
+static constexpr array<string_view, 10> tensTerms = {
+    "", "deca", "icosa", "triaconta", "tetraconta", "pentaconta", "hexaconta", "heptaconta", "octaconta", "nonaconta"};
+static constexpr array<string_view, 10> hundredsTerms = {
+    "", "hecta", "dicta", "tricta", "tetracta", "pentacta", "hexacta", "heptacta", "octacta", "nonacta"};
+static constexpr array<string_view, 10> thousandsTerms = {
+    "", "kilia", "dilia", "trilia", "tetralia", "pentalia", "hexalia", "heptalia", "octalia", "nonalia"};
+
+// The first four alkanes keep their trivial stems
+static constexpr array<string_view, 5> trivialStems = {"", "meth", "eth", "prop", "but"};
+
+static constexpr array<string_view, 5> halogenNames = {"halo", "chloro", "bromo", "fluoro", "iodo"};
+
+static_assert(maxNumericTerm <= 9999, "the tables stop at the thousands digit");
+
+// Full numeric term for 5 <= n <= 9999; always ends in 'a'. Larger counts have no
+// IUPAC term and are written as the number in brackets, e.g. "[12000]a".
+static void appendNumericTerm(string& out, int n) {
+    if (n > maxNumericTerm) {
+        out += '[';
+        out += to_string(n);
+        out += "]a";
+        return;
+    }
+
+    int units = n % 10;
+    int tens = n / 10 % 10;
+    int hundreds = n / 100 % 10;
+    int thousands = n / 1000 % 10;
+
+    if (n < 10) {
+        out += unitTerms[units];
+        return;
+    }
+
+    if (units == 1) {
+        out += tens == 1 ? "un" : "hen";  // undeca, but henicosa and hentriaconta
+    } else {
+        out += unitTerms[units];
+    }
+    if (tens == 2 && units > 1) {
+        out += "cosa";  // The "i" of icosa is elided after a vowel: docosa, tricosa
+    } else {
+        out += tensTerms[tens];
+    }
+    out += hundredsTerms[hundreds];
+    out += thousandsTerms[thousands];
+}
+
+void appendAlkaneStem(string& out, int n) {
+    if (n < (int)trivialStems.size()) {
+        out += trivialStems[n];
+        return;
+    }
+    appendNumericTerm(out, n);
+    out.pop_back();  // The final "a" is elided before -ane, -an and -yl
+}
+
+// Matches the stages of a numeric term (units, tens, hundreds, thousands; each optional)
+// from pos onward. Morphemes can overlap ("tri" against "triaconta"), so each stage
+// backtracks over every morpheme that fits. A full match only counts if the generator
+// spells that value the same way, which rules out forms like "unicosa" or "hendeca".
+static bool matchTerm(string_view term, size_t pos, int stage, int value, int& n) {
+    if (pos == term.size()) {
+        if (value <= 0) return false;
+        string canonical;
+        appendNumericTerm(canonical, value);
+        if (canonical != term) return false;
+        n = value;
+        return true;
+    }
+    if (stage == 4) return false;
+
+    static constexpr const array<string_view, 10>* stages[] = {&unitTerms, &tensTerms, &hundredsTerms, &thousandsTerms};
+    static constexpr int scale[] = {1, 10, 100, 1000};
+    string_view rest = term.substr(pos);
+    for (int digit = 1; digit < 10; digit++) {
+        string_view morpheme = (*stages[stage])[digit];
+        if (rest.starts_with(morpheme) && matchTerm(term, pos + morpheme.size(), stage + 1, value + digit * scale[stage], n)) {
+            return true;
+        }
+    }
+    // Elided forms: "un" for 1 before deca, "cosa" for icosa after a vowel
+    if (stage == 0 && rest.starts_with("un") && matchTerm(term, pos + 2, 1, value + 1, n)) return true;
+    if (stage == 1 && rest.starts_with("cosa") && matchTerm(term, pos + 4, 2, value + 20, n)) return true;
+    return matchTerm(term, pos, stage + 1, value, n);
+}
+
+int parseAlkaneStem(string_view stem) {
+    for (int n = 1; n < (int)trivialStems.size(); n++) {
+        if (stem == trivialStems[n]) return n;
+    }
+
+    if (stem.size() > 2 && stem.front() == '[' && stem.back() == ']') {
+        int n = 0;
+        for (char ch : stem.substr(1, stem.size() - 2)) {
+            if (ch < '0' || ch > '9' || n > 100000000) return 0;
+            n = n * 10 + (ch - '0');
+        }
+        return n > maxNumericTerm ? n : 0;
+    }
+
+    // The stem is the term without its final "a"; put it back and match the stages
+    char term[64];
+    if (stem.size() + 1 >= sizeof(term)) return 0;
+    stem.copy(term, stem.size());
+    term[stem.size()] = 'a';
+    int n = 0;
+    if (!matchTerm(string_view(term, stem.size() + 1), 0, 0, 0, n) || n < (int)trivialStems.size()) return 0;
+    return n;
+}
+
+void appendMultiplier(string& out, int n) {
+    if (n == 2) {
+        out += "di";
+    } else if (n == 3) {
+        out += "tri";
+    } else if (n >= 4) {
+        appendNumericTerm(out, n);
+    }
+}
+
+void appendComplexMultiplier(string& out, int n) {
+    if (n == 2) {
+        out += "bis";
+    } else if (n == 3) {
+        out += "tris";
+    } else if (n >= 4) {
+        appendNumericTerm(out, n);
+        out += "kis";
+    }
+}
+
+string_view halogenPrefix(int halogenType) {
+    return halogenType > 0 && halogenType < (int)halogenNames.size() ? halogenNames[halogenType] : halogenNames[0];
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+// Numeric roots and multiplying prefixes (IUPAC P-14.2, P-21.2). Terms are built from
+// constexpr tables of units, tens, hundreds and thousands, cited in that order with the
+// usual elisions (undeca, docosa, henicosa), so any count from 1 to 9999 has a name.
+
+// Largest count the tables can name; beyond it the number itself is written, e.g. "[12000]"
+constexpr int maxNumericTerm = 9999;
+
+// Alkane stem for a chain of n carbons, lower case: "meth", "but", "undec", "henicos"
+void appendAlkaneStem(std::string& out, int n);
+
+// Inverse of appendAlkaneStem: the carbon count for an exact stem such as "undec", or 0
+// if the text is not a stem appendAlkaneStem would produce
+int parseAlkaneStem(std::string_view stem);
+
+// Multiplying prefix for n identical simple substituents: "di", "tri", "tetra", ...
+// "undeca", "icosa". Nothing is written for n == 1.
+void appendMultiplier(std::string& out, int n);
+
+// Multiplying prefix for n identical complex substituents: "bis", "tris", "tetrakis", ...
+void appendComplexMultiplier(std::string& out, int n);
+
+// Substituent name for a halogen type (1..4): "chloro", "bromo", "fluoro", "iodo"
+std::string_view halogenPrefix(int halogenType);
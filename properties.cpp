@@ -0,0 +1,151 @@
+#include "properties.h"
+
+#include <cstdio>
+#include <cstring>
+
+using namespace std;
+
+void MoleculeBatch::clear() {
+    element.clear();
+    hydrogens.clear();
+    atomOffsets.assign(1, 0);
+}
+
+void MoleculeBatch::add(const MolecularGraph& molecule) {
+    int atoms = molecule.atomCount();
+    element.resize(element.size() + atoms);
+    hydrogens.resize(hydrogens.size() + atoms);
+    uint8_t* codes = element.data() + atomOffsets.back();
+    uint8_t* counts = hydrogens.data() + atomOffsets.back();
+    static_assert(sizeof(Element) == 1);
+    if (atoms > 0) memcpy(codes, molecule.element.data(), atoms);
+    for (int atom = 0; atom < atoms; atom++) {
+        counts[atom] = molecule.C_H_bonds[atom];
+    }
+    atomOffsets.push_back(element.size());
+}
+
+// Standard atomic weights and monoisotopic masses
+static constexpr double weightC = 12.011, massC = 12.0;
+static constexpr double weightH = 1.008, massH = 1.00782503207;
+static constexpr double weightO = 15.999, massO = 15.99491461957;
+static constexpr double weightF = 18.998403163, massF = 18.99840316273;
+static constexpr double weightCl = 35.45, massCl = 34.968852682;
+static constexpr double weightBr = 79.904, massBr = 78.9183376;
+static constexpr double weightI = 126.90447, massI = 126.9044719;
+
+// Eight atoms are read at a time as one 64-bit word (SIMD within a register), so the
+// counting does not depend on the compiler vectorizing the loop
+static constexpr uint64_t everyByte = 0x0101010101010101ull;
+static constexpr uint64_t lowSevenBits = 0x7F7F7F7F7F7F7F7Full;
+
+// Bytes of word equal to code. The add sets the top bit of every nonzero byte without
+// carrying into the next one, so only the bytes that were zero keep it clear.
+static inline uint32_t countBytes(uint64_t word, uint8_t code) {
+    uint64_t difference = word ^ (everyByte * code);
+    uint64_t zero = ~(((difference & lowSevenBits) + lowSevenBits) | difference | lowSevenBits);
+    return (zero >> 7) * everyByte >> 56;
+}
+
+// Sum of the eight bytes; hydrogen counts are at most 4, so it cannot overflow a byte
+static inline uint32_t sumBytes(uint64_t word) {
+    return word * everyByte >> 56;
+}
+
+void computeProperties(const MoleculeBatch& batch, BatchProperties& out) {
+    size_t molecules = batch.size();
+    for (auto* counts : {&out.carbons, &out.hydrogens, &out.oxygens, &out.fluorines, &out.chlorines, &out.bromines,
+                         &out.iodines, &out.heavyAtoms}) {
+        counts->resize(molecules);
+    }
+    out.molecularWeight.resize(molecules);
+    out.exactMass.resize(molecules);
+    out.unsaturation.resize(molecules);
+
+    constexpr uint8_t codeC = (uint8_t)Element::C, codeCOOH = (uint8_t)Element::COOH, codeO = (uint8_t)Element::O;
+    constexpr uint8_t codeF = (uint8_t)Element::F, codeCl = (uint8_t)Element::Cl, codeBr = (uint8_t)Element::Br;
+    constexpr uint8_t codeI = (uint8_t)Element::I;
+    const uint8_t* element = batch.element.data();
+    const uint8_t* hydrogens = batch.hydrogens.data();
+    for (size_t m = 0; m < molecules; m++) {
+        uint32_t c = 0, cooh = 0, o = 0, f = 0, cl = 0, br = 0, iodine = 0, h = 0;
+        uint32_t atom = batch.atomOffsets[m];
+        uint32_t last = batch.atomOffsets[m + 1];
+        for (; atom + 8 <= last; atom += 8) {
+            uint64_t codes, counts;
+            memcpy(&codes, element + atom, 8);
+            memcpy(&counts, hydrogens + atom, 8);
+            c += countBytes(codes, codeC);
+            cooh += countBytes(codes, codeCOOH);
+            o += countBytes(codes, codeO);
+            f += countBytes(codes, codeF);
+            cl += countBytes(codes, codeCl);
+            br += countBytes(codes, codeBr);
+            iodine += countBytes(codes, codeI);
+            h += sumBytes(counts);
+        }
+        for (; atom < last; atom++) {
+            uint8_t code = element[atom];
+            c += code == codeC;
+            cooh += code == codeCOOH;
+            o += code == codeO;
+            f += code == codeF;
+            cl += code == codeCl;
+            br += code == codeBr;
+            iodine += code == codeI;
+            h += hydrogens[atom];
+        }
+
+        out.carbons[m] = c + cooh;
+        out.hydrogens[m] = h + cooh;
+        out.oxygens[m] = o + 2 * cooh;
+        out.fluorines[m] = f;
+        out.chlorines[m] = cl;
+        out.bromines[m] = br;
+        out.iodines[m] = iodine;
+        out.heavyAtoms[m] = c + cooh + o + 2 * cooh + f + cl + br + iodine;
+    }
+
+    // Masses and unsaturation follow from the counts, element-wise over the arrays
+    for (size_t m = 0; m < molecules; m++) {
+        double c = out.carbons[m], h = out.hydrogens[m], o = out.oxygens[m];
+        double f = out.fluorines[m], cl = out.chlorines[m], br = out.bromines[m], iodine = out.iodines[m];
+        out.molecularWeight[m] = c * weightC + h * weightH + o * weightO + f * weightF + cl * weightCl + br * weightBr + iodine * weightI;
+        out.exactMass[m] = c * massC + h * massH + o * massO + f * massF + cl * massCl + br * massBr + iodine * massI;
+        out.unsaturation[m] = c + 1 - (h + f + cl + br + iodine) / 2;
+    }
+}
+
+static void appendCount(string& out, const char* symbol, uint32_t count) {
+    if (count == 0) return;
+    out += symbol;
+    if (count > 1) out += to_string(count);
+}
+
+string BatchProperties::formula(size_t molecule) const {
+    string text;
+    bool hasCarbon = carbons[molecule] > 0;
+    if (hasCarbon) {
+        appendCount(text, "C", carbons[molecule]);
+        appendCount(text, "H", hydrogens[molecule]);
+    }
+    appendCount(text, "Br", bromines[molecule]);
+    appendCount(text, "Cl", chlorines[molecule]);
+    appendCount(text, "F", fluorines[molecule]);
+    if (!hasCarbon) appendCount(text, "H", hydrogens[molecule]);  // Without carbon H sorts with the rest
+    appendCount(text, "I", iodines[molecule]);
+    appendCount(text, "O", oxygens[molecule]);
+    return text;
+}
+
+void BatchProperties::appendJson(string& out, size_t molecule) const {
+    char numbers[224];
+    snprintf(numbers, sizeof(numbers),
+             "\",\"molecular_weight\":%.3f,\"exact_mass\":%.5f,\"unsaturation\":%g,\"heavy_atoms\":%u,"
+             "\"halogens\":{\"F\":%u,\"Cl\":%u,\"Br\":%u,\"I\":%u}}",
+             molecularWeight[molecule], exactMass[molecule], unsaturation[molecule], heavyAtoms[molecule],
+             fluorines[molecule], chlorines[molecule], bromines[molecule], iodines[molecule]);
+    out += "{\"formula\":\"";
+    out += formula(molecule);
+    out += numbers;
+}
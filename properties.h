@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "molecule.h"
+
+// Struct-of-arrays view of many parsed molecules: the atoms of every molecule laid end
+// to end, so one pass over the batch reads two flat byte arrays. Molecule m owns atoms
+// atomOffsets[m] .. atomOffsets[m + 1].
+struct MoleculeBatch {
+    std::vector<uint8_t> element;    // Element codes
+    std::vector<uint8_t> hydrogens;  // C_H_bonds of each atom
+    std::vector<uint32_t> atomOffsets = {0};
+
+    size_t size() const { return atomOffsets.size() - 1; }
+
+    // Keeps the buffers, like MolecularGraph::clear()
+    void clear();
+
+    // Appends a copy of the molecule's atom table; an empty graph adds an empty molecule
+    void add(const MolecularGraph& molecule);
+};
+
+// Properties of every molecule in a batch, one array per property. COOH counts as
+// C, 2 O and 1 H. Hydrogens are the ones written in the formula, so a carbon given
+// fewer than its valence allows shows up as unsaturation.
+struct BatchProperties {
+    std::vector<uint32_t> carbons;
+    std::vector<uint32_t> hydrogens;
+    std::vector<uint32_t> oxygens;
+    std::vector<uint32_t> fluorines;
+    std::vector<uint32_t> chlorines;
+    std::vector<uint32_t> bromines;
+    std::vector<uint32_t> iodines;
+    std::vector<uint32_t> heavyAtoms;
+    std::vector<double> molecularWeight;  // Standard atomic weights, g/mol
+    std::vector<double> exactMass;        // Most abundant isotope of each element, Da
+    std::vector<double> unsaturation;     // Rings plus pi bonds: C + 1 - (H + X) / 2
+
+    size_t size() const { return carbons.size(); }
+
+    uint32_t halogens(size_t molecule) const {
+        return fluorines[molecule] + chlorines[molecule] + bromines[molecule] + iodines[molecule];
+    }
+
+    // Hill notation: C and H first, then the rest alphabetically, e.g. "C4H9BrO"
+    std::string formula(size_t molecule) const;
+
+    // {"formula":...,"molecular_weight":...,...} for one molecule
+    void appendJson(std::string& out, size_t molecule) const;
+};
+
+// One pass over the batch: element counts per molecule, eight atoms per step, then
+// masses and unsaturation from the counts. Reuses the buffers of out.
+void computeProperties(const MoleculeBatch& batch, BatchProperties& out);
@@ -0,0 +1,280 @@
+#include "rings.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+
+using namespace std;
+
+static int findSet(vector<int>& sets, int atom) {
+    while (sets[atom] != atom) {
+        sets[atom] = sets[sets[atom]];  // Path halving
+        atom = sets[atom];
+    }
+    return atom;
+}
+
+int countRings(const MolecularGraph& molecule, vector<int>& sets) {
+    sets.resize(molecule.atomCount());
+    for (int atom = 0; atom < molecule.atomCount(); atom++) {
+        sets[atom] = atom;
+    }
+
+    // Every bond that joins two atoms already connected closes one more ring
+    int rings = 0;
+    for (const auto& [a, b] : molecule.edges) {
+        int rootA = findSet(sets, a);
+        int rootB = findSet(sets, b);
+        if (rootA == rootB) {
+            rings++;
+        } else {
+            sets[rootA] = rootB;
+        }
+    }
+    return rings;
+}
+
+// ----- Biconnected blocks -----
+
+// Iterative Tarjan: calls onBlock with the bonds of every biconnected block
+template <typename Callback>
+static void forEachBlock(const MolecularGraph& molecule, Callback onBlock) {
+    int n = molecule.atomCount();
+    vector<int> discovered(n, -1);
+    vector<int> low(n, 0);
+    vector<pair<int, int>> bondStack;
+    vector<pair<int, int>> block;
+
+    struct Frame {
+        int atom;
+        int parent;
+        int next;  // Index into adjacencyTargets of the next neighbour to look at
+    };
+    vector<Frame> frames;
+    int time = 0;
+
+    for (int root = 0; root < n; root++) {
+        if (discovered[root] != -1) continue;
+        discovered[root] = low[root] = time++;
+        frames.push_back({root, -1, molecule.adjacencyOffsets[root]});
+
+        while (!frames.empty()) {
+            Frame& frame = frames.back();
+            int atom = frame.atom;
+            if (frame.next < molecule.adjacencyOffsets[atom + 1]) {
+                int neighbor = molecule.adjacencyTargets[frame.next++];
+                if (discovered[neighbor] == -1) {
+                    bondStack.emplace_back(atom, neighbor);
+                    discovered[neighbor] = low[neighbor] = time++;
+                    frames.push_back({neighbor, atom, molecule.adjacencyOffsets[neighbor]});
+                } else if (neighbor != frame.parent && discovered[neighbor] < discovered[atom]) {
+                    bondStack.emplace_back(atom, neighbor);
+                    low[atom] = min(low[atom], discovered[neighbor]);
+                }
+                continue;
+            }
+
+            frames.pop_back();
+            if (frames.empty()) break;
+            int parent = frames.back().atom;
+            low[parent] = min(low[parent], low[atom]);
+            if (low[atom] >= discovered[parent]) {
+                // parent separates everything pushed since the bond parent-atom
+                block.clear();
+                while (true) {
+                    pair<int, int> bond = bondStack.back();
+                    bondStack.pop_back();
+                    block.push_back(bond);
+                    if (bond.first == parent && bond.second == atom) break;
+                }
+                onBlock(block);
+            }
+        }
+    }
+}
+
+// ----- Ring systems -----
+
+// One ring system relabeled to local ids 0..n-1, with its own CSR adjacency where
+// every entry also records the local bond id
+struct RingSystem {
+    vector<int> atoms;                 // Local id -> atom id
+    vector<pair<int, int>> bonds;      // Local atom ids
+    vector<int> offsets;
+    vector<pair<int, int>> adjacency;  // (neighbour, bond id)
+};
+
+static void buildSystem(const vector<pair<int, int>>& block, vector<int>& localId, RingSystem& system) {
+    system.atoms.clear();
+    system.bonds.clear();
+    for (const auto& [a, b] : block) {
+        for (int atom : {a, b}) {
+            if (localId[atom] == -1) {
+                localId[atom] = system.atoms.size();
+                system.atoms.push_back(atom);
+            }
+        }
+        system.bonds.emplace_back(localId[a], localId[b]);
+    }
+    for (int atom : system.atoms) {
+        localId[atom] = -1;  // Leave the map clean for the next block
+    }
+
+    int n = system.atoms.size();
+    system.offsets.assign(n + 1, 0);
+    for (const auto& [a, b] : system.bonds) {
+        system.offsets[a + 1]++;
+        system.offsets[b + 1]++;
+    }
+    for (int i = 0; i < n; i++) {
+        system.offsets[i + 1] += system.offsets[i];
+    }
+    system.adjacency.resize(system.offsets[n]);
+    vector<int> fill(system.offsets.begin(), system.offsets.end() - 1);
+    for (int bond = 0; bond < (int)system.bonds.size(); bond++) {
+        auto [a, b] = system.bonds[bond];
+        system.adjacency[fill[a]++] = {b, bond};
+        system.adjacency[fill[b]++] = {a, bond};
+    }
+}
+
+// A block with as many bonds as atoms is one plain cycle: walk it
+static vector<int> walkCycle(const RingSystem& system) {
+    vector<int> ring;
+    int previous = -1;
+    int atom = 0;
+    do {
+        ring.push_back(system.atoms[atom]);
+        int next = system.adjacency[system.offsets[atom]].first;
+        if (next == previous) next = system.adjacency[system.offsets[atom] + 1].first;
+        previous = atom;
+        atom = next;
+    } while (atom != 0);
+    return ring;
+}
+
+// Horton: every cycle of a minimum basis is a shortest path root..x, the bond x-y and
+// a shortest path y..root for some root and bond. Candidates are tried shortest first
+// and kept when independent of the rings already chosen.
+static void smallestRings(const RingSystem& system, int ringCount, vector<vector<int>>& rings) {
+    int n = system.atoms.size();
+    int bondCount = system.bonds.size();
+    int words = (bondCount + 63) / 64;
+
+    // Shortest-path trees from every root: parent bond and distance per atom
+    vector<int> parentBond((size_t)n * n);
+    vector<int> distance((size_t)n * n);
+    vector<int> branch(n);
+    vector<int> queue(n);
+
+    struct Candidate {
+        int length;
+        int root;
+        int bond;
+    };
+    vector<Candidate> candidates;
+
+    for (int root = 0; root < n; root++) {
+        int* parent = &parentBond[(size_t)root * n];
+        int* dist = &distance[(size_t)root * n];
+        fill(dist, dist + n, -1);
+        dist[root] = 0;
+        parent[root] = -1;
+        branch[root] = root;
+
+        int head = 0, tail = 0;
+        queue[tail++] = root;
+        while (head < tail) {
+            int atom = queue[head++];
+            for (int k = system.offsets[atom]; k < system.offsets[atom + 1]; k++) {
+                auto [neighbor, bond] = system.adjacency[k];
+                if (dist[neighbor] != -1) continue;
+                dist[neighbor] = dist[atom] + 1;
+                parent[neighbor] = bond;
+                branch[neighbor] = atom == root ? neighbor : branch[atom];
+                queue[tail++] = neighbor;
+            }
+        }
+
+        for (int bond = 0; bond < bondCount; bond++) {
+            auto [x, y] = system.bonds[bond];
+            if (parent[x] == bond || parent[y] == bond) continue;  // Tree bond
+            if (branch[x] == branch[y]) continue;                   // Paths would overlap
+            candidates.push_back({dist[x] + dist[y] + 1, root, bond});
+        }
+    }
+
+    stable_sort(candidates.begin(), candidates.end(),
+                [](const Candidate& a, const Candidate& b) { return a.length < b.length; });
+
+    // Bond sets of the chosen rings, reduced so each has a distinct pivot bond
+    vector<vector<uint64_t>> basis;
+    vector<int> pivots;
+    vector<uint64_t> bits(words);
+    vector<int> pathX, pathY;
+
+    auto walkToRoot = [&](int root, int atom, vector<int>& path) {
+        const int* parent = &parentBond[(size_t)root * n];
+        path.clear();
+        while (atom != root) {
+            path.push_back(atom);
+            int bond = parent[atom];
+            bits[bond / 64] ^= 1ull << (bond % 64);
+            atom = system.bonds[bond].first == atom ? system.bonds[bond].second : system.bonds[bond].first;
+        }
+    };
+
+    for (const Candidate& candidate : candidates) {
+        if ((int)basis.size() == ringCount) break;
+
+        auto [x, y] = system.bonds[candidate.bond];
+        fill(bits.begin(), bits.end(), 0);
+        bits[candidate.bond / 64] ^= 1ull << (candidate.bond % 64);
+        walkToRoot(candidate.root, x, pathX);
+        walkToRoot(candidate.root, y, pathY);
+
+        vector<uint64_t> reduced = bits;
+        for (size_t row = 0; row < basis.size(); row++) {
+            if (reduced[pivots[row] / 64] >> (pivots[row] % 64) & 1) {
+                for (int w = 0; w < words; w++) reduced[w] ^= basis[row][w];
+            }
+        }
+        int pivot = -1;
+        for (int w = 0; w < words && pivot == -1; w++) {
+            if (reduced[w]) pivot = w * 64 + __builtin_ctzll(reduced[w]);
+        }
+        if (pivot == -1) continue;  // Sum of rings already chosen
+
+        basis.push_back(move(reduced));
+        pivots.push_back(pivot);
+
+        // Ring order: root, down to x, across to y, back up towards root
+        vector<int> ring = {system.atoms[candidate.root]};
+        for (auto it = pathX.rbegin(); it != pathX.rend(); ++it) ring.push_back(system.atoms[*it]);
+        for (int atom : pathY) ring.push_back(system.atoms[atom]);
+        rings.push_back(move(ring));
+    }
+}
+
+RingInfo perceiveRings(const MolecularGraph& molecule, int maxSystemAtoms) {
+    RingInfo info;
+    vector<int> localId(molecule.atomCount(), -1);
+    RingSystem system;
+
+    forEachBlock(molecule, [&](const vector<pair<int, int>>& block) {
+        if (block.size() < 2) return;  // A bridge, not part of any ring
+
+        buildSystem(block, localId, system);
+        int ringCount = system.bonds.size() - system.atoms.size() + 1;
+        info.ringCount += ringCount;
+
+        if (ringCount == 1) {
+            info.rings.push_back(walkCycle(system));
+        } else if ((int)system.atoms.size() <= maxSystemAtoms) {
+            smallestRings(system, ringCount, info.rings);
+        } else {
+            info.complete = false;
+        }
+    });
+    return info;
+}
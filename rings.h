@@ -0,0 +1,22 @@
+#pragma once
+
+#include <vector>
+
+#include "molecule.h"
+
+// Rings found in one molecule
+struct RingInfo {
+    int ringCount = 0;                    // Cyclomatic number: bonds - atoms + components
+    std::vector<std::vector<int>> rings;  // Smallest set of smallest rings, atoms in ring order
+    bool complete = true;                 // False when a ring system was too big to resolve
+};
+
+// Counts independent rings with a union-find pass over the bonds. This is the cheap
+// check every molecule goes through; sets is caller-owned scratch.
+int countRings(const MolecularGraph& molecule, std::vector<int>& sets);
+
+// Splits the molecule into biconnected blocks and resolves each ring system on its
+// own. A block that is a single cycle is read off directly; fused systems take
+// Horton's candidate cycles and keep the shortest independent ones (GF(2) elimination).
+// Systems larger than maxSystemAtoms are counted but not resolved.
+RingInfo perceiveRings(const MolecularGraph& molecule, int maxSystemAtoms = 512);
@@ -1,8 +1,226 @@
-from flask import Flask, request, jsonify, render_template, redirect, url_for
+from flask import Flask, Response, request, jsonify, render_template, redirect, url_for
+import atexit
+import json
+import os
+import queue
+import select
 import subprocess
+import threading
+import time
 
 app = Flask(__name__)
 
+TOOLKIT_CMD = ["./toolkit", "--serve", "--length-prefixed", "--json", "--metrics", "--cache", os.environ.get("TOOLKIT_CACHE", "10000")]
+if os.environ.get("TOOLKIT_CACHE_FILE"):
+    TOOLKIT_CMD += ["--cache-file", os.environ["TOOLKIT_CACHE_FILE"]]
+if os.environ.get("TOOLKIT_SMILES"):
+    TOOLKIT_CMD += ["--smiles"]
+if os.environ.get("TOOLKIT_INDEX"):
+    TOOLKIT_CMD += ["--index", os.environ["TOOLKIT_INDEX"], "--top", os.environ.get("TOOLKIT_TOP", "10")]
+POOL_SIZE = int(os.environ.get("TOOLKIT_WORKERS", "4"))
+REQUEST_TIMEOUT = 5
+
+
+class ToolkitWorker:
+    """A long-lived ./toolkit --serve process that answers one framed request at a time."""
+
+    def __init__(self):
+        self.proc = subprocess.Popen(TOOLKIT_CMD, stdin=subprocess.PIPE, stdout=subprocess.PIPE, bufsize=0)
+        self.buffer = b""
+
+    def _read_until(self, predicate, deadline):
+        while not predicate():
+            remaining = deadline - time.monotonic()
+            if remaining <= 0:
+                raise TimeoutError("toolkit did not answer in time")
+            ready, _, _ = select.select([self.proc.stdout], [], [], remaining)
+            if not ready:
+                continue
+            chunk = os.read(self.proc.stdout.fileno(), 65536)
+            if not chunk:
+                raise RuntimeError("toolkit worker exited")
+            self.buffer += chunk
+
+    def request(self, record, timeout=REQUEST_TIMEOUT):
+        payload = record.encode()
+        self.proc.stdin.write(str(len(payload)).encode() + b"\n" + payload)
+        self.proc.stdin.flush()
+
+        deadline = time.monotonic() + timeout
+        self._read_until(lambda: b"\n" in self.buffer, deadline)
+        header, self.buffer = self.buffer.split(b"\n", 1)
+        length = int(header)
+        self._read_until(lambda: len(self.buffer) >= length, deadline)
+        output, self.buffer = self.buffer[:length], self.buffer[length:]
+        return output.decode()
+
+    def name(self, formula):
+        return self.request(formula)
+
+    def metrics(self):
+        # Formulas never start with '#', so the worker reads this as a command
+        return json.loads(self.request("#metrics"))
+
+    def close(self):
+        self.proc.kill()
+        self.proc.wait()
+
+    def shutdown(self):
+        # Closing stdin lets the worker exit normally and persist its name cache
+        self.proc.stdin.close()
+        try:
+            self.proc.wait(timeout=REQUEST_TIMEOUT)
+        except subprocess.TimeoutExpired:
+            self.close()
+
+
+class ToolkitPool:
+    """Keeps a small number of toolkit workers alive and replaces any that fail."""
+
+    def __init__(self, size):
+        self.size = size
+        self.idle = queue.LifoQueue()
+        self.slots = threading.Semaphore(size)
+        # Latest metrics snapshot per live worker, and the sum of the last snapshots of
+        # workers that are gone, so totals never go backwards when one is replaced
+        self.stats_lock = threading.Lock()
+        self.snapshots = {}
+        self.retired = None
+
+    def _run(self, call):
+        with self.slots:
+            try:
+                worker = self.idle.get_nowait()
+            except queue.Empty:
+                worker = ToolkitWorker()
+            try:
+                output = call(worker)
+            except Exception:
+                self._retire(worker)
+                worker.close()
+                raise
+            self._release(worker)
+            return output
+
+    def _release(self, worker):
+        # Workers started while metrics() had the idle ones out can leave a surplus
+        if self.idle.qsize() >= self.size:
+            self._retire(worker)
+            worker.shutdown()
+        else:
+            self.idle.put(worker)
+
+    def _retire(self, worker):
+        with self.stats_lock:
+            snapshot = self.snapshots.pop(worker, None)
+            if snapshot:
+                self.retired = merge_metrics(self.retired, snapshot)
+
+    def name(self, formula):
+        return self._run(lambda worker: worker.name(formula))
+
+    def metrics(self):
+        """Pipeline metrics summed over every worker this pool has run, or None.
+
+        Idle workers are asked for a fresh snapshot; busy ones count with the last
+        snapshot taken from them.
+        """
+        workers = []
+        while True:
+            try:
+                workers.append(self.idle.get_nowait())
+            except queue.Empty:
+                break
+        for worker in workers:
+            try:
+                snapshot = worker.metrics()
+            except Exception:
+                self._retire(worker)
+                worker.close()
+                continue
+            with self.stats_lock:
+                self.snapshots[worker] = snapshot
+            self._release(worker)
+
+        with self.stats_lock:
+            total = self.retired
+            for snapshot in self.snapshots.values():
+                total = merge_metrics(total, snapshot)
+            return total
+
+    def shutdown(self):
+        while True:
+            try:
+                self.idle.get_nowait().shutdown()
+            except queue.Empty:
+                return
+
+
+def merge_metrics(total, snapshot):
+    """Adds one worker's metrics snapshot to a running total (None to start one)."""
+    if total is None:
+        return json.loads(json.dumps(snapshot))
+    for key, value in snapshot.items():
+        if isinstance(value, (int, float)) and key in total:
+            total[key] += value
+    for stage, histogram in snapshot["stages"].items():
+        merge_histogram(total["stages"][stage], histogram)
+    merge_histogram(total["total"], snapshot["total"])
+    total["slowest"] = sorted(total["slowest"] + snapshot["slowest"], key=lambda entry: -entry["seconds"])[:16]
+    return total
+
+
+def merge_histogram(total, histogram):
+    total["count"] += histogram["count"]
+    total["seconds"] += histogram["seconds"]
+    total["buckets"] = [a + b for a, b in zip(total["buckets"], histogram["buckets"])]
+
+
+def prometheus_text(metrics):
+    """Renders merged metrics in the Prometheus text exposition format."""
+    lines = []
+    counters = [
+        ("molecules", "Formulas named"),
+        ("errors", "Formulas that failed to name"),
+        ("atoms", "Atoms parsed"),
+        ("bonds", "Bonds parsed"),
+        ("nodes_visited", "Atoms visited by the chain and branch walks"),
+        ("allocations", "Heap allocations while naming"),
+        ("allocated_bytes", "Bytes of heap allocations while naming"),
+        ("arena_allocations", "Allocations served by the per-molecule arena"),
+        ("arena_bytes", "Bytes served by the per-molecule arena"),
+        ("cache_hits", "Name cache hits"),
+        ("cache_misses", "Name cache misses"),
+    ]
+    for key, help_text in counters:
+        lines.append(f"# HELP toolkit_{key}_total {help_text}")
+        lines.append(f"# TYPE toolkit_{key}_total counter")
+        lines.append(f"toolkit_{key}_total {metrics[key]}")
+
+    bounds = metrics["bucket_bounds"] + ["+Inf"]
+
+    def histogram(name, help_text, series):
+        lines.append(f"# HELP {name} {help_text}")
+        lines.append(f"# TYPE {name} histogram")
+        for label, data in series:
+            cumulative = 0
+            for bound, count in zip(bounds, data["buckets"]):
+                cumulative += count
+                lines.append(f'{name}_bucket{{{label}{"," if label else ""}le="{bound}"}} {cumulative}')
+            suffix = f"{{{label}}}" if label else ""
+            lines.append(f"{name}_sum{suffix} {data['seconds']}")
+            lines.append(f"{name}_count{suffix} {data['count']}")
+
+    histogram("toolkit_stage_seconds", "Time per formula spent in each naming stage",
+              [(f'stage="{stage}"', data) for stage, data in metrics["stages"].items()])
+    histogram("toolkit_formula_seconds", "Time to name one formula", [("", metrics["total"])])
+    return "\n".join(lines) + "\n"
+
+
+pool = ToolkitPool(POOL_SIZE)
+atexit.register(pool.shutdown)
+
+
 @app.route('/')
 def home():
     return render_template("home.html")
@@ -11,15 +229,38 @@ def home():
 def toolkit_page():
     return render_template("index.html")
 
-@app.route('/get_iupac', methods=['POST'])
-def get_iupac():
-    formula = request.json['formula']
+def name_result(formula):
+    # The worker reads a record starting with '#' as a command, not a formula
+    if not isinstance(formula, str) or formula.startswith("#"):
+        return {"error": "not a formula"}
     try:
-        result = subprocess.run(["./toolkit"], input=formula.encode(), capture_output=True, timeout=5)
-        output = result.stdout.decode()
-        return jsonify({"output": output})
+        result = json.loads(pool.name(formula))
     except Exception as e:
-        return jsonify({"error": str(e)})
+        return {"error": str(e)}
+    if result.get("error"):
+        return {"error": result["error"]}
+    result["output"] = result["name"]
+    return result
+
+@app.route('/get_iupac', methods=['POST'])
+def get_iupac():
+    return jsonify(name_result(request.json['formula']))
+
+@app.route('/get_iupac_batch', methods=['POST'])
+def get_iupac_batch():
+    return jsonify({"results": [name_result(formula) for formula in request.json['formulas']]})
+
+@app.route('/metrics')
+def metrics():
+    snapshot = pool.metrics()
+    if snapshot is None:
+        return Response("", mimetype="text/plain; version=0.0.4")
+    return Response(prometheus_text(snapshot), mimetype="text/plain; version=0.0.4")
+
+@app.route('/metrics/slowest')
+def slowest():
+    snapshot = pool.metrics()
+    return jsonify(snapshot["slowest"] if snapshot else [])
 
 if __name__ == "__main__":
     app.run(debug=True)
@@ -0,0 +1,893 @@
+// Native HTTP naming service.
+//
+// Serves the /get_iupac contract of server.py, plus /get_iupac_batch, from one process.
+// A single thread runs an epoll loop over non-blocking sockets: it accepts connections,
+// parses each request in place in the connection's read buffer and writes responses.
+// Naming runs on a fixed set of worker threads, each with its own NamerScratch, all
+// sharing one Namer and its cache. Formulas reach the workers as views into the read
+// buffer; only JSON strings with escapes are copied. Connections are HTTP/1.1
+// keep-alive and may pipeline; each has at most one request being named at a time, and
+// its socket is not read again until that response is queued.
+//
+//   g++ -std=c++20 -O2 -pthread service.cpp molecule.cpp namer.cpp thread_pool.cpp canonical.cpp name_cache.cpp rings.cpp nomenclature.cpp name_parser.cpp session.cpp metrics.cpp properties.cpp fingerprint.cpp arena.cpp smiles.cpp graph_store.cpp -o service
+//   ./service --port 8080 --threads 4
+//
+//   POST /get_iupac        {"formula": "CH3CH(CH3)CH3"}
+//   POST /get_iupac_batch  {"formulas": ["CH3CH2CH3", "CH3-O-CH3"]}
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <condition_variable>
+#include <csignal>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "namer.h"
+
+using namespace std;
+
+static constexpr size_t maxHeaderBytes = 16 * 1024;
+static constexpr size_t maxBodyBytes = 16 * 1024 * 1024;
+static constexpr size_t maxPendingOutput = 1 << 20;  // Stop reading a client that does not read its responses
+static constexpr size_t batchGrain = 64;              // Formulas per worker job
+
+// -------------------- Request Bodies --------------------
+
+// Just enough JSON for the request bodies. Strings come back as views into the body;
+// those with escapes are decoded into `decoded`, which must outlive the views.
+class JsonReader {
+public:
+    JsonReader(string_view text, deque<string>& decoded) : text(text), decoded(decoded) {}
+
+    bool consume(char ch) {
+        skipSpace();
+        if (pos >= text.size() || text[pos] != ch) return false;
+        pos++;
+        return true;
+    }
+
+    bool atEnd() {
+        skipSpace();
+        return pos == text.size();
+    }
+
+    bool readString(string_view& out);
+    bool skipValue(int depth = 0);
+
+private:
+    void skipSpace() {
+        while (pos < text.size() && (text[pos] == ' ' || text[pos] == '\t' || text[pos] == '\n' || text[pos] == '\r')) pos++;
+    }
+
+    bool readHex(unsigned& value);
+
+    string_view text;
+    size_t pos = 0;
+    deque<string>& decoded;
+};
+
+bool JsonReader::readHex(unsigned& value) {
+    if (pos + 4 > text.size()) return false;
+    value = 0;
+    for (int i = 0; i < 4; i++) {
+        char ch = text[pos++];
+        int digit = ch >= '0' && ch <= '9' ? ch - '0' : ch >= 'a' && ch <= 'f' ? ch - 'a' + 10 : ch >= 'A' && ch <= 'F' ? ch - 'A' + 10 : -1;
+        if (digit < 0) return false;
+        value = value * 16 + digit;
+    }
+    return true;
+}
+
+bool JsonReader::readString(string_view& out) {
+    if (!consume('"')) return false;
+    size_t start = pos;
+    while (pos < text.size() && text[pos] != '"' && text[pos] != '\\') {
+        if ((unsigned char)text[pos] < 0x20) return false;
+        pos++;
+    }
+    if (pos >= text.size()) return false;
+    if (text[pos] == '"') {
+        out = text.substr(start, pos++ - start);
+        return true;
+    }
+
+    // Escaped string: decode it from the start
+    string& value = decoded.emplace_back(text.substr(start, pos - start));
+    while (pos < text.size() && text[pos] != '"') {
+        char ch = text[pos++];
+        if ((unsigned char)ch < 0x20) return false;
+        if (ch != '\\') {
+            value += ch;
+            continue;
+        }
+        if (pos >= text.size()) return false;
+        switch (char escape = text[pos++]) {
+            case '"': case '\\': case '/': value += escape; break;
+            case 'b': value += '\b'; break;
+            case 'f': value += '\f'; break;
+            case 'n': value += '\n'; break;
+            case 'r': value += '\r'; break;
+            case 't': value += '\t'; break;
+            case 'u': {
+                unsigned code;
+                if (!readHex(code)) return false;
+                if (code >= 0xD800 && code < 0xDC00) {
+                    unsigned low;
+                    if (text.substr(pos, 2) != "\\u") return false;
+                    pos += 2;
+                    if (!readHex(low) || low < 0xDC00 || low >= 0xE000) return false;
+                    code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                }
+                if (code < 0x80) {
+                    value += (char)code;
+                } else if (code < 0x800) {
+                    value += (char)(0xC0 | code >> 6);
+                    value += (char)(0x80 | (code & 0x3F));
+                } else if (code < 0x10000) {
+                    value += (char)(0xE0 | code >> 12);
+                    value += (char)(0x80 | (code >> 6 & 0x3F));
+                    value += (char)(0x80 | (code & 0x3F));
+                } else {
+                    value += (char)(0xF0 | code >> 18);
+                    value += (char)(0x80 | (code >> 12 & 0x3F));
+                    value += (char)(0x80 | (code >> 6 & 0x3F));
+                    value += (char)(0x80 | (code & 0x3F));
+                }
+                break;
+            }
+            default: return false;
+        }
+    }
+    if (pos >= text.size()) return false;
+    pos++;
+    out = value;
+    return true;
+}
+
+bool JsonReader::skipValue(int depth) {
+    if (depth > 64) return false;
+    skipSpace();
+    if (pos >= text.size()) return false;
+    string_view ignored;
+    switch (text[pos]) {
+        case '"':
+            return readString(ignored);
+        case '{':
+            pos++;
+            if (consume('}')) return true;
+            do {
+                if (!readString(ignored) || !consume(':') || !skipValue(depth + 1)) return false;
+            } while (consume(','));
+            return consume('}');
+        case '[':
+            pos++;
+            if (consume(']')) return true;
+            do {
+                if (!skipValue(depth + 1)) return false;
+            } while (consume(','));
+            return consume(']');
+        default: {
+            // Numbers, true, false, null
+            size_t start = pos;
+            while (pos < text.size() && (isalnum((unsigned char)text[pos]) || text[pos] == '-' || text[pos] == '+' || text[pos] == '.')) pos++;
+            return pos > start;
+        }
+    }
+}
+
+// Collects the formulas of {"formula": "..."} or, for a batch, {"formulas": [...]};
+// other keys are ignored. Returns null on success, otherwise what is wrong.
+static const char* readFormulas(string_view body, bool batch, vector<string_view>& formulas, deque<string>& decoded) {
+    JsonReader reader(body, decoded);
+    string_view key = batch ? "formulas" : "formula";
+    bool found = false;
+
+    if (!reader.consume('{')) return "request body must be a JSON object";
+    if (!reader.consume('}')) {
+        do {
+            string_view name;
+            if (!reader.readString(name) || !reader.consume(':')) return "malformed JSON";
+            if (name != key || found) {
+                if (!reader.skipValue()) return "malformed JSON";
+                continue;
+            }
+            found = true;
+            if (!batch) {
+                string_view formula;
+                if (!reader.readString(formula)) return "'formula' must be a string";
+                formulas.push_back(formula);
+                continue;
+            }
+            if (!reader.consume('[')) return "'formulas' must be an array of strings";
+            if (reader.consume(']')) continue;
+            do {
+                string_view formula;
+                if (!reader.readString(formula)) return "'formulas' must be an array of strings";
+                formulas.push_back(formula);
+            } while (reader.consume(','));
+            if (!reader.consume(']')) return "'formulas' must be an array of strings";
+        } while (reader.consume(','));
+        if (!reader.consume('}')) return "malformed JSON";
+    }
+    if (!reader.atEnd()) return "malformed JSON";
+    if (!found) return batch ? "missing 'formulas'" : "missing 'formula'";
+    return nullptr;
+}
+
+// -------------------- Responses --------------------
+
+static const char* statusText(int status) {
+    switch (status) {
+        case 200: return "OK";
+        case 400: return "Bad Request";
+        case 404: return "Not Found";
+        case 405: return "Method Not Allowed";
+        case 411: return "Length Required";
+        case 413: return "Content Too Large";
+        case 431: return "Request Header Fields Too Large";
+        case 501: return "Not Implemented";
+        default: return "Internal Server Error";
+    }
+}
+
+// Appends a complete response. HTTP/1.0 clients only keep the connection when they ask.
+static void appendResponse(string& out, int status, string_view body, bool keepAlive, bool http10) {
+    out += http10 ? "HTTP/1.0 " : "HTTP/1.1 ";
+    out += to_string(status);
+    out += ' ';
+    out += statusText(status);
+    out += "\r\nContent-Type: application/json\r\nContent-Length: ";
+    out += to_string(body.size());
+    if (!keepAlive) {
+        out += "\r\nConnection: close";
+    } else if (http10) {
+        out += "\r\nConnection: keep-alive";
+    }
+    if (status == 405) out += "\r\nAllow: POST";
+    out += "\r\n\r\n";
+    out += body;
+}
+
+static string errorBody(string_view message) {
+    string body = "{\"error\":";
+    appendJsonString(body, message);
+    body += '}';
+    return body;
+}
+
+// One formula's answer as server.py gives it: the full result plus "output", or just
+// the error
+static void appendItem(string& out, const NamingResult& result) {
+    if (!result.error.empty()) {
+        out += errorBody(result.error);
+        return;
+    }
+    appendJson(out, result);
+    out.pop_back();
+    out += ",\"output\":";
+    appendJsonString(out, result.name);
+    out += '}';
+}
+
+// -------------------- Naming Workers --------------------
+
+// A request being named. The formulas point into its connection's read buffer (or
+// into decoded), which is left alone until the response has been taken.
+struct Request {
+    int connection;  // Socket of the connection it came from
+    bool batch;
+    bool keepAlive;
+    bool http10;
+    vector<string_view> formulas;
+    deque<string> decoded;
+    vector<string> items;  // JSON per formula
+    atomic<size_t> pendingJobs{0};
+    string response;       // Complete HTTP response, set by the worker finishing last
+};
+
+// Worker threads naming batches of formulas. Finished requests are queued and the
+// event loop is woken through an eventfd, which the workers close once they have
+// stopped.
+class NamingWorkers {
+public:
+    NamingWorkers(const Namer& namer, unsigned count, int wakeFd);
+    ~NamingWorkers();
+
+    void submit(Request* request);
+    void takeFinished(vector<Request*>& finished);
+
+private:
+    struct Job {
+        Request* request;
+        size_t begin;
+        size_t end;
+    };
+
+    void run();
+    void finish(Request* request);
+
+    const Namer& namer;
+    int wakeFd;
+    vector<thread> threads;
+
+    mutex jobLock;
+    condition_variable jobReady;
+    deque<Job> jobs;
+    bool stopping = false;
+
+    mutex finishedLock;
+    vector<Request*> finished;
+};
+
+NamingWorkers::NamingWorkers(const Namer& namer, unsigned count, int wakeFd) : namer(namer), wakeFd(wakeFd) {
+    if (count == 0) count = max(1u, thread::hardware_concurrency());
+    for (unsigned i = 0; i < count; i++) {
+        threads.emplace_back([this] { run(); });
+    }
+}
+
+NamingWorkers::~NamingWorkers() {
+    {
+        lock_guard<mutex> lock(jobLock);
+        stopping = true;
+    }
+    jobReady.notify_all();
+    for (thread& worker : threads) worker.join();
+    ::close(wakeFd);
+}
+
+void NamingWorkers::submit(Request* request) {
+    size_t count = request->formulas.size();
+    request->items.resize(count);
+    size_t jobCount = max<size_t>(1, (count + batchGrain - 1) / batchGrain);
+    request->pendingJobs = jobCount;
+    {
+        lock_guard<mutex> lock(jobLock);
+        for (size_t job = 0; job < jobCount; job++) {
+            jobs.push_back({request, job * batchGrain, min(count, (job + 1) * batchGrain)});
+        }
+    }
+    if (jobCount == 1) {
+        jobReady.notify_one();
+    } else {
+        jobReady.notify_all();
+    }
+}
+
+void NamingWorkers::takeFinished(vector<Request*>& out) {
+    lock_guard<mutex> lock(finishedLock);
+    out.swap(finished);
+}
+
+void NamingWorkers::run() {
+    NamerScratch scratch;
+    while (true) {
+        Job job;
+        {
+            unique_lock<mutex> lock(jobLock);
+            jobReady.wait(lock, [&] { return stopping || !jobs.empty(); });
+            if (jobs.empty()) return;
+            job = jobs.front();
+            jobs.pop_front();
+        }
+
+        Request* request = job.request;
+        for (size_t i = job.begin; i < job.end; i++) {
+            NamingResult result;
+            try {
+                result = namer.name(request->formulas[i], scratch, nullptr);
+            } catch (const exception& e) {
+                result.error = e.what();
+            }
+            appendItem(request->items[i], result);
+        }
+        if (request->pendingJobs.fetch_sub(1) == 1) finish(request);
+    }
+}
+
+// Builds the response on the worker, so the event loop only has to copy it out
+void NamingWorkers::finish(Request* request) {
+    string body;
+    if (!request->batch) {
+        body = move(request->items[0]);
+    } else {
+        size_t size = 16;
+        for (const string& item : request->items) size += item.size() + 1;
+        body.reserve(size);
+        body = "{\"results\":[";
+        for (size_t i = 0; i < request->items.size(); i++) {
+            if (i) body += ',';
+            body += request->items[i];
+        }
+        body += "]}";
+    }
+    appendResponse(request->response, 200, body, request->keepAlive, request->http10);
+
+    {
+        lock_guard<mutex> lock(finishedLock);
+        finished.push_back(request);
+    }
+    uint64_t one = 1;
+    (void)!write(wakeFd, &one, sizeof(one));
+}
+
+// -------------------- Event Loop --------------------
+
+struct Connection {
+    int fd;
+    string in;               // Bytes read; the current request starts at the front
+    size_t requestBytes = 0; // Length of the request being named
+    string out;              // Response bytes not yet written
+    size_t outSent = 0;
+    bool continueSent = false;  // "100 Continue" already sent for the current request
+    bool closeAfterWrite = false;
+    bool peerClosed = false;    // Read end of file; answers still go out
+    bool failed = false;        // Socket error; nothing more is read or written
+    uint32_t interest = 0;      // Events currently registered with epoll
+    unique_ptr<Request> request;
+};
+
+static atomic<bool> stopRequested{false};
+static int signalWakeFd = -1;
+
+static void onStopSignal(int) {
+    stopRequested = true;
+    uint64_t one = 1;
+    (void)!write(signalWakeFd, &one, sizeof(one));
+}
+
+static bool equalsIgnoreCase(string_view a, string_view b) {
+    return a.size() == b.size() && equal(a.begin(), a.end(), b.begin(), [](char x, char y) { return tolower((unsigned char)x) == tolower((unsigned char)y); });
+}
+
+static string_view trim(string_view text) {
+    while (!text.empty() && (text.front() == ' ' || text.front() == '\t')) text.remove_prefix(1);
+    while (!text.empty() && (text.back() == ' ' || text.back() == '\t')) text.remove_suffix(1);
+    return text;
+}
+
+class Server {
+public:
+    Server(const Namer& namer, unsigned threads);
+    ~Server();
+
+    bool listen(const string& host, uint16_t port, string& error);
+    void run();
+
+private:
+    void accept();
+    void onReadable(Connection& connection);
+    void onWritable(Connection& connection);
+    void handleRequests(Connection& connection);
+    void reply(Connection& connection, int status, string_view body, bool keepAlive, bool http10);
+    void onFinished();
+    void flush(Connection& connection);
+    void settle(Connection& connection);
+    void close(Connection& connection);
+    void pauseAccepting();
+    void resumeAccepting();
+
+    int listenFd = -1;
+    bool accepting = false;  // listenFd is registered with epoll
+    int epollFd = -1;
+    int wakeFd = -1;
+    unordered_map<int, unique_ptr<Connection>> connections;
+    vector<Request*> finished;
+    NamingWorkers workers;
+};
+
+Server::Server(const Namer& namer, unsigned threads)
+    : epollFd(epoll_create1(EPOLL_CLOEXEC)), wakeFd(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)), workers(namer, threads, wakeFd) {
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.fd = wakeFd;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &event);
+    signalWakeFd = wakeFd;
+}
+
+Server::~Server() {
+    signalWakeFd = -1;  // The workers close it
+    for (auto& [fd, connection] : connections) ::close(fd);
+    if (listenFd != -1) ::close(listenFd);
+    ::close(epollFd);
+}
+
+bool Server::listen(const string& host, uint16_t port, string& error) {
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    if (inet_pton(AF_INET, host.c_str(), &address.sin_addr) != 1) {
+        error = "invalid IPv4 address " + host;
+        return false;
+    }
+
+    listenFd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    int on = 1;
+    setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    if (listenFd == -1 || bind(listenFd, (sockaddr*)&address, sizeof(address)) != 0 || ::listen(listenFd, SOMAXCONN) != 0) {
+        error = strerror(errno);
+        return false;
+    }
+
+    resumeAccepting();
+    return true;
+}
+
+// Out of descriptors, accept4 fails while the pending connection stays queued, so the
+// level-triggered listen socket would wake epoll_wait at once, over and over. It is
+// taken out until a connection closes, or for a second at most when none is open.
+void Server::pauseAccepting() {
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, listenFd, nullptr);
+    accepting = false;
+}
+
+void Server::resumeAccepting() {
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.fd = listenFd;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &event);
+    accepting = true;
+}
+
+void Server::run() {
+    epoll_event events[256];
+    while (!stopRequested) {
+        int ready = epoll_wait(epollFd, events, 256, accepting ? -1 : 1000);
+        if (ready < 0 && errno != EINTR) break;
+        if (ready == 0 && !accepting) resumeAccepting();
+        for (int i = 0; i < ready; i++) {
+            int fd = events[i].data.fd;
+            if (fd == listenFd) {
+                accept();
+                continue;
+            }
+            if (fd == wakeFd) {
+                uint64_t count;
+                (void)!read(wakeFd, &count, sizeof(count));
+                onFinished();
+                continue;
+            }
+
+            auto it = connections.find(fd);
+            if (it == connections.end()) continue;
+            Connection& connection = *it->second;
+            if (events[i].events & (EPOLLHUP | EPOLLERR)) {
+                close(connection);  // Both directions are gone; answers can no longer be delivered
+            } else if (events[i].events & EPOLLIN) {
+                onReadable(connection);
+            } else if (events[i].events & EPOLLOUT) {
+                onWritable(connection);
+            }
+        }
+    }
+}
+
+void Server::accept() {
+    while (true) {
+        int fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd == -1) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            if (errno == EMFILE || errno == ENFILE || errno == ENOBUFS || errno == ENOMEM) pauseAccepting();
+            return;
+        }
+        int on = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+        auto connection = make_unique<Connection>();
+        connection->fd = fd;
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.fd = fd;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event);
+        connection->interest = EPOLLIN;
+        connections[fd] = move(connection);
+    }
+}
+
+void Server::onReadable(Connection& connection) {
+    char buffer[64 * 1024];
+    while (true) {
+        ssize_t n = read(connection.fd, buffer, sizeof(buffer));
+        if (n > 0) {
+            connection.in.append(buffer, n);
+            if (n < (ssize_t)sizeof(buffer)) break;
+            continue;
+        }
+        if (n == 0) {
+            connection.peerClosed = true;
+            break;
+        }
+        if (errno == EINTR) continue;
+        if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+        connection.failed = true;
+        break;
+    }
+    handleRequests(connection);
+    settle(connection);
+}
+
+void Server::onWritable(Connection& connection) {
+    flush(connection);
+    handleRequests(connection);
+    settle(connection);
+}
+
+// Parses requests from the front of the read buffer until one goes to the workers or
+// the buffer runs out
+void Server::handleRequests(Connection& connection) {
+    while (!connection.request && !connection.closeAfterWrite && !connection.failed &&
+           connection.out.size() - connection.outSent < maxPendingOutput) {
+        string_view buffered = connection.in;
+        size_t headerEnd = buffered.find("\r\n\r\n");
+        if (headerEnd == string_view::npos) {
+            if (buffered.size() > maxHeaderBytes) reply(connection, 431, errorBody("request headers too large"), false, false);
+            return;
+        }
+
+        // Request line
+        string_view head = buffered.substr(0, headerEnd);
+        size_t lineEnd = min(head.find("\r\n"), head.size());
+        string_view line = head.substr(0, lineEnd);
+        size_t space1 = line.find(' ');
+        size_t space2 = line.rfind(' ');
+        if (space1 == string_view::npos || space2 == space1) {
+            reply(connection, 400, errorBody("malformed request line"), false, false);
+            return;
+        }
+        string_view method = line.substr(0, space1);
+        string_view target = line.substr(space1 + 1, space2 - space1 - 1);
+        string_view version = line.substr(space2 + 1);
+        bool http10 = version == "HTTP/1.0";
+        bool keepAlive = !http10;
+        target = target.substr(0, target.find('?'));
+
+        // Headers
+        size_t contentLength = 0;
+        bool hasLength = false;
+        bool expectContinue = false;
+        bool chunked = false;
+        size_t pos = lineEnd;
+        while (pos < head.size()) {
+            pos += 2;
+            size_t end = min(head.find("\r\n", pos), head.size());
+            string_view header = head.substr(pos, end - pos);
+            pos = end;
+            size_t colon = header.find(':');
+            if (colon == string_view::npos) continue;
+            string_view name = header.substr(0, colon);
+            string_view value = trim(header.substr(colon + 1));
+            if (equalsIgnoreCase(name, "Content-Length")) {
+                hasLength = !value.empty() && all_of(value.begin(), value.end(), [](char ch) { return ch >= '0' && ch <= '9'; });
+                contentLength = hasLength && value.size() < 12 ? stoul(string(value)) : maxBodyBytes + 1;
+            } else if (equalsIgnoreCase(name, "Connection")) {
+                if (equalsIgnoreCase(value, "close")) keepAlive = false;
+                if (equalsIgnoreCase(value, "keep-alive")) keepAlive = true;
+            } else if (equalsIgnoreCase(name, "Expect")) {
+                expectContinue = equalsIgnoreCase(value, "100-continue");
+            } else if (equalsIgnoreCase(name, "Transfer-Encoding")) {
+                chunked = !equalsIgnoreCase(value, "identity");
+            }
+        }
+
+        if (chunked) {
+            reply(connection, 501, errorBody("chunked request bodies are not supported"), false, http10);
+            return;
+        }
+        if (method == "POST" && !hasLength) {
+            reply(connection, 411, errorBody("Content-Length is required"), false, http10);
+            return;
+        }
+        if (contentLength > maxBodyBytes) {
+            reply(connection, 413, errorBody("request body too large"), false, http10);
+            return;
+        }
+
+        size_t requestBytes = headerEnd + 4 + contentLength;
+        if (buffered.size() < requestBytes) {
+            if (expectContinue && !connection.continueSent) {
+                connection.out += "HTTP/1.1 100 Continue\r\n\r\n";
+                connection.continueSent = true;
+                flush(connection);
+            }
+            return;
+        }
+        connection.continueSent = false;
+        string_view body = buffered.substr(headerEnd + 4, contentLength);
+
+        bool batch = target == "/get_iupac_batch";
+        if (!batch && target != "/get_iupac") {
+            connection.in.erase(0, requestBytes);
+            reply(connection, 404, errorBody("not found"), keepAlive, http10);
+            continue;
+        }
+        if (method != "POST") {
+            connection.in.erase(0, requestBytes);
+            reply(connection, 405, errorBody("method not allowed"), keepAlive, http10);
+            continue;
+        }
+
+        auto request = make_unique<Request>();
+        request->connection = connection.fd;
+        request->batch = batch;
+        request->keepAlive = keepAlive;
+        request->http10 = http10;
+        if (const char* error = readFormulas(body, batch, request->formulas, request->decoded)) {
+            connection.in.erase(0, requestBytes);
+            reply(connection, 400, errorBody(error), keepAlive, http10);
+            continue;
+        }
+        if (request->formulas.empty()) {
+            connection.in.erase(0, requestBytes);
+            reply(connection, 200, "{\"results\":[]}", keepAlive, http10);
+            continue;
+        }
+
+        connection.requestBytes = requestBytes;
+        connection.request = move(request);
+        workers.submit(connection.request.get());
+    }
+}
+
+void Server::reply(Connection& connection, int status, string_view body, bool keepAlive, bool http10) {
+    appendResponse(connection.out, status, body, keepAlive, http10);
+    if (!keepAlive) connection.closeAfterWrite = true;
+    flush(connection);
+}
+
+void Server::onFinished() {
+    workers.takeFinished(finished);
+    for (Request* request : finished) {
+        auto it = connections.find(request->connection);
+        Connection& connection = *it->second;
+        unique_ptr<Request> owned = move(connection.request);
+        if (!connection.failed) {
+            connection.out += request->response;
+            connection.in.erase(0, connection.requestBytes);
+            connection.requestBytes = 0;
+            if (!request->keepAlive) connection.closeAfterWrite = true;
+            owned.reset();
+            flush(connection);
+            handleRequests(connection);
+        }
+        settle(connection);
+    }
+    finished.clear();
+}
+
+// Writes as much pending output as the socket takes
+void Server::flush(Connection& connection) {
+    while (!connection.failed && connection.outSent < connection.out.size()) {
+        ssize_t n = send(connection.fd, connection.out.data() + connection.outSent, connection.out.size() - connection.outSent, MSG_NOSIGNAL);
+        if (n > 0) {
+            connection.outSent += n;
+        } else if (n < 0 && errno == EINTR) {
+            continue;
+        } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return;
+        } else {
+            connection.failed = true;
+        }
+    }
+    if (connection.outSent == connection.out.size()) {
+        connection.out.clear();
+        connection.outSent = 0;
+    }
+}
+
+// After each event: closes the connection when it is done or broken, otherwise
+// registers for what it waits on next. The connection may be gone afterwards.
+void Server::settle(Connection& connection) {
+    bool drained = connection.out.empty();
+    if (connection.failed || (drained && !connection.request && (connection.closeAfterWrite || connection.peerClosed))) {
+        close(connection);
+        return;
+    }
+
+    uint32_t interest = 0;
+    bool canRead = !connection.request && !connection.closeAfterWrite && !connection.peerClosed &&
+                   connection.out.size() - connection.outSent < maxPendingOutput;
+    if (canRead) interest |= EPOLLIN;
+    if (connection.outSent < connection.out.size()) interest |= EPOLLOUT;
+    if (interest == connection.interest) return;
+
+    epoll_event event{};
+    event.events = interest;
+    event.data.fd = connection.fd;
+    epoll_ctl(epollFd, EPOLL_CTL_MOD, connection.fd, &event);
+    connection.interest = interest;
+}
+
+// A connection with a request on the workers is only unregistered; it is closed when
+// the request comes back, since the workers still read its buffer
+void Server::close(Connection& connection) {
+    if (connection.interest != ~0u) epoll_ctl(epollFd, EPOLL_CTL_DEL, connection.fd, nullptr);
+    connection.interest = ~0u;
+    if (connection.request) {
+        connection.failed = true;
+        return;
+    }
+    int fd = connection.fd;
+    ::close(fd);
+    connections.erase(fd);
+    if (!accepting && listenFd != -1) resumeAccepting();
+}
+
+// -------------------- Main Code --------------------
+
+int main(int argc, char* argv[]) {
+    string host = "127.0.0.1";
+    uint16_t port = 8080;
+    unsigned threads = 0;
+    string cacheFile;
+    NamerOptions options;
+    options.cacheCapacity = 10000;
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--host" && i + 1 < argc) {
+            host = argv[++i];
+        } else if (arg == "--port" && i + 1 < argc) {
+            port = stoi(argv[++i]);
+        } else if (arg == "--threads" && i + 1 < argc) {
+            threads = stoul(argv[++i]);
+        } else if (arg == "--cache" && i + 1 < argc) {
+            options.cacheCapacity = stoul(argv[++i]);
+        } else if (arg == "--cache-file" && i + 1 < argc) {
+            cacheFile = argv[++i];
+        } else if (arg == "--smiles") {
+            options.smiles = true;
+        } else {
+            cerr << "Usage: service [--host ADDR] [--port N] [--threads N] [--cache N] [--cache-file PATH] [--smiles]" << endl;
+            return 1;
+        }
+    }
+    if (!cacheFile.empty() && options.cacheCapacity == 0) {
+        options.cacheCapacity = 100000;
+    }
+
+    Namer namer(options);
+    if (!cacheFile.empty()) {
+        string error;
+        if (!namer.getCache()->load(cacheFile, error) && !error.empty()) {
+            cerr << "Ignoring name cache " << cacheFile << ": " << error << endl;
+        }
+    }
+
+    string error;
+    {
+        Server server(namer, threads);
+        if (!server.listen(host, port, error)) {
+            cerr << "Could not listen on " << host << ":" << port << ": " << error << endl;
+            return 1;
+        }
+        signal(SIGINT, onStopSignal);
+        signal(SIGTERM, onStopSignal);
+        signal(SIGPIPE, SIG_IGN);
+        cerr << "Listening on " << host << ":" << port << endl;
+        server.run();
+    }
+
+    if (!cacheFile.empty() && !namer.getCache()->save(cacheFile)) {
+        cerr << "Could not write name cache to " << cacheFile << endl;
+    }
+    return 0;
+}
@@ -0,0 +1,692 @@
+#include "session.h"
+
+#include <algorithm>
+
+using namespace std;
+
+static const char* const notConnected = "structure is not connected";
+
+MoleculeSession::MoleculeSession(NamerOptions options) : options(options) {}
+
+ParseError MoleculeSession::load(string_view formula) {
+    ParseError error = fullGraph.parseMolecularFormula(formula);
+    if (error) return error;
+
+    clear();
+    for (int atom = 0; atom < fullGraph.atomCount(); atom++) {
+        addAtom(fullGraph.element[atom]);
+    }
+    for (auto [atom1, atom2] : fullGraph.edges) {
+        adjacency[atom1].push_back(atom2);
+        adjacency[atom2].push_back(atom1);
+        bondCount++;
+    }
+    return {};
+}
+
+void MoleculeSession::clear() {
+    element.clear();
+    alive.clear();
+    adjacency.clear();
+    freeIds.clear();
+    liveAtoms = 0;
+    bondCount = 0;
+
+    indexed = false;
+    isolated = 0;
+    anchor = -1;
+    chain.clear();
+    chainSlot.clear();
+    chainFront = 0;
+    rootCount.clear();
+    substitutedSlots.clear();
+    branchRoot.clear();
+    towardChain.clear();
+    depth.clear();
+    extendsChain.clear();
+    branchCarbons.clear();
+    branchHalogens.clear();
+    deepestAtom.clear();
+    branchName.clear();
+    branchNamed.clear();
+    shapesKnown.clear();
+    atomShape.clear();
+    reachFront.clear();
+    reachBack.clear();
+    reachDepth.clear();
+    reachSlot.clear();
+    named = false;
+}
+
+// ----- Edits -----
+
+int MoleculeSession::addAtom(Element code) {
+    int atom;
+    if (!freeIds.empty()) {
+        atom = freeIds.back();
+        freeIds.pop_back();
+    } else {
+        atom = element.size();
+        element.push_back(code);
+        alive.push_back(0);
+        adjacency.emplace_back();
+        chainSlot.push_back(offChain);
+        rootCount.push_back(0);
+        branchRoot.push_back(-1);
+        towardChain.push_back(-1);
+        depth.push_back(0);
+        extendsChain.push_back(0);
+        branchCarbons.push_back(0);
+        branchHalogens.push_back({});
+        deepestAtom.push_back(-1);
+        branchName.emplace_back();
+        branchNamed.push_back(0);
+        shapesKnown.push_back(0);
+        atomShape.push_back(-1);
+        reachDepth.push_back(-1);
+        reachSlot.push_back(0);
+    }
+    element[atom] = code;
+    alive[atom] = 1;
+    chainSlot[atom] = offChain;
+    branchRoot[atom] = -1;
+
+    liveAtoms++;
+    if (indexed) isolated++;
+    named = false;
+    return atom;
+}
+
+const char* MoleculeSession::removeAtom(int atom) {
+    if (!hasAtom(atom)) return "no such atom";
+
+    if (adjacency[atom].size() == 1) {
+        int neighbor = adjacency[atom][0];
+        unlink(atom, neighbor);
+        bondCount--;
+        if (indexed) detachLeaf(neighbor, atom);
+    } else if (!adjacency[atom].empty()) {
+        while (!adjacency[atom].empty()) {
+            unlink(atom, adjacency[atom].back());
+            bondCount--;
+        }
+        indexed = false;
+    }
+
+    // The atom has no bonds left; if it was the whole chain there is nothing to keep
+    if (indexed) {
+        if (onChain(atom)) {
+            indexed = false;
+        } else {
+            isolated--;
+        }
+    }
+    alive[atom] = 0;
+    freeIds.push_back(atom);
+    liveAtoms--;
+    named = false;
+    return nullptr;
+}
+
+const char* MoleculeSession::addBond(int atom1, int atom2) {
+    if (!hasAtom(atom1) || !hasAtom(atom2)) return "no such atom";
+    if (atom1 == atom2) return "an atom cannot bond to itself";
+    if (find(adjacency[atom1].begin(), adjacency[atom1].end(), atom2) != adjacency[atom1].end()) {
+        return "the atoms are already bonded";
+    }
+    if ((int)adjacency[atom1].size() >= maxBonds(element[atom1]) || (int)adjacency[atom2].size() >= maxBonds(element[atom2])) {
+        return "too many bonds on this atom";
+    }
+
+    // Bonding a loose atom to the tree grows it by one leaf; anything else is re-indexed
+    auto loose = [&](int atom) { return adjacency[atom].empty() && !onChain(atom); };
+    bool attach1 = indexed && loose(atom1) && !loose(atom2);
+    bool attach2 = indexed && loose(atom2) && !loose(atom1);
+
+    adjacency[atom1].push_back(atom2);
+    adjacency[atom2].push_back(atom1);
+    bondCount++;
+    named = false;
+
+    if (attach1) {
+        attachLeaf(atom2, atom1);
+    } else if (attach2) {
+        attachLeaf(atom1, atom2);
+    } else {
+        indexed = false;
+    }
+    return nullptr;
+}
+
+const char* MoleculeSession::removeBond(int atom1, int atom2) {
+    if (!hasAtom(atom1) || !hasAtom(atom2)) return "no such atom";
+    if (find(adjacency[atom1].begin(), adjacency[atom1].end(), atom2) == adjacency[atom1].end()) {
+        return "the atoms are not bonded";
+    }
+
+    // Prefer letting go of an off-chain leaf, then a chain end
+    int leaf = -1;
+    for (int pass = 0; pass < 2 && leaf == -1; pass++) {
+        for (int atom : {atom2, atom1}) {
+            if (leaf == -1 && adjacency[atom].size() == 1 && (pass == 1 || !onChain(atom))) leaf = atom;
+        }
+    }
+
+    unlink(atom1, atom2);
+    bondCount--;
+    named = false;
+
+    if (!indexed) return nullptr;
+    if (leaf == -1) {
+        indexed = false;
+    } else {
+        detachLeaf(leaf == atom1 ? atom2 : atom1, leaf);
+    }
+    return nullptr;
+}
+
+void MoleculeSession::unlink(int atom1, int atom2) {
+    adjacency[atom1].erase(find(adjacency[atom1].begin(), adjacency[atom1].end(), atom2));
+    adjacency[atom2].erase(find(adjacency[atom2].begin(), adjacency[atom2].end(), atom1));
+}
+
+// ----- Incremental index -----
+
+// leaf was loose and is now bonded to atom, which is on the tree
+void MoleculeSession::attachLeaf(int atom, int leaf) {
+    isolated--;
+    if (element[leaf] == Element::COOH) {
+        indexed = false;  // The chain has to start from the acid now
+        return;
+    }
+
+    bool rooted = onChain(atom);
+    int root = rooted ? leaf : branchRoot[atom];
+    branchRoot[leaf] = root;
+    towardChain[leaf] = atom;
+    depth[leaf] = rooted ? 1 : depth[atom] + 1;
+    extendsChain[leaf] = isChainAtom(element[leaf]) && (rooted || extendsChain[atom]);
+
+    if (rooted) {
+        branchCarbons[root] = 0;
+        branchHalogens[root] = {};
+        shapesKnown[root] = 0;
+        deepestAtom[root] = -1;
+        addRoot(root);
+    }
+    if (element[leaf] == Element::C) branchCarbons[root]++;
+    if (int type = halogenType(element[leaf])) branchHalogens[root][type]++;
+    branchNamed[root] = 0;
+    if (!rooted) reshape(leaf, root);
+
+    int deepest = deepestAtom[root];
+    if (extendsChain[leaf] && (deepest == -1 || depth[leaf] > depth[deepest])) {
+        deepestAtom[root] = leaf;
+        updateReach(root);
+        checkLongerChain();
+    }
+}
+
+// leaf was bonded to atom and is now loose
+void MoleculeSession::detachLeaf(int atom, int leaf) {
+    isolated++;
+    if (!onChain(leaf)) {
+        // Losing a branch atom cannot lengthen any path, so the chain stays longest
+        int root = branchRoot[leaf];
+        if (root == leaf) {
+            dropRoot(root);  // The whole branch went with it
+        } else {
+            if (element[leaf] == Element::C) branchCarbons[root]--;
+            if (int type = halogenType(element[leaf])) branchHalogens[root][type]--;
+            branchNamed[root] = 0;
+            reshape(atom, root);
+            if (deepestAtom[root] == leaf) indexBranch(towardChain[root], root);
+        }
+        branchRoot[leaf] = -1;
+        return;
+    }
+
+    if (leaf == anchor || chain.size() == 1 || !onChain(atom)) {
+        indexed = false;
+        return;
+    }
+
+    // A chain end came off. The chain is one shorter unless some branch now reaches as far.
+    if (chain.front() == leaf) {
+        chain.pop_front();
+        chainFront++;
+    } else {
+        chain.pop_back();
+    }
+    chainSlot[leaf] = offChain;
+    checkLongerChain();
+}
+
+// Walks the branch that starts at root (bonded to chainAtom) and rebuilds its summary
+void MoleculeSession::indexBranch(int chainAtom, int root) {
+    branchCarbons[root] = 0;
+    branchHalogens[root] = {};
+    branchNamed[root] = 0;
+    shapesKnown[root] = 0;
+    deepestAtom[root] = -1;
+    towardChain[root] = chainAtom;
+    depth[root] = 1;
+    extendsChain[root] = isChainAtom(element[root]);
+
+    toVisit.assign(1, root);
+    while (!toVisit.empty()) {
+        int atom = toVisit.back();
+        toVisit.pop_back();
+
+        branchRoot[atom] = root;
+        if (element[atom] == Element::C) branchCarbons[root]++;
+        if (int type = halogenType(element[atom])) branchHalogens[root][type]++;
+        int deepest = deepestAtom[root];
+        if (extendsChain[atom] && (deepest == -1 || depth[atom] > depth[deepest])) deepestAtom[root] = atom;
+
+        for (int neighbor : adjacency[atom]) {
+            if (neighbor == towardChain[atom]) continue;
+            towardChain[neighbor] = atom;
+            depth[neighbor] = depth[atom] + 1;
+            extendsChain[neighbor] = extendsChain[atom] && isChainAtom(element[neighbor]);
+            toVisit.push_back(neighbor);
+        }
+    }
+    updateReach(root);
+}
+
+// Registers root as a branch of the chain atom it is bonded to
+void MoleculeSession::addRoot(int root) {
+    int chainAtom = towardChain[root];
+    if (rootCount[chainAtom]++ == 0) substitutedSlots.insert(chainSlot[chainAtom]);
+}
+
+// Unregisters root while its chain atom is still on the chain
+void MoleculeSession::dropRoot(int root) {
+    int chainAtom = towardChain[root];
+    if (--rootCount[chainAtom] == 0) substitutedSlots.erase(chainSlot[chainAtom]);
+    deepestAtom[root] = -1;
+    updateReach(root);
+}
+
+void MoleculeSession::updateReach(int root) {
+    if (reachDepth[root] >= 0) {
+        reachFront.erase({reachDepth[root] + reachSlot[root], root});
+        reachBack.erase({reachDepth[root] - reachSlot[root], root});
+        reachDepth[root] = -1;
+    }
+    if (deepestAtom[root] == -1) return;
+
+    reachDepth[root] = depth[deepestAtom[root]];
+    reachSlot[root] = chainSlot[towardChain[root]];
+    reachFront.insert({reachDepth[root] + reachSlot[root], root});
+    reachBack.insert({reachDepth[root] - reachSlot[root], root});
+}
+
+// Walks every branch of chainAtom that is not already indexed as hanging off it
+void MoleculeSession::indexBranchesOf(int chainAtom) {
+    for (int neighbor : adjacency[chainAtom]) {
+        if (!onChain(neighbor) && (branchRoot[neighbor] != neighbor || towardChain[neighbor] != chainAtom)) {
+            indexBranch(chainAtom, neighbor);
+            addRoot(neighbor);
+        }
+    }
+}
+
+// In a tree the atom farthest from any atom is an end of a longest path, so a longer
+// chain, if there is one, runs from the deepest atom of some branch to one chain end:
+// the front end at depth + position, the back end at depth + (last - position)
+void MoleculeSession::checkLongerChain() {
+    int last = chain.size() - 1;
+    int bestReach = last;
+    int bestRoot = -1;
+    bool keepFront = true;
+    if (!reachFront.empty()) {
+        auto [key, root] = *reachFront.rbegin();
+        if (key - chainFront > bestReach) {
+            bestReach = key - chainFront;
+            bestRoot = root;
+        }
+    }
+    if (anchor == -1 && !reachBack.empty()) {
+        auto [key, root] = *reachBack.rbegin();
+        if (last + key + chainFront > bestReach) {
+            bestReach = last + key + chainFront;
+            bestRoot = root;
+            keepFront = false;
+        }
+    }
+    if (bestRoot != -1) extendChain(towardChain[bestRoot], deepestAtom[bestRoot], keepFront);
+}
+
+// Reroutes the chain from foot out to tip, an atom in one of foot's branches. The chain
+// on the kept side of foot stays where it is; the other side leaves the chain and is
+// walked again as a branch of foot, as are the branches along the new stretch.
+void MoleculeSession::extendChain(int foot, int tip, bool keepFront) {
+    vector<int> path;  // tip ... the branch root
+    for (int atom = tip; atom != foot; atom = towardChain[atom]) {
+        path.push_back(atom);
+    }
+    dropRoot(path.back());
+
+    auto release = [&](int atom) {
+        for (int neighbor : adjacency[atom]) {
+            if (!onChain(neighbor) && branchRoot[neighbor] == neighbor && towardChain[neighbor] == atom) dropRoot(neighbor);
+        }
+        chainSlot[atom] = offChain;
+        branchRoot[atom] = -1;
+    };
+    if (keepFront) {
+        while (chain.back() != foot) {
+            release(chain.back());
+            chain.pop_back();
+        }
+        for (auto atom = path.rbegin(); atom != path.rend(); ++atom) {
+            chainSlot[*atom] = chainFront + chain.size();
+            chain.push_back(*atom);
+        }
+    } else {
+        while (chain.front() != foot) {
+            release(chain.front());
+            chain.pop_front();
+            chainFront++;
+        }
+        for (auto atom = path.rbegin(); atom != path.rend(); ++atom) {
+            chainSlot[*atom] = --chainFront;
+            chain.push_front(*atom);
+        }
+    }
+
+    for (int atom : path) {
+        branchRoot[atom] = -1;
+    }
+    indexBranchesOf(foot);
+    for (int atom : path) {
+        indexBranchesOf(atom);
+    }
+}
+
+// Walks out from start over every atom, or chain atoms only. Returns the farthest atom;
+// walkParent leads back to start and visited counts the atoms reached.
+int MoleculeSession::walkFrom(int start, bool chainOnly, int& visited) {
+    walkParent.assign(element.size(), -1);
+    walkDepth.assign(element.size(), -1);
+    toVisit.assign(1, start);
+    walkDepth[start] = 0;
+    int farthest = start;
+    visited = 0;
+
+    while (!toVisit.empty()) {
+        int atom = toVisit.back();
+        toVisit.pop_back();
+        visited++;
+        if (walkDepth[atom] > walkDepth[farthest]) farthest = atom;
+
+        for (int neighbor : adjacency[atom]) {
+            if (walkDepth[neighbor] == -1 && (!chainOnly || isChainAtom(element[neighbor]))) {
+                walkDepth[neighbor] = walkDepth[atom] + 1;
+                walkParent[neighbor] = atom;
+                toVisit.push_back(neighbor);
+            }
+        }
+    }
+    return farthest;
+}
+
+// Indexes the molecule from scratch. Fails (leaving the full pass to name it) unless it
+// is one tree with a carbon and at most one COOH, plus atoms without bonds.
+bool MoleculeSession::rebuildIndex() {
+    indexed = false;
+    chain.clear();
+    chainFront = 0;
+    fill(chainSlot.begin(), chainSlot.end(), offChain);
+    fill(rootCount.begin(), rootCount.end(), 0);
+    fill(branchRoot.begin(), branchRoot.end(), -1);
+    fill(reachDepth.begin(), reachDepth.end(), -1);
+    substitutedSlots.clear();
+    reachFront.clear();
+    reachBack.clear();
+
+    anchor = -1;
+    int start = -1;
+    for (int atom = 0; atom < (int)element.size(); atom++) {
+        if (!alive[atom]) continue;
+        if (element[atom] == Element::COOH) {
+            if (anchor != -1) return false;
+            anchor = atom;
+        }
+        if (start == -1 && isChainAtom(element[atom])) start = atom;
+    }
+    if (start == -1) return false;
+    if (anchor != -1) start = anchor;
+
+    // Connected with one bond fewer than atoms is a tree, and leaves no bond elsewhere
+    int visited = 0;
+    walkFrom(start, false, visited);
+    if (bondCount != visited - 1) return false;
+    isolated = liveAtoms - visited;
+
+    // Same double sweep as the chain engine; with an acid the chain runs from it
+    int first = anchor != -1 ? anchor : walkFrom(start, true, visited);
+    int end = walkFrom(first, true, visited);
+    for (int atom = end; atom != -1; atom = walkParent[atom]) {
+        chain.push_front(atom);
+    }
+    for (size_t i = 0; i < chain.size(); i++) {
+        chainSlot[chain[i]] = i;
+    }
+    for (int atom : chain) {
+        indexBranchesOf(atom);
+    }
+    indexed = true;
+    return true;
+}
+
+// ----- Naming -----
+
+const NamingResult& MoleculeSession::name() {
+    if (named) return result;
+    named = true;
+    result = NamingResult();
+
+    if (!indexed) rebuildIndex();
+    if (!indexed) {
+        nameFullPass();
+    } else if (isolated > 0) {
+        result.error = notConnected;
+    } else {
+        nameFromIndex();
+    }
+    return result;
+}
+
+// Shape of the skeleton from atom away from the chain, from the shapes of the atoms
+// below it
+int MoleculeSession::shapeBelow(int atom) {
+    if (element[atom] != Element::C) return -1;
+    int children[3];
+    int count = 0;
+    for (int neighbor : adjacency[atom]) {
+        if (neighbor == towardChain[atom]) continue;
+        if (atomShape[neighbor] == -1 || count == 3) return -1;
+        children[count++] = atomShape[neighbor];
+    }
+    return scratch.branchNamer.intern(children, count);
+}
+
+// atom in root's branch is new or lost a leaf: its shape is worked out again, and
+// those above it up to the first one that comes out the same
+void MoleculeSession::reshape(int atom, int root) {
+    if (!shapesKnown[root] || shapeGeneration != scratch.branchNamer.generation()) return;
+    atomShape[atom] = shapeBelow(atom);
+    while (atom != root) {
+        atom = towardChain[atom];
+        int shape = shapeBelow(atom);
+        if (shape == atomShape[atom]) return;
+        atomShape[atom] = shape;
+    }
+}
+
+// Name of the branch starting at root, worked out as analyzeBranches does: the carbon
+// skeleton is interned bottom-up, anything else gets the legacy name. Kept until an
+// edit touches the branch; the shapes are kept too, so after a leaf edit only the
+// atoms above it are interned again.
+string_view MoleculeSession::nameBranch(int root) {
+    if (branchNamed[root]) return branchName[root];
+
+    if (!shapesKnown[root]) {
+        vector<int>& order = scratch.branchOrder;
+        order.clear();
+        toVisit.assign(1, root);
+        while (!toVisit.empty()) {
+            int atom = toVisit.back();
+            toVisit.pop_back();
+            order.push_back(atom);
+            for (int neighbor : adjacency[atom]) {
+                if (neighbor != towardChain[atom]) toVisit.push_back(neighbor);
+            }
+        }
+        for (size_t i = order.size(); i-- > 0;) {
+            atomShape[order[i]] = shapeBelow(order[i]);
+        }
+        shapesKnown[root] = 1;
+    }
+
+    int shape = atomShape[root];
+    if (shape >= 0) {
+        branchName[root] = scratch.branchNamer.shapeName(shape);
+    } else {
+        int type = 0;
+        for (int t = 1; t < 5 && type == 0; t++) {
+            if (branchHalogens[root][t] > 0) type = t;
+        }
+        branchName[root] = scratch.branchNamer.legacyName(branchCarbons[root], type);
+    }
+    branchNamed[root] = 1;
+    return branchName[root];
+}
+
+// Whether another chain as long as the kept one might name differently. A branch as
+// deep as the chain segment beyond its foot makes one (the keys checkLongerChain
+// reads); swapping them changes nothing when the branch is a bare alkyl and the
+// segment carries no substituents, which covers the common 2-methyl ends.
+bool MoleculeSession::tiedChainDiffers() const {
+    int last = chain.size() - 1;
+    auto bare = [&](int root) {
+        return branchCarbons[root] == depth[deepestAtom[root]] && branchHalogens[root] == array<int, 5>{};
+    };
+    for (auto it = reachFront.rbegin(); it != reachFront.rend() && it->first - chainFront >= last; ++it) {
+        if (!bare(it->second) || *substitutedSlots.rbegin() != reachSlot[it->second]) return true;
+    }
+    if (anchor != -1) return false;
+    for (auto it = reachBack.rbegin(); it != reachBack.rend() && it->first + chainFront >= 0; ++it) {
+        if (!bare(it->second) || *substitutedSlots.begin() != reachSlot[it->second]) return true;
+    }
+    return false;
+}
+
+void MoleculeSession::nameFromIndex() {
+    // Picking among tied chains, and between numberings whose locants tie, takes the
+    // namer's full comparison (findParentChain, betterNumbering)
+    if (tiedChainDiffers()) {
+        nameFullPass();
+        return;
+    }
+
+    int length = chain.size();
+    scratch.branchNamer.trim();
+    if (shapeGeneration != scratch.branchNamer.generation()) {
+        shapeGeneration = scratch.branchNamer.generation();
+        fill(shapesKnown.begin(), shapesKnown.end(), 0);
+    }
+    scratch.arena.reset();
+    pmr::vector<ChainSubstituent> substituents(&scratch.arena);
+    for (int slot : substitutedSlots) {
+        int atom = chain[slot - chainFront];
+        for (int neighbor : adjacency[atom]) {
+            if (!onChain(neighbor)) substituents.push_back({slot - chainFront + 1, nameBranch(neighbor)});
+        }
+    }
+
+    // Number from whichever end gives the lower locants; the acid is always locant 1.
+    // Substituents are in chain order, so the locants from the far end come reversed.
+    // When they tie, names decide, as in the full pass.
+    bool reversed = false;
+    if (anchor == -1) {
+        size_t count = substituents.size();
+        bool decided = false;
+        for (size_t i = 0; i < count && !decided; i++) {
+            int fromStart = substituents[i].locant;
+            int fromEnd = length + 1 - substituents[count - 1 - i].locant;
+            if (fromStart != fromEnd) {
+                reversed = fromEnd < fromStart;
+                decided = true;
+            }
+        }
+        if (!decided && count > 0) {
+            nameFullPass();
+            return;
+        }
+    }
+    if (reversed) {
+        reverse(substituents.begin(), substituents.end());
+        for (ChainSubstituent& substituent : substituents) {
+            substituent.locant = length + 1 - substituent.locant;
+        }
+    }
+
+    // Same order as the full pass: by locant, then alphabetical on each atom
+    sort(substituents.begin(), substituents.end(), [](const ChainSubstituent& a, const ChainSubstituent& b) {
+        return a.locant != b.locant ? a.locant < b.locant : alphabeticallyBefore(a.name, b.name);
+    });
+    result.chain.assign(chain.begin(), chain.end());
+    if (reversed) reverse(result.chain.begin(), result.chain.end());
+    result.substituents.reserve(substituents.size());
+    for (const ChainSubstituent& substituent : substituents) {
+        result.substituents.push_back({substituent.locant, string(substituent.name)});
+    }
+    result.name = generateIUPACName(move(substituents), length, anchor != -1 ? 1 : 0);
+    if (anchor != -1) result.name += "oic acid";
+}
+
+void MoleculeSession::nameFullPass() {
+    if (liveAtoms > 1) {
+        int start = 0;
+        while (!alive[start]) start++;
+        int visited = 0;
+        walkFrom(start, false, visited);
+        if (visited != liveAtoms) {
+            result.error = notConnected;
+            return;
+        }
+    }
+
+    exportGraph(fullGraph, fullGraphIds);
+    result = processMolecularGraph(fullGraph, 0, scratch, options, nullptr);
+    for (int& atom : result.chain) {
+        atom = fullGraphIds[atom];
+    }
+}
+
+void MoleculeSession::exportGraph(MolecularGraph& graph, vector<int>& graphIds) const {
+    graph.clear();
+    graphIds.clear();
+    vector<int> graphId(element.size(), -1);
+    for (int atom = 0; atom < (int)element.size(); atom++) {
+        if (alive[atom]) {
+            graphId[atom] = graph.addAtom(element[atom]);
+            graphIds.push_back(atom);
+        }
+    }
+    for (int atom : graphIds) {
+        for (int neighbor : adjacency[atom]) {
+            if (atom < neighbor) graph.addEdge(graphId[atom], graphId[neighbor]);
+        }
+    }
+    for (int atom = 0; atom < graph.atomCount(); atom++) {
+        if (graph.element[atom] == Element::C) {
+            graph.C_H_bonds[atom] = max(0, 4 - graph.C_C_bonds[atom] - graph.C_X_bonds[atom]);
+        }
+    }
+    graph.finalize();
+}
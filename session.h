@@ -0,0 +1,138 @@
+#pragma once
+
+#include <array>
+#include <climits>
+#include <deque>
+#include <set>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "molecule.h"
+#include "namer.h"
+
+// Editable molecule for interactive use: atoms and bonds are added and removed one at
+// a time and name() follows the current structure.
+//
+// While the molecule is a tree (plus atoms not bonded yet), the session keeps the
+// longest chain, a summary of every branch hanging off it, and the reach of each
+// branch's deepest carbon up to date as edits arrive. Attaching or detaching a leaf
+// touches the branch it belongs to and, when the longest chain changes, only the
+// segments that move; renaming then walks the substituted chain atoms, not the chain.
+// Other edits (bonds between atoms already placed, removing an inner atom) drop the
+// index, which is rebuilt on the next name(); rings are named by a full
+// processMolecularGraph pass, and so are trees where another chain ties with the kept
+// one and might name differently, or where the locants tie both ways.
+class MoleculeSession {
+public:
+    explicit MoleculeSession(NamerOptions options = {});
+
+    // Replaces the session with a parsed formula; atom ids follow the formula order
+    ParseError load(std::string_view formula);
+    void clear();
+
+    // Atom ids stay fixed while the atom exists; ids of removed atoms are reused.
+    // The other edits return null on success, otherwise why they were refused.
+    int addAtom(Element code);
+    const char* removeAtom(int atom);
+    const char* addBond(int atom1, int atom2);
+    const char* removeBond(int atom1, int atom2);
+
+    bool hasAtom(int atom) const { return atom >= 0 && atom < (int)element.size() && alive[atom]; }
+    int atomCount() const { return liveAtoms; }
+    const std::vector<int>& neighbors(int atom) const { return adjacency[atom]; }
+
+    // Name of the current structure; chain atoms are session ids
+    const NamingResult& name();
+
+    // Snapshot as a MolecularGraph with hydrogens filled in. Graph atom i is session
+    // atom graphIds[i].
+    void exportGraph(MolecularGraph& graph, std::vector<int>& graphIds) const;
+
+private:
+    static constexpr int offChain = INT_MIN;
+
+    bool onChain(int atom) const { return chainSlot[atom] != offChain; }
+    int position(int atom) const { return chainSlot[atom] - chainFront; }
+
+    void unlink(int atom1, int atom2);
+    void attachLeaf(int atom, int leaf);
+    void detachLeaf(int atom, int leaf);
+    void indexBranch(int chainAtom, int root);
+    void addRoot(int root);
+    void dropRoot(int root);
+    void updateReach(int root);
+    void indexBranchesOf(int chainAtom);
+    void checkLongerChain();
+    void extendChain(int foot, int tip, bool keepFront);
+    int walkFrom(int start, bool chainOnly, int& visited);
+    bool rebuildIndex();
+    int shapeBelow(int atom);
+    void reshape(int atom, int root);
+    std::string_view nameBranch(int root);
+    bool tiedChainDiffers() const;
+    void nameFromIndex();
+    void nameFullPass();
+
+    NamerOptions options;
+
+    // Atom table by session id; removed atoms stay dead until their id is reused
+    std::vector<Element> element;
+    std::vector<char> alive;
+    std::vector<std::vector<int>> adjacency;  // In bond order, like the CSR of a parsed graph
+    std::vector<int> freeIds;
+    int liveAtoms = 0;
+    int bondCount = 0;
+
+    // Incremental index. While indexed is set the molecule is one tree holding the
+    // chain, plus `isolated` atoms without bonds.
+    bool indexed = false;
+    int isolated = 0;
+    int anchor = -1;  // COOH atom the chain starts from, or -1
+
+    // The longest chain; numbering direction is picked when naming. A chain atom's slot
+    // is its position plus chainFront, so growing or trimming either end moves no slots.
+    std::deque<int> chain;
+    std::vector<int> chainSlot;  // offChain for atoms off the chain
+    int chainFront = 0;
+    std::vector<int> rootCount;          // Per chain atom: branches hanging off it
+    std::set<int> substitutedSlots;      // Slots of chain atoms with branches
+
+    // Off-chain atoms: the branch they belong to and their place in it
+    std::vector<int> branchRoot;      // Atom bonded to the chain that starts the branch
+    std::vector<int> towardChain;     // Neighbour one bond closer to the chain
+    std::vector<int> depth;           // Bonds from the chain
+    std::vector<char> extendsChain;   // Reached from the chain through chain atoms only
+
+    // Per branch root: what the branch holds and its deepest chain-capable atom
+    std::vector<int> branchCarbons;
+    std::vector<std::array<int, 5>> branchHalogens;  // Count per halogen type
+    std::vector<int> deepestAtom;                    // -1 when no atom could extend the chain
+    std::vector<std::string> branchName;             // Valid while branchNamed is set
+    std::vector<char> branchNamed;
+    std::vector<char> shapesKnown;                   // atomShape is current for the branch
+
+    // Off-chain atoms: BranchNamer shape of the skeleton from the atom away from the
+    // chain, -1 when it holds anything but carbon. Only meaningful while the branch's
+    // shapesKnown is set and the namer is still at shapeGeneration.
+    std::vector<int> atomShape;
+    unsigned shapeGeneration = 0;
+
+    // Reach of every branch with a deepestAtom, keyed so that chain slots cancel out:
+    // depth + slot gives the path to the front end, depth - slot the one to the back
+    std::set<std::pair<int, int>> reachFront;  // (depth + slot, root)
+    std::set<std::pair<int, int>> reachBack;   // (depth - slot, root)
+    std::vector<int> reachDepth;               // Key parts as inserted; -1 when not keyed
+    std::vector<int> reachSlot;
+
+    std::vector<int> toVisit;
+    std::vector<int> walkParent;
+    std::vector<int> walkDepth;
+
+    bool named = false;  // result describes the current structure
+    NamingResult result;
+    NamerScratch scratch;
+    MolecularGraph fullGraph;
+    std::vector<int> fullGraphIds;
+};
@@ -0,0 +1,177 @@
+#include "smiles.h"
+
+#include <algorithm>
+#include <array>
+
+#include "canonical.h"
+
+using namespace std;
+
+// One atom: the bare symbol when SMILES would imply exactly its hydrogens, else in
+// brackets. COOH is written from whichever side it is entered: "C(=O)O" as a leaf,
+// "OC(=O)" when the chain carries on from it, "OC=O" on its own.
+static void appendAtom(string& out, const MolecularGraph& molecule, int atom, bool first) {
+    Element code = molecule.element[atom];
+    int degree = molecule.neighbors(atom).size();
+    if (code == Element::COOH) {
+        out += !first ? "C(=O)O" : degree > 0 ? "OC(=O)" : "OC=O";
+        return;
+    }
+    if (code == Element::Other) {
+        out += '*';
+        return;
+    }
+    int hydrogens = molecule.C_H_bonds[atom];
+    if (hydrogens == max(0, maxBonds(code) - degree)) {
+        out += elementSymbol(code);
+        return;
+    }
+    out += '[';
+    out += elementSymbol(code);
+    if (hydrogens > 0) out += 'H';
+    if (hydrogens > 1) out += char('0' + hydrogens);
+    out += ']';
+}
+
+static void appendLabel(string& out, int label) {
+    if (label >= 10) out += '%';
+    if (label >= 10) out += char('0' + label / 10);
+    out += char('0' + label % 10);
+}
+
+void appendSmiles(string& out, const MolecularGraph& molecule, const vector<int>& rank) {
+    int n = molecule.atomCount();
+    if (n == 0) return;
+
+    // Neighbour lists sorted by rank, one slot per bond end. A slot becomes a tree bond
+    // down to a child, a ring bond, or stays Parent (the bond up to the parent).
+    const vector<int>& offsets = molecule.adjacencyOffsets;
+    vector<int> sorted(molecule.adjacencyTargets);
+    for (int atom = 0; atom < n; atom++) {
+        sort(sorted.begin() + offsets[atom], sorted.begin() + offsets[atom + 1],
+             [&](int a, int b) { return rank[a] < rank[b]; });
+    }
+    enum : char { Parent, Child, Ring };
+    vector<char> kind(sorted.size(), Parent);
+    vector<int> slotLabel(sorted.size(), 0);  // Ring label, set on the closing end
+    vector<int> children(n, 0);
+    vector<int> discovered(n, -1);
+    vector<int> parent(n, -1);
+
+    vector<int> atomAt(n);
+    for (int atom = 0; atom < n; atom++) {
+        atomAt[rank[atom]] = atom;
+    }
+
+    // Each connected part starts from its lowest-ranked atom with at most one bond
+    vector<int> starts;
+    vector<char> reached(n, 0);
+    vector<int> toVisit;
+    for (int first : atomAt) {
+        if (reached[first]) continue;
+        int start = first;
+        reached[first] = 1;
+        toVisit.assign(1, first);
+        while (!toVisit.empty()) {
+            int atom = toVisit.back();
+            toVisit.pop_back();
+            bool terminal = molecule.neighbors(atom).size() <= 1;
+            bool startTerminal = molecule.neighbors(start).size() <= 1;
+            if (terminal && (!startTerminal || rank[atom] < rank[start])) start = atom;
+            for (int neighbor : molecule.neighbors(atom)) {
+                if (!reached[neighbor]) {
+                    reached[neighbor] = 1;
+                    toVisit.push_back(neighbor);
+                }
+            }
+        }
+        starts.push_back(start);
+    }
+
+    struct Frame {
+        int atom;
+        int slot;
+        int childrenLeft;
+        bool branch;  // Entered with '(', so leaving it writes ')'
+    };
+    vector<Frame> stack;
+    array<char, 100> labelUsed{};
+    int order = 0;
+    for (size_t part = 0; part < starts.size(); part++) {
+        int start = starts[part];
+
+        // Depth-first over the sorted lists: the first bond to an unseen atom is a tree
+        // bond, any other bond to a seen atom but the parent a ring bond
+        discovered[start] = order++;
+        stack.push_back({start, offsets[start], 0, false});
+        while (!stack.empty()) {
+            Frame& frame = stack.back();
+            if (frame.slot == offsets[frame.atom + 1]) {
+                stack.pop_back();
+                continue;
+            }
+            int slot = frame.slot++;
+            int neighbor = sorted[slot];
+            if (discovered[neighbor] == -1) {
+                kind[slot] = Child;
+                children[frame.atom]++;
+                parent[neighbor] = frame.atom;
+                discovered[neighbor] = order++;
+                stack.push_back({neighbor, offsets[neighbor], 0, false});
+            } else if (neighbor != parent[frame.atom]) {
+                kind[slot] = Ring;
+            }
+        }
+
+        // Writes an atom with its ring labels: a bond to an atom written earlier closes
+        // the label opened there, one to an atom still to come opens a new label. Labels
+        // closed here are only reused from the next atom on.
+        auto write = [&](int atom) {
+            appendAtom(out, molecule, atom, atom == start);
+            int first = offsets[atom], last = offsets[atom + 1];
+            for (int slot = first; slot < last; slot++) {
+                if (kind[slot] != Ring) continue;
+                int neighbor = sorted[slot];
+                if (discovered[neighbor] < discovered[atom]) {
+                    appendLabel(out, slotLabel[slot]);
+                    continue;
+                }
+                int label = 1;
+                while (label < 99 && labelUsed[label]) label++;
+                labelUsed[label] = 1;
+                appendLabel(out, label);
+                for (int back = offsets[neighbor]; back < offsets[neighbor + 1]; back++) {
+                    if (sorted[back] == atom) slotLabel[back] = label;
+                }
+            }
+            for (int slot = first; slot < last; slot++) {
+                if (kind[slot] == Ring && discovered[sorted[slot]] < discovered[atom]) labelUsed[slotLabel[slot]] = 0;
+            }
+        };
+
+        if (part > 0) out += '.';
+        write(start);
+        stack.push_back({start, offsets[start], children[start], false});
+        while (!stack.empty()) {
+            Frame& frame = stack.back();
+            while (frame.slot < offsets[frame.atom + 1] && kind[frame.slot] != Child) frame.slot++;
+            if (frame.slot == offsets[frame.atom + 1]) {
+                if (frame.branch) out += ')';
+                stack.pop_back();
+                continue;
+            }
+            int child = sorted[frame.slot++];
+            bool branch = --frame.childrenLeft > 0;
+            if (branch) out += '(';
+            write(child);
+            stack.push_back({child, offsets[child], children[child], branch});
+        }
+    }
+}
+
+string canonicalSmiles(const MolecularGraph& molecule) {
+    string out;
+    out.reserve(2 * molecule.atomCount());
+    appendSmiles(out, molecule, canonicalize(molecule).rank);
+    return out;
+}
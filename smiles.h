@@ -0,0 +1,18 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "molecule.h"
+
+// SMILES from the graph (MolecularGraph::parseSmiles reads it back). Every connected
+// part is written from its lowest-ranked terminal atom (any atom for a ring), going
+// through neighbours in rank order; all but the last go in branches, and ring bonds
+// take the lowest free label. Atoms whose hydrogens are not the ones SMILES implies
+// are written in brackets ([CH2] for an ether half's open carbon). COOH is written out
+// as C(=O)O. Parts are joined with '.'.
+void appendSmiles(std::string& out, const MolecularGraph& molecule, const std::vector<int>& rank);
+
+// appendSmiles over the canonical ranking, so every notation of a structure gives the
+// same string (for rings, as far as canonicalize breaks ties the same way)
+std::string canonicalSmiles(const MolecularGraph& molecule);
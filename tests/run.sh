@@ -0,0 +1,106 @@
+#!/usr/bin/env bash
+# Regression checks against a built toolkit, and bench when it is built too:
+#   tests/run.sh [path/to/toolkit [path/to/bench]]
+# cases.tsv holds one case per line: mode (formula or smiles), input, and the first
+# line the toolkit must print for it. Lines starting with '#' are comments.
+
+toolkit=${1:-./toolkit}
+bench=${2:-./bench}
+here=$(dirname "$0")
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+failures=0
+
+fail() {
+    echo "FAIL: $*"
+    failures=$((failures + 1))
+}
+
+# ----- Names -----
+
+while IFS=$'\t' read -r mode input expected; do
+    [[ -z "$mode" || "$mode" == \#* ]] && continue
+    flags=()
+    [[ "$mode" == smiles ]] && flags=(--smiles)
+    actual=$(printf '%s\n' "$input" | "$toolkit" "${flags[@]}" 2>&1 | head -n 1)
+    [[ "$actual" == "$expected" ]] || fail "$mode '$input': expected '$expected', got '$actual'"
+done < "$here/cases.tsv"
+
+# ----- Serve mode -----
+
+# A framed record over the limit is skipped with an error frame and the worker keeps
+# going; a header that is not a length gets an error frame and ends the input
+reply=$({ printf '67108865\n'; head -c 67108865 /dev/zero; printf '6\nCH3CH3'; } | "$toolkit" --serve --length-prefixed)
+expected=$'41\nError: record longer than 67108864 bytes\n7\nEthane'
+[[ "$reply" == "$expected" ]] || fail "--serve --length-prefixed with an oversized record gave '$reply'"
+for header in 12abc -5 ' 6' 99999999999999999999999; do
+    reply=$(printf '%s\nCH3CH3\n6\nCH3CH3' "$header" | "$toolkit" --serve --length-prefixed)
+    expected=$'29\nError: invalid record header'
+    [[ "$reply" == "$expected" ]] || fail "--serve --length-prefixed with header '$header' gave '$reply'"
+done
+
+# ----- Name cache -----
+
+# Names served from the cache match uncached ones, also for ring ether halves with the
+# same skeleton bonded to the O at different carbons
+{
+    cat "$here/corpus.txt"
+    printf 'C1H(CH3)CH2CH2CH2CH2C1H2-O-CH3\nC1H2CH(CH3)CH2CH2CH2C1H2-O-CH3\n'
+    printf 'CH3-O-C1HCH(CH3)CH2CH2CH2C1H2\nC1H2CH2CH2CH2CH(CH3)C1H-O-CH3\n'
+} > "$work/cached.txt"
+"$toolkit" --input "$work/cached.txt" --threads 1 > "$work/uncached-names" 2> /dev/null
+"$toolkit" --input "$work/cached.txt" --threads 1 --cache 100 > "$work/cached-names" 2> /dev/null
+cmp -s "$work/cached-names" "$work/uncached-names" || fail "--cache changes names: $(diff "$work/uncached-names" "$work/cached-names" | grep '^>' | head -n 1)"
+
+# A cache file saved by other rules is not loaded: its names are not served
+printf 'CH4\n' | "$toolkit" --batch --cache 10 --cache-file "$work/names.cache" > /dev/null 2>&1
+sed -e '1s/.*/# toolkit name cache v1/' -e '2s/\t.*/\tStale/' "$work/names.cache" > "$work/stale.cache"
+name=$(printf 'CH4\n' | "$toolkit" --batch --cache 10 --cache-file "$work/stale.cache" 2> /dev/null)
+[[ "$name" == Methane ]] || fail "a name cache with an old header was loaded: got '$name'"
+
+# ----- Graph store -----
+
+# Writing corpus.txt to a store and naming it back gives the names of the text run.
+# The corpus has an odd number of atoms in total.
+check_store() {
+    local corpus=$1
+    "$toolkit" --input "$corpus" --write-graphs "$work/store.tkg" 2> /dev/null ||
+        { fail "--write-graphs $corpus"; return; }
+    "$toolkit" --input "$corpus" | cut -f 2 > "$work/text-names"
+    "$toolkit" --graphs "$work/store.tkg" > "$work/store-rows" 2>&1 || { fail "--graphs $corpus: $(head -n 1 "$work/store-rows")"; return; }
+    cut -f 2 "$work/store-rows" | cmp -s - "$work/text-names" || fail "store names differ from text names for $corpus"
+}
+check_store "$here/corpus.txt"
+printf 'CH4\n' > "$work/one.txt"
+check_store "$work/one.txt"
+printf 'CH3CH2CH3\n' > "$work/three.txt"
+check_store "$work/three.txt"
+
+# ----- Fingerprint index -----
+
+# Every indexed formula finds itself with similarity 1, and --json stays valid JSON
+# for SMILES with backslashes or a title after them
+"$toolkit" --input "$here/corpus.txt" --build-index "$work/corpus.fpi" 2> /dev/null || fail "--build-index"
+while IFS= read -r formula; do
+    printf '%s\n' "$formula" | "$toolkit" > /dev/null 2>&1 || continue
+    hit=$(printf '%s\n' "$formula" | "$toolkit" --index "$work/corpus.fpi" --top 1 | tail -n 1)
+    [[ "$hit" == "1.0000"$'\t'* ]] || fail "index lookup of '$formula' gave '$hit'"
+done < "$here/corpus.txt"
+printf 'C\\C(C)CC\nCCC "propane"\n' > "$work/titled.smi"
+"$toolkit" --smiles --input "$work/titled.smi" --build-index "$work/titled.fpi" 2> /dev/null || fail "--build-index --smiles"
+printf 'CCC\n' | "$toolkit" --smiles --json --index "$work/titled.fpi" |
+    python3 -c 'import json, sys; assert [hit["formula"] for hit in json.load(sys.stdin)["similar"]] == ["CCC", "C\\C(C)CC"]' ||
+    fail "--json similar list for SMILES with a backslash or a title"
+
+# ----- Session -----
+
+# Every MoleculeSession name bench checks matches the full pass, ties included
+if [[ -x "$bench" ]]; then
+    "$bench" --sizes 5,8,12,20 --branching 0.3,0.6 --check-reference 100 > "$work/bench.json" ||
+        fail "bench --check-reference"
+    mismatches=$(grep -o '"session_mismatches":[0-9]*' "$work/bench.json" | awk -F: '{ sum += $2 } END { print sum + 0 }')
+    [[ "$mismatches" == 0 ]] || fail "$mismatches session names differ from the full pass"
+fi
+
+echo "$failures failed"
+[[ $failures -eq 0 ]]
@@ -0,0 +1,116 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+
+using namespace std;
+
+WorkStealingPool::WorkStealingPool(unsigned threadCount) {
+    if (threadCount == 0) {
+        threadCount = max(1u, thread::hardware_concurrency());
+    }
+
+    for (unsigned i = 0; i < threadCount; i++) {
+        queues.push_back(make_unique<WorkerQueue>());
+    }
+    for (unsigned i = 0; i < threadCount; i++) {
+        threads.emplace_back(&WorkStealingPool::workerLoop, this, i);
+    }
+}
+
+WorkStealingPool::~WorkStealingPool() {
+    {
+        lock_guard<mutex> lock(jobLock);
+        stopping = true;
+    }
+    jobReady.notify_all();
+    for (thread& worker : threads) {
+        worker.join();
+    }
+}
+
+void WorkStealingPool::parallelFor(size_t count, size_t grain, const function<void(size_t, unsigned)>& task) {
+    if (count == 0) return;
+    grain = max<size_t>(grain, 1);
+
+    lock_guard<mutex> submit(submitLock);
+
+    {
+        lock_guard<mutex> lock(jobLock);
+        firstError = nullptr;
+    }
+    pendingRanges = (count + grain - 1) / grain;
+    currentTask = &task;  // Published before any range becomes visible to a worker
+
+    // Deal the ranges round-robin so every worker starts with local work
+    size_t rangeIndex = 0;
+    for (size_t begin = 0; begin < count; begin += grain, rangeIndex++) {
+        WorkerQueue& queue = *queues[rangeIndex % queues.size()];
+        lock_guard<mutex> lock(queue.lock);
+        queue.ranges.push_back({begin, min(count, begin + grain)});
+    }
+
+    unique_lock<mutex> lock(jobLock);
+    jobGeneration++;
+    jobReady.notify_all();
+    jobDone.wait(lock, [&] { return pendingRanges == 0; });
+    currentTask = nullptr;
+
+    if (firstError) {
+        rethrow_exception(firstError);
+    }
+}
+
+bool WorkStealingPool::takeRange(unsigned worker, Range& range) {
+    {
+        WorkerQueue& own = *queues[worker];
+        lock_guard<mutex> lock(own.lock);
+        if (!own.ranges.empty()) {
+            range = own.ranges.front();
+            own.ranges.pop_front();
+            return true;
+        }
+    }
+
+    for (size_t offset = 1; offset < queues.size(); offset++) {
+        WorkerQueue& victim = *queues[(worker + offset) % queues.size()];
+        lock_guard<mutex> lock(victim.lock);
+        if (!victim.ranges.empty()) {
+            range = victim.ranges.back();
+            victim.ranges.pop_back();
+            return true;
+        }
+    }
+    return false;
+}
+
+void WorkStealingPool::workerLoop(unsigned worker) {
+    size_t seenGeneration = 0;
+
+    while (true) {
+        {
+            unique_lock<mutex> lock(jobLock);
+            jobReady.wait(lock, [&] { return stopping || jobGeneration != seenGeneration; });
+            if (stopping) return;
+            seenGeneration = jobGeneration;
+        }
+
+        // A range only exists while its job is running, so currentTask is the one it belongs to
+        Range range;
+        while (takeRange(worker, range)) {
+            const function<void(size_t, unsigned)>& task = *currentTask.load();
+            try {
+                for (size_t i = range.begin; i < range.end; i++) {
+                    task(i, worker);
+                }
+            } catch (...) {
+                lock_guard<mutex> lock(jobLock);
+                if (!firstError) firstError = current_exception();
+            }
+
+            if (pendingRanges.fetch_sub(1) == 1) {
+                lock_guard<mutex> lock(jobLock);
+                jobDone.notify_all();
+            }
+        }
+    }
+}
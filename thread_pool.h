@@ -0,0 +1,60 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads for data-parallel loops. Each worker owns a deque of
+// index ranges: it takes work from the front of its own deque and, once that is empty,
+// steals from the back of the others, so uneven molecules even out across cores.
+class WorkStealingPool {
+public:
+    // threadCount == 0 uses one worker per hardware thread
+    explicit WorkStealingPool(unsigned threadCount = 0);
+    ~WorkStealingPool();
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    unsigned size() const { return threads.size(); }
+
+    // Runs task(index, worker) for every index in [0, count) and blocks until all are
+    // done. Indices are handed out in ranges of `grain`; worker is in [0, size()), so
+    // callers can keep per-worker scratch state. The first exception thrown by a task
+    // is rethrown here after the loop drains.
+    void parallelFor(size_t count, size_t grain, const std::function<void(size_t, unsigned)>& task);
+
+private:
+    struct Range {
+        size_t begin;
+        size_t end;
+    };
+
+    struct WorkerQueue {
+        std::mutex lock;
+        std::deque<Range> ranges;
+    };
+
+    void workerLoop(unsigned worker);
+    bool takeRange(unsigned worker, Range& range);
+
+    std::vector<std::thread> threads;
+    std::vector<std::unique_ptr<WorkerQueue>> queues;
+
+    std::mutex submitLock;  // One parallelFor at a time
+    std::mutex jobLock;
+    std::condition_variable jobReady;
+    std::condition_variable jobDone;
+    std::atomic<const std::function<void(size_t, unsigned)>*> currentTask{nullptr};
+    size_t jobGeneration = 0;
+    std::atomic<size_t> pendingRanges{0};
+    std::exception_ptr firstError;
+    bool stopping = false;
+};